@@ -0,0 +1,385 @@
+/*
+ * bench.c - 캐시 적중 처리량이 스레드 수에 따라 늘어나는지 재는 도구
+ *
+ * 프록시와 같은 캐시(cache.c)를 프로세스 안에서 띄워 객체를 미리 채운 뒤,
+ * 스레드 1, 2, 4, ... max_threads개가 정해진 시간 동안 임의의 키를
+ * cache_lookup과 cache_release로 적중시킨 횟수를 센다. 소켓과 원 서버를 거치지 않으므로
+ * 샤드 락과 축출 정책의 적중 경로만 잰다. -s 1과 비교하면 샤드를 나눈
+ * 효과가 보인다.
+ *
+ * -C는 대신 코루틴 엔진(coro.c)의 문맥 교환 한 번에 드는 시간을 잰다.
+ *
+ * -R port는 이미 떠 있는 프록시를 통째로 잰다. 프로세스 안에 원 서버를
+ * 띄우고 클라이언트 -T개가 정해진 시간 동안 프록시를 거쳐 -b바이트
+ * 객체를 받아 가며 초당 요청 수와 지연 분위수를 낸다. 기본은 no-store
+ * 응답이라 매번 원 서버까지 중계하고, -H는 -n개 키를 캐시할 수 있게
+ * 내줘 적중 경로를 잰다. -L은 클라이언트 -l개가 그 크기의 큰 객체를
+ * 계속 받게 해, 큰 전송이 섞일 때 작은 요청의 꼬리 지연을 본다.
+ * 엔진(-e)마다 프록시를 띄워 비교하는 것은 make relay가 한다.
+ *
+ * usage: ./bench [-s shards] [-p policy] [-n objects] [-b object_bytes]
+ *                [-T max_threads] [-d seconds]
+ *        ./bench -C
+ *        ./bench -R proxy_port [-T clients] [-d seconds] [-b object_bytes]
+ *                [-n objects] [-H] [-L large_bytes] [-l large_clients]
+ */
+#include "cache.h"
+#include "coro.h"
+#include "policy.h"
+
+#define BENCH_SWITCH_ROUNDS 10000000    /* -C에서 코루틴을 오갈 횟수 */
+
+#define BENCH_MAX_THREADS 256
+
+/* -R 모드의 클라이언트 하나가 잰 결과 */
+typedef struct {
+    int id;
+    unsigned seed;
+    unsigned long requests, errors;
+    unsigned long long bytes;
+    double *lat_us;             /* 작은 요청마다 걸린 시간(µs) */
+    size_t nlat, caplat;
+} relay_client_t;
+
+static int object_count = 512;
+static volatile int stop;
+
+/* -R 모드 설정 */
+static char *proxy_port;
+static char origin_port[NI_MAXSERV];
+static size_t small_bytes = 1024, large_bytes;
+static int small_cacheable, large_clients;
+
+static void *hitter(void *vargp);
+static void relay(int clients, int seconds);
+static void *origin_listener(void *vargp);
+static void *origin_conn(void *vargp);
+static void *relay_client(void *vargp);
+static int cmp_double(const void *a, const void *b);
+static void make_key(char *key, int i);
+static void usage(char *prog);
+
+int main(int argc, char *argv[]) {
+    pthread_t tids[BENCH_MAX_THREADS];
+    unsigned long counts[BENCH_MAX_THREADS], total;
+    double base = 0, rate, elapsed;
+    struct timespec t0, t1;
+    int opt, i, threads, nshards = CACHE_DEFAULT_SHARDS, max_threads = 32, seconds = 1;
+    size_t object_bytes = 1024;
+    char key[MAXLINE], *data;
+    cache_entry_t *e;
+    cache_meta_t meta;
+
+    while ((opt = getopt(argc, argv, "s:p:n:b:T:d:CR:HL:l:")) != -1) {
+        switch (opt) {
+        case 'C':  /* 코루틴 문맥 교환 시간 */
+            printf("coroutine switch: %.1f ns\n", coro_switch_ns(BENCH_SWITCH_ROUNDS));
+            exit(0);
+        case 'R':  /* 이 포트의 프록시를 거친 중계 처리량 */
+            proxy_port = optarg;
+            break;
+        case 'H':  /* -R: 작은 객체를 캐시할 수 있게 내준다 */
+            small_cacheable = 1;
+            break;
+        case 'L':  /* -R: 섞어 넣을 큰 객체의 바이트 수 */
+            large_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':  /* -R: 큰 객체를 받을 클라이언트 수 */
+            large_clients = atoi(optarg);
+            break;
+        case 's':  /* 캐시 샤드 수 */
+            nshards = atoi(optarg);
+            break;
+        case 'p':  /* 축출 정책 */
+            if (policy_select(optarg) < 0)
+                usage(argv[0]);
+            break;
+        case 'n':  /* 미리 채울 객체 수 */
+            object_count = atoi(optarg);
+            break;
+        case 'b':  /* 객체 하나의 바이트 수 */
+            object_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':  /* 늘려 갈 최대 스레드 수 */
+            max_threads = atoi(optarg);
+            break;
+        case 'd':  /* 스레드 수마다 잴 시간(초) */
+            seconds = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc || object_count < 1 || object_bytes == 0 ||
+        max_threads < 1 || max_threads > BENCH_MAX_THREADS || seconds < 1)
+        usage(argv[0]);
+    if (proxy_port) {
+        if (large_bytes && large_clients == 0)
+            large_clients = 1;
+        if (large_clients >= max_threads || (large_clients && !large_bytes))
+            usage(argv[0]);
+        small_bytes = object_bytes;
+        relay(max_threads, seconds);
+        exit(0);
+    }
+
+    cache_init(nshards, 0);
+
+    /* 모든 객체가 예산 안에 들어가야 적중만 잰다 */
+    data = Malloc(object_bytes);
+    memset(data, 'x', object_bytes);
+    memset(&meta, 0, sizeof(meta));
+    meta.expires = time(NULL) + 3600;
+    meta.last_modified = -1;
+    for (i = 0; i < object_count; i++) {
+        make_key(key, i);
+        cache_insert(key, data, object_bytes, &meta);
+    }
+    for (i = 0; i < object_count; i++) {
+        make_key(key, i);
+        if ((e = cache_lookup(key, NULL, NULL)) == NULL) {
+            fprintf(stderr, "bench: 객체 %d개 x %zu바이트가 캐시에 다 들어가지 않습니다\n",
+                    object_count, object_bytes);
+            exit(1);
+        }
+        cache_release(e);
+    }
+    Free(data);
+
+    printf("%d objects x %zu bytes, %d shards, policy %s, %d s per step\n",
+           object_count, object_bytes, nshards, cache_policy->name, seconds);
+    printf("%7s %14s %14s %8s\n", "threads", "hits/s", "hits/s/thread", "speedup");
+    for (threads = 1; threads <= max_threads; threads *= 2) {
+        stop = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < threads; i++) {
+            counts[i] = i;          /* 난수 씨앗으로 넘기고 결과를 받는다 */
+            Pthread_create(&tids[i], NULL, hitter, &counts[i]);
+        }
+        sleep(seconds);
+        stop = 1;
+        for (total = 0, i = 0; i < threads; i++) {
+            Pthread_join(tids[i], NULL);
+            total += counts[i];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        rate = total / elapsed;
+        if (threads == 1)
+            base = rate;
+        printf("%7d %14.0f %14.0f %8.2f\n", threads, rate, rate / threads, rate / base);
+    }
+    exit(0);
+}
+
+/*
+ * hitter - stop이 설 때까지 임의의 키를 적중시킴. 적중 횟수를 *vargp에 돌려줌
+ */
+static void *hitter(void *vargp) {
+    unsigned long *countp = vargp, hits = 0;
+    unsigned seed = *countp * 2654435761u + 1;
+    char key[MAXLINE];
+    volatile char sink;
+    cache_entry_t *e;
+
+    while (!stop) {
+        make_key(key, rand_r(&seed) % object_count);
+        if ((e = cache_lookup(key, NULL, NULL)) != NULL) {
+            sink = e->data[e->size - 1];
+            cache_release(e);
+            hits++;
+        }
+    }
+    (void)sink;
+    *countp = hits;
+    return NULL;
+}
+
+/*
+ * relay - 원 서버를 띄우고 클라이언트 clients개로 seconds초 동안 프록시를 두드림
+ */
+static void relay(int clients, int seconds) {
+    pthread_t tids[BENCH_MAX_THREADS], otid;
+    relay_client_t cs[BENCH_MAX_THREADS];
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    unsigned long requests = 0, errors = 0, large_requests = 0;
+    unsigned long long bytes = 0, large_total = 0;
+    double *lat, elapsed;
+    size_t nlat = 0, k;
+    struct timespec t0, t1;
+    int i, listenfd;
+
+    Signal(SIGPIPE, SIG_IGN);
+    listenfd = Open_listenfd("0");
+    if (getsockname(listenfd, (SA *)&addr, &len) < 0)
+        unix_error("getsockname error");
+    Getnameinfo((SA *)&addr, len, NULL, 0, origin_port, sizeof(origin_port),
+                NI_NUMERICSERV);
+    Pthread_create(&otid, NULL, origin_listener, (void *)(long)listenfd);
+
+    stop = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < clients; i++) {
+        memset(&cs[i], 0, sizeof(cs[i]));
+        cs[i].id = i;
+        cs[i].seed = i * 2654435761u + 1;
+        Pthread_create(&tids[i], NULL, relay_client, &cs[i]);
+    }
+    sleep(seconds);
+    stop = 1;
+    for (i = 0; i < clients; i++) {
+        Pthread_join(tids[i], NULL);
+        errors += cs[i].errors;
+        if (i < large_clients) {
+            large_requests += cs[i].requests;
+            large_total += cs[i].bytes;
+        } else {
+            requests += cs[i].requests;
+            bytes += cs[i].bytes;
+            nlat += cs[i].nlat;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    lat = Malloc((nlat + 1) * sizeof(double));
+    for (nlat = 0, i = large_clients; i < clients; i++) {
+        for (k = 0; k < cs[i].nlat; k++)
+            lat[nlat++] = cs[i].lat_us[k];
+        Free(cs[i].lat_us);
+    }
+    qsort(lat, nlat, sizeof(double), cmp_double);
+
+    printf("proxy :%s, %d clients, %zu-byte %s, %d s", proxy_port, clients - large_clients,
+           small_bytes, small_cacheable ? "hits" : "relays", seconds);
+    if (large_clients)
+        printf(", + %d clients x %zu bytes", large_clients, large_bytes);
+    printf("\n%10s %8s %9s %9s %9s %9s %7s\n",
+           "req/s", "MB/s", "p50(us)", "p90(us)", "p99(us)", "max(us)", "errors");
+    printf("%10.0f %8.1f %9.0f %9.0f %9.0f %9.0f %7lu\n", requests / elapsed,
+           bytes / elapsed / 1e6, nlat ? lat[nlat / 2] : 0, nlat ? lat[nlat * 9 / 10] : 0,
+           nlat ? lat[nlat * 99 / 100] : 0, nlat ? lat[nlat - 1] : 0, errors);
+    if (large_clients)
+        printf("large: %lu transfers, %.1f MB/s\n", large_requests, large_total / elapsed / 1e6);
+    Free(lat);
+}
+
+/*
+ * origin_listener - 원 서버. 연결마다 스레드 하나가 응답함
+ */
+static void *origin_listener(void *vargp) {
+    int listenfd = (int)(long)vargp, connfd;
+    pthread_t tid;
+
+    Pthread_detach(pthread_self());
+    while (1) {
+        if ((connfd = accept(listenfd, NULL, NULL)) < 0)
+            continue;
+        Pthread_create(&tid, NULL, origin_conn, (void *)(long)connfd);
+    }
+    return NULL;
+}
+
+/*
+ * origin_conn - "GET /relay/<bytes>/<cache|nostore>/<n>" 하나에 응답하고 닫음
+ */
+static void *origin_conn(void *vargp) {
+    static char body[MAXBUF];
+    int fd = (int)(long)vargp;
+    char buf[MAXLINE], head[MAXLINE], kind[16];
+    size_t size = 0, n;
+    rio_t rio;
+
+    Pthread_detach(pthread_self());
+    rio_readinitb(&rio, fd);
+    if (rio_readlineb(&rio, buf, MAXLINE) <= 0 ||
+        sscanf(buf, "GET /relay/%zu/%15[^/]", &size, kind) != 2) {
+        Close(fd);
+        return NULL;
+    }
+    while (rio_readlineb(&rio, buf, MAXLINE) > 0 && strcmp(buf, "\r\n"))
+        ;
+    n = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                 "Content-Length: %zu\r\nCache-Control: %s\r\n\r\n", size,
+                 strcmp(kind, "cache") ? "no-store" : "max-age=3600");
+    if (rio_writen(fd, head, n) < 0)
+        size = 0;
+    for (; size > 0; size -= n) {
+        n = size < sizeof(body) ? size : sizeof(body);
+        if (rio_writen(fd, body, n) < 0)
+            break;
+    }
+    Close(fd);
+    return NULL;
+}
+
+/*
+ * relay_client - stop이 설 때까지 프록시를 거쳐 객체를 받음. 받은 바이트가
+ *                바라던 크기보다 모자라거나 200이 아니면 오류로 센다
+ */
+static void *relay_client(void *vargp) {
+    relay_client_t *c = vargp;
+    char req[MAXLINE], buf[MAXBUF];
+    size_t want = c->id < large_clients ? large_bytes : small_bytes;
+    struct timespec t0, t1;
+    unsigned long long got;
+    int fd, ok, n, len;
+    rio_t rio;
+
+    while (!stop) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if ((fd = open_clientfd("127.0.0.1", proxy_port)) < 0) {
+            c->errors++;
+            continue;
+        }
+        len = snprintf(req, sizeof(req), "GET http://127.0.0.1:%s/relay/%zu/%s/%d HTTP/1.0\r\n"
+                       "Host: 127.0.0.1:%s\r\n\r\n", origin_port, want,
+                       c->id >= large_clients && small_cacheable ? "cache" : "nostore",
+                       c->id < large_clients ? c->id :
+                       (small_cacheable ? (int)(rand_r(&c->seed) % object_count) : c->id),
+                       origin_port);
+        rio_readinitb(&rio, fd);
+        ok = rio_writen(fd, req, len) == len && rio_readlineb(&rio, buf, MAXLINE) > 0 &&
+             strncmp(buf + 8, " 200", 4) == 0;
+        while (ok && (n = rio_readlineb(&rio, buf, MAXLINE)) > 0 && strcmp(buf, "\r\n"))
+            ;
+        got = 0;
+        while (ok && (n = rio_readnb(&rio, buf, sizeof(buf))) > 0)
+            got += n;
+        Close(fd);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (!ok || got < want) {
+            c->errors++;
+            continue;
+        }
+        c->requests++;
+        c->bytes += want;
+        if (c->id < large_clients)
+            continue;
+        if (c->nlat == c->caplat) {
+            c->caplat = c->caplat ? c->caplat * 2 : 1024;
+            c->lat_us = Realloc(c->lat_us, c->caplat * sizeof(double));
+        }
+        c->lat_us[c->nlat++] = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    }
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void make_key(char *key, int i) {
+    sprintf(key, "http://bench.local:80/objects/%d", i);
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-s shards] [-p clock|lru|slru|gdsf] [-n objects] "
+            "[-b object_bytes] [-T max_threads] [-d seconds]\n"
+            "       %s -C\n"
+            "       %s -R proxy_port [-T clients] [-d seconds] [-b object_bytes] "
+            "[-n objects] [-H] [-L large_bytes] [-l large_clients]\n", prog, prog, prog);
+    exit(0);
+}
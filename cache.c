@@ -0,0 +1,1283 @@
+/*
+ * cache.c - 프록시 서버의 인메모리 객체 캐시
+ *
+ * 정규화된 URI를 키로, 원 서버 응답 전체를 값으로 저장한다.
+ * 캐시는 2의 거듭제곱 개의 샤드로 나뉘며, 키의 해시 상위 비트로 샤드를
+ * 고른다. 각 샤드는 MAX_CACHE_SIZE를 샤드 수로 나눈 만큼의 바이트 예산과
+ * 자신만의 락, 해시 인덱스, 축출 정책 상태를 가진다. 따라서 서로 다른
+ * 샤드에 대한 적중과 삽입은 전혀 경쟁하지 않는다.
+ *
+ * 축출 정책은 시작할 때 고른다(policy.c: clock, lru, slru, gdsf).
+ * 조회 경로는 샤드의 index_lock을 읽기 모드로만 잡고 정책에 적중을
+ * 알린다. 기본값인 CLOCK은 참조 비트만 원자적으로 세우므로 적중이 서로
+ * 경쟁하지 않는다. 삽입 시에만 쓰기 락을 잡고 정책이 고른 후보를 축출한다.
+ *
+ * 공간이 부족할 때 새 객체는 TinyLFU 승인 필터(tinylfu.c)를 거친다.
+ * 새 객체의 추정 접근 빈도가 정책이 고른 축출 후보보다 높아야만
+ * 후보를 밀어내고 들어갈 수 있다. 원 서버별 소프트 할당량(origin.c)을
+ * 넘은 호스트의 객체는 이 비교 없이 축출되고, 할당량을 넘은 호스트의
+ * 새 객체는 다른 호스트 객체를 밀어내지 못한다.
+ *
+ * 미스가 난 요청은 cache_fetch_begin으로 샤드의 진행 중 요청 표에
+ * 등록한다. 같은 키를 가장 먼저 등록한 스레드(리더)만 원 서버에 연결하고,
+ * 응답을 클라이언트로 보내는 같은 루프에서 cache_fill_append로 채워지는
+ * 버퍼에 붙인다(tee). 뒤이은 스레드는 cache_follow로 그 버퍼를 따라
+ * 읽으므로 원 서버로 몰리는 중복 요청이 하나로 합쳐진다. 응답이 끝나면
+ * 버퍼를 슬랩 청크로 옮겨 캐시 객체의 본문으로 삼는다.
+ * 캐시에 넣지 않을 응답(no-cache, 200이 아닌 상태 등)도 리더가
+ * cache_fill_share로 열면 팔로워가 같은 버퍼를 따라 읽는다. 원 서버
+ * 오류나 잘린 응답이라 채우던 내용을 버리면(cache_fill_abort, 큰 객체
+ * 계층으로 간 응답도 같다) 팔로워는 리더가 끝난 뒤 캐시를 다시 보고 표로
+ * 돌아가 그중 하나만 새 리더가 된다. 다른 클라이언트에게 보낼 수 없는
+ * 응답(private, no-store)이나 어디에도 남지 않을 큰 응답이면
+ * (cache_fill_pass) 팔로워는 곧바로 각자 가져온다.
+ *
+ * 객체 본문은 슬랩 할당기(slab.c)의 크기 클래스별 청크에 둔다. 슬랩
+ * 아레나가 MAX_CACHE_SIZE로 고정되어 있어 힙 조각화로 메모리가 예산을
+ * 넘어 불어나지 않는다. 청크 낭비 때문에 클래스에 자리가 모자라면 샤드
+ * 예산과 별개로 그 클래스의 오래된 객체를 evict_entry로 축출한다.
+ * 슬랩 아레나는 memfd이므로 적중 응답은 cache_send가 sendfile로
+ * (상태줄, 헤더, 본문이 한 청크에 이어져 있다) 복사 없이 보낸다. 청크를
+ * 다시 쓸 때 소켓 큐의 페이지가 바뀌지 않도록 청크 안에 통째로 든 memfd
+ * 페이지만 sendfile로 보내고 앞뒤 조각은 복사한다(slab.c).
+ *
+ * 객체마다 원 서버가 정한 만료 시각이 있다. 만료된 객체는 조회에서
+ * 미스로 취급되며, 샤드마다 둔 계층형 타이머 휠(timerwheel.c)을 reaper
+ * 스레드가 1초마다 돌려 만료된 객체를 바로 회수한다. 전체 캐시를 훑지
+ * 않고도 만료 객체가 MAX_CACHE_SIZE를 차지한 채 남지 않는다.
+ * 단, ETag나 Last-Modified가 있는 객체는 만료 후 CACHE_STALE_KEEP초 동안
+ * 남겨 두어 cache_lookup_stale로 찾아 조건부 요청으로 재검증할 수 있게
+ * 하고, 304 응답이면 cache_revalidate로 본문 전송 없이 304의 헤더를 저장된
+ * 헤더에 합치고 신선도를 갱신한다.
+ * stale-while-revalidate 기간(swr_until) 안의 만료 객체는 cache_lookup이
+ * 그대로 돌려주고 *stalep로 알린다. 호출자는 바로 응답한 뒤
+ * cache_claim_refresh로 한 스레드만 백그라운드 갱신을 예약한다.
+ *
+ * 디스크 계층(disk.c)이 켜져 있으면 원 서버에서 받은 객체를 디스크에도
+ * 기록해 재시작 후에도 남게 하고, 정책이 축출한 객체 중 아직 회수 시각
+ * 전인데 디스크 사본이 없는 것은 디스크로 내린다. 메모리 미스는 디스크에서
+ * 찾아 다시 올린다. 디스크 쓰기는 샤드 락을 놓은 뒤에 한다.
+ *
+ * 응답에 Vary가 있으면 같은 키 아래에 요청 헤더 값별 변형을 따로 둔다.
+ * 변형은 키 해시가 같아 한 샤드의 한 버킷 체인에 모이므로 별도의 표 없이
+ * 체인이 곧 보조 색인이다. 조회는 체인에서 처음 만난 변형의 Vary 목록으로
+ * 요청의 보조 해시(http_vary_hash)를 구해 같은 vhash의 변형을 고른다.
+ * 한 URI가 샤드를 독차지하지 못하도록 변형 수는 CACHE_MAX_VARIANTS,
+ * 바이트는 CACHE_VARIANT_BYTES로 묶고 넘치면 가장 오래된 변형을 뺀다.
+ * Vary 목록이 바뀐 응답이 오면 예전 목록의 변형은 모두 버린다. 변형은
+ * 디스크 계층에 기록하지 않는다.
+ *
+ * 샤드마다 색인에 있는 키를 기수 트리(radix.c)에도 넣어 두어, 관리자가
+ * 호스트나 경로 접두사로 비울 때(cache_purge) 전체 버킷을 훑지 않고 그
+ * 접두사 아래의 키만 찾는다. 기수 트리도 index_lock 쓰기 모드로 고친다.
+ *
+ * 축출된 객체는 인덱스와 정책 상태에서 떨어지지만, 다른 스레드가 아직 그 본문을
+ * 클라이언트에 보내는 중이면 cache_release가 마지막 참조를 놓을 때
+ * 해제된다.
+ */
+#include "cache.h"
+#include "disk.h"
+#include "intern.h"
+#include "origin.h"
+#include "policy.h"
+#include "radix.h"
+#include "slab.h"
+#include "tinylfu.h"
+#include "urlnorm.h"
+#include "http.h"
+#include <stddef.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+
+typedef struct {
+    pthread_rwlock_t index_lock;    /* 인덱스와 정책 상태 보호 (조회는 읽기 모드) */
+    cache_entry_t *buckets[CACHE_BUCKETS];
+    policy_state_t policy;          /* 축출 정책 상태 */
+    size_t bytes;                   /* 현재 캐시된 바이트 수 */
+    size_t capacity;                /* 이 샤드의 바이트 예산 */
+    pthread_mutex_t flight_lock;    /* 진행 중 요청 표(목록 연결) 보호 */
+    inflight_t *flights;            /* 진행 중 요청 목록 */
+    timer_wheel_t wheel;            /* 만료 타이머 (index_lock 쓰기 모드로 보호) */
+    radix_t keys;                   /* 색인에 있는 키 (변형 수만큼 count) */
+} __attribute__((aligned(64))) cache_shard_t;
+
+/* rio_wait 훅으로 기다리는 팔로워: 리더가 알릴 때 fd(eventfd)에 쓴다 */
+typedef struct fill_waiter {
+    int fd;
+    struct fill_waiter *next;
+} fill_waiter_t;
+
+static cache_shard_t *shards;
+static int shard_count;
+static int shard_shift;             /* 해시 상위 비트를 샤드 번호로 쓰기 위한 시프트 */
+static size_t object_limit;         /* 샤드 예산을 고려한 객체 크기 상한 */
+
+/* 내부 함수 */
+static unsigned long hash_key(char *key);
+static cache_shard_t *shard_of(unsigned long hash);
+static cache_entry_t *find_entry(cache_shard_t *sh, char *key, unsigned long hash,
+                                 http_req_t *req);
+static int indexed(cache_shard_t *sh, cache_entry_t *e);
+static int old_variants(cache_shard_t *sh, cache_entry_t *e, cache_entry_t **drop);
+static int same_key(cache_entry_t *e, unsigned long hash, char *key, size_t len);
+static void remove_entry(cache_shard_t *sh, cache_entry_t *e);
+static void unlink_entry(cache_shard_t *sh, cache_entry_t *e);
+static int remove_key(cache_shard_t *sh, char *key);
+static cache_entry_t *lookup(cache_shard_t *sh, char *key, unsigned long hash,
+                             http_req_t *req, int *stalep);
+static int insert_entry(cache_shard_t *sh, cache_entry_t *e, int from_disk);
+static cache_entry_t *promote(cache_shard_t *sh, char *key, unsigned long hash);
+static int usable(cache_entry_t *e, time_t now, int *stalep);
+static void persist(cache_entry_t *e);
+static void demote(cache_entry_t *victims);
+static cache_entry_t *new_entry(char *key, unsigned long hash, char *data, size_t size,
+                                cache_meta_t *meta);
+static time_t reclaim_time(cache_entry_t *e);
+static size_t head_length(char *data, size_t size);
+static void *reaper(void *vargp);
+static void expire_entry(tw_node_t *node, void *arg);
+static void flight_put(inflight_t *f);
+static void wake_followers(inflight_t *f);
+static void follow_wait(inflight_t *f, fill_waiter_t *w);
+static void unwatch(inflight_t *f, fill_waiter_t *w);
+static int pin_entry(void *owner, void *ctx);
+static void evict_entry(void *owner);
+
+/*
+ * cache_init - 캐시 초기화. 스레드를 만들기 전에 한 번 호출한다.
+ * nshards는 2의 거듭제곱으로 올림하며 [1, CACHE_MAX_SHARDS]로 제한한다.
+ * hugepages면 슬랩 아레나를 거대 페이지로 잡아 본다.
+ */
+void cache_init(int nshards, int hugepages) {
+    int i, bits = 0;
+    pthread_t tid;
+
+    if (nshards < 1)
+        nshards = 1;
+    if (nshards > CACHE_MAX_SHARDS)
+        nshards = CACHE_MAX_SHARDS;
+    while ((1 << bits) < nshards)
+        bits++;
+    shard_count = 1 << bits;
+    shard_shift = 64 - bits;
+
+    shards = Calloc(shard_count, sizeof(cache_shard_t));
+    for (i = 0; i < shard_count; i++) {
+        cache_shard_t *sh = &shards[i];
+        pthread_rwlock_init(&sh->index_lock, NULL);
+        pthread_mutex_init(&sh->flight_lock, NULL);
+        tw_init(&sh->wheel, time(NULL));
+        radix_init(&sh->keys);
+        sh->capacity = MAX_CACHE_SIZE / shard_count;
+        policy_init(&sh->policy, sh->capacity);
+    }
+    tinylfu_init();
+    slab_init(MAX_CACHE_SIZE, MAX_OBJECT_SIZE, hugepages, pin_entry, evict_entry);
+    Pthread_create(&tid, NULL, reaper, NULL);
+
+    object_limit = MAX_OBJECT_SIZE;
+    if (object_limit > shards[0].capacity) {
+        object_limit = shards[0].capacity;
+        fprintf(stderr, "cache: 샤드 %d개에서는 %zu바이트 초과 객체를 캐시하지 않습니다\n",
+                shard_count, object_limit);
+    }
+}
+
+/*
+ * cache_make_key - parse_uri 결과로 캐시 키 생성 (key는 MAXLINE바이트)
+ * 같은 객체를 가리키는 URI가 같은 키가 되도록 urlnorm.c의 규칙으로
+ * "호스트[:포트]/경로[?질의]" 형태로 맞춘다. 키가 너무 길면 -1이며,
+ * 이때 호출자는 캐시를 거치지 않는다.
+ */
+int cache_make_key(char *key, char *hostname, char *port, char *path) {
+    return url_normalize(key, MAXLINE, hostname, port, path) < 0 ? -1 : 0;
+}
+
+/*
+ * cache_lookup - 키에 해당하는 객체를 찾아 참조를 잡은 채 반환
+ * 적중 시 호출자는 e->data, e->size를 사용한 뒤 반드시 cache_release를
+ * 호출해야 한다. 미스이면 NULL을 반환한다.
+ * 만료되었지만 stale-while-revalidate 기간 안인 객체도 반환하며, 이때
+ * *stalep를 1로 둔다. Vary 변형은 req의 헤더 값으로 고른다.
+ */
+cache_entry_t *cache_lookup(char *key, http_req_t *req, int *stalep) {
+    unsigned long h = hash_key(key);
+    cache_shard_t *sh = shard_of(h);
+
+    cache_entry_t *e;
+
+    tinylfu_record(h);
+    if ((e = lookup(sh, key, h, req, stalep)) == NULL && (e = promote(sh, key, h)) != NULL &&
+        !usable(e, time(NULL), stalep)) {
+        cache_release(e);
+        e = NULL;
+    }
+    return e;
+}
+
+/*
+ * cache_claim_refresh - 만료 객체의 백그라운드 갱신을 맡음
+ * 이미 다른 스레드가 맡았으면 0을 반환하여 갱신이 한 번만 일어나게 한다.
+ */
+int cache_claim_refresh(cache_entry_t *e) {
+    return __atomic_exchange_n(&e->refreshing, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+/*
+ * cache_unclaim_refresh - 갱신에 실패했을 때 다음 적중이 다시 맡을 수 있게 함
+ */
+void cache_unclaim_refresh(cache_entry_t *e) {
+    __atomic_store_n(&e->refreshing, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * cache_lookup_stale - 재검증할 수 있는 객체를 신선도와 관계없이 찾음
+ * 검증자(ETag 또는 Last-Modified)가 있는 객체만 참조를 잡아 반환하며,
+ * 호출자는 사용 후 cache_release해야 한다.
+ */
+cache_entry_t *cache_lookup_stale(char *key, http_req_t *req) {
+    unsigned long h = hash_key(key);
+    cache_shard_t *sh = shard_of(h);
+    cache_entry_t *e;
+
+    pthread_rwlock_rdlock(&sh->index_lock);
+    if ((e = find_entry(sh, key, h, req)) != NULL)
+        __atomic_add_fetch(&e->refcnt, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&sh->index_lock);
+
+    if (!e)
+        e = promote(sh, key, h);
+    if (e && !e->etag_len && e->last_modified <= 0) {
+        cache_release(e);
+        e = NULL;
+    }
+    return e;
+}
+
+/*
+ * cache_revalidate - 304 응답으로 재검증된 객체의 신선도와 헤더를 갱신
+ * head가 주어지면 304 응답 헤더 [head, head + len)를 저장된 헤더에 덮어쓴
+ * 사본(http_merge_head)을 새 객체로 만들어 같은 변형 자리에 교체해 넣는다.
+ * 본문은 그대로 옮기고, 신선도와 검증자는 합친 헤더로 다시 계산해 클라이언트가
+ * 받는 Date, Cache-Control, ETag와 어긋나지 않게 한다. stale-while-revalidate
+ * 기본값은 호출자가 meta에 계산한 것을 따른다.
+ * 헤더를 모으지 못했거나(head == NULL) 이미 캐시에서 빠졌거나 슬랩에 자리가
+ * 없으면 본문과 헤더는 그대로 두고 meta로 만료 시각만 바꿔 회수 타이머를
+ * 다시 건다. 보낼 객체를 참조를 잡아 반환하며 호출자는 보낸 뒤
+ * cache_release해야 한다. e에 대한 호출자의 참조는 그대로 남는다.
+ */
+cache_entry_t *cache_revalidate(cache_entry_t *e, cache_meta_t *meta, char *head, size_t len) {
+    cache_shard_t *sh = shard_of(e->hash);
+    cache_entry_t *fresh = NULL;
+    cache_meta_t m = *meta;
+    http_resp_t resp;
+    size_t hlen, size;
+    char *buf;
+    int live;
+
+    pthread_rwlock_rdlock(&sh->index_lock);
+    live = indexed(sh, e);
+    pthread_rwlock_unlock(&sh->index_lock);
+    if (head && live && (hlen = head_length(e->data, e->size)) > 0) {
+        buf = Malloc(e->size + len);
+        size = http_merge_head(buf, e->data, hlen, head, len);
+        http_resp_init(&resp);
+        http_resp_parse_head(&resp, buf, size);
+        memcpy(buf + size, e->data + hlen, e->size - hlen);
+        size += e->size - hlen;
+
+        m.expires = http_resp_expiry(&resp, time(NULL));
+        m.swr_until = m.expires +
+            (resp.swr >= 0 ? resp.swr : meta->swr_until - meta->expires);
+        m.last_modified = resp.last_modified;
+        m.etag = resp.etag[0] ? resp.etag : NULL;
+        m.vary = e->vary;           /* 변형은 조건부 요청을 보낸 그 변형이다 */
+        m.vhash = e->vhash;
+        if (size <= object_limit && (fresh = new_entry(e->key, e->hash, buf, size, &m)) != NULL) {
+            fresh->refcnt++;        /* 호출자 몫 */
+            insert_entry(sh, fresh, 0);
+        }
+        Free(buf);
+        if (fresh)
+            return fresh;
+    }
+
+    pthread_rwlock_wrlock(&sh->index_lock);
+    e->expires = meta->expires;
+    e->swr_until = meta->swr_until;
+    __atomic_store_n(&e->refreshing, 0, __ATOMIC_RELEASE);
+    if (meta->last_modified > 0)
+        e->last_modified = meta->last_modified;
+    if (indexed(sh, e)) {
+        tw_del(&e->timer);
+        tw_add(&sh->wheel, &e->timer, reclaim_time(e));
+    }
+    pthread_rwlock_unlock(&sh->index_lock);
+    __atomic_add_fetch(&e->refcnt, 1, __ATOMIC_RELAXED);
+    return e;
+}
+
+/*
+ * cache_send - 객체의 응답 바이트 전체를 fd에 씀
+ * 슬랩 청크 안에 통째로 든 memfd 페이지는 sendfile로 커널 안에서 바로
+ * 보내고, 그 앞뒤 조각과 sendfile을 쓸 수 없거나 중간에 실패한 나머지는
+ * rio_writen으로 보낸다. 클라이언트가 끊었으면 -1
+ */
+int cache_send(cache_entry_t *e, int fd) {
+    size_t sent = 0, start, end;
+    ssize_t n;
+    off_t off;
+    int afd;
+
+    if (slab_locate(e->data, e->size, &afd, &off, &start, &end) == 0) {
+        if (rio_writen(fd, e->data, start) != start)
+            return -1;
+        for (sent = start, off += start; sent < end; ) {
+            if ((n = sendfile(fd, afd, &off, end - sent)) > 0)
+                sent += n;
+            else if (n < 0 && errno == EINTR)
+                continue;
+            else if (n < 0 && errno == EAGAIN && rio_wait && rio_wait(fd, 1) == 0)
+                continue;
+            else
+                break;
+        }
+    }
+    if (sent < e->size && rio_writen(fd, e->data + sent, e->size - sent) != e->size - sent)
+        return -1;
+    return 0;
+}
+
+/*
+ * cache_release - cache_lookup으로 잡은 참조를 놓음
+ * 이미 축출된 객체의 마지막 참조였다면 여기서 해제된다.
+ */
+void cache_release(cache_entry_t *e) {
+    if (__atomic_sub_fetch(&e->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        slab_free(e->data);
+        Free(e);
+    }
+}
+
+/*
+ * cache_etag - 객체의 ETag (키 바로 뒤에 붙어 있다). 없으면 NULL
+ */
+char *cache_etag(cache_entry_t *e) {
+    return e->etag_len ? e->key + e->key_len + 1 : NULL;
+}
+
+/*
+ * cache_insert - 객체 복사본을 캐시에 저장
+ * 객체 크기 상한을 넘는 객체는 무시한다.
+ */
+void cache_insert(char *key, char *data, size_t size, cache_meta_t *meta) {
+    unsigned long h = hash_key(key);
+    cache_entry_t *e;
+
+    if (size > object_limit)
+        return;
+    if ((e = new_entry(key, h, data, size, meta)) != NULL)
+        insert_entry(shard_of(h), e, 0);
+}
+
+/*
+ * cache_fetch_begin - 캐시 미스 후 원 서버 요청을 시작하기 전에 호출
+ * 그 사이 객체가 캐시에 들어왔다면 *hitp에 참조를 잡은 객체를 돌려주고
+ * NULL을 반환한다. 그렇지 않으면 진행 중 요청을 반환하며,
+ *   *leaderp == 1: 호출자가 리더. 응답을 cache_fill_*로 채운 뒤(성공이든
+ *                  실패든) 반드시 cache_fetch_end를 호출한다.
+ *   *leaderp == 0: 다른 스레드가 가져오는 중. cache_follow로 따라 읽는다.
+ * 진행 중 요청은 키로만 합친다. 변형이 다르면 cache_follow가 가린다.
+ */
+inflight_t *cache_fetch_begin(char *key, http_req_t *req, cache_entry_t **hitp,
+                              int *leaderp) {
+    unsigned long h = hash_key(key);
+    cache_shard_t *sh = shard_of(h);
+    inflight_t *f;
+
+    pthread_mutex_lock(&sh->flight_lock);
+    for (f = sh->flights; f; f = f->next)
+        if (f->hash == h && strcmp(f->key, key) == 0)
+            break;
+
+    /* 팔로워: 표에 있는 동안은 리더가 참조를 가지고 있으므로 살아 있다.
+     * 나눌 수 없는 응답이거나 객체 없이 끝나 표에서 빠질 차례인 요청,
+     * 다른 변형으로 끝난 요청에는 붙지 않고 새 리더가 된다 */
+    if (f) {
+        pthread_mutex_lock(&f->lock);
+        if ((f->state != FILL_ABORTED || (!f->pass && !f->ended)) &&
+            !(f->ended && f->vary && http_vary_hash(req, f->vary) != f->vhash)) {
+            f->refs++;
+            pthread_mutex_unlock(&f->lock);
+            pthread_mutex_unlock(&sh->flight_lock);
+            *hitp = NULL;
+            *leaderp = 0;
+            return f;
+        }
+        pthread_mutex_unlock(&f->lock);
+    }
+
+    /* 직전 리더가 방금 끝났을 수 있으므로 캐시를 다시 확인 */
+    if ((*hitp = lookup(sh, key, h, req, NULL)) != NULL) {
+        pthread_mutex_unlock(&sh->flight_lock);
+        return NULL;
+    }
+
+    /* 리더로 등록 */
+    f = Calloc(1, sizeof(inflight_t));
+    f->key = Malloc(strlen(key) + 1);
+    strcpy(f->key, key);
+    f->hash = h;
+    f->state = FILL_PENDING;
+    f->refs = 1;
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->cond, NULL);
+    f->next = sh->flights;
+    sh->flights = f;
+    pthread_mutex_unlock(&sh->flight_lock);
+
+    *leaderp = 1;
+    return f;
+}
+
+/*
+ * cache_fill_append - 리더가 클라이언트에 보낸 바이트를 버퍼에 이어 붙임
+ * 객체 크기 상한을 넘으면 채우기를 중단하고 -1을 반환한다.
+ */
+int cache_fill_append(inflight_t *f, char *buf, size_t n) {
+    int rc = 0;
+
+    pthread_mutex_lock(&f->lock);
+    if (f->state == FILL_ABORTED) {
+        rc = -1;
+    } else if (f->len + n > object_limit) {
+        f->state = FILL_ABORTED;
+        wake_followers(f);
+        rc = -1;
+    } else {
+        if (f->len + n > f->cap) {
+            f->cap = f->cap ? f->cap * 2 : MAXBUF;
+            while (f->cap < f->len + n)
+                f->cap *= 2;
+            if (f->cap > object_limit)
+                f->cap = object_limit;
+            f->data = Realloc(f->data, f->cap);
+        }
+        memcpy(f->data + f->len, buf, n);
+        f->len += n;
+        if (f->state == FILL_STREAMING)
+            wake_followers(f);
+    }
+    pthread_mutex_unlock(&f->lock);
+
+    return rc;
+}
+
+/*
+ * cache_fill_open - 헤더를 보고 캐시 가능하다고 판정되면 호출
+ * 이때부터 팔로워가 헤더를 포함한 버퍼를 따라 읽기 시작한다.
+ * meta는 완성된 객체의 만료 시각과 검증자이다. Vary 목록을 인턴하지
+ * 못하면(표가 가득 참) 캐시하지 않는 응답처럼 채우기를 중단한다.
+ */
+void cache_fill_open(inflight_t *f, cache_meta_t *meta) {
+    pthread_mutex_lock(&f->lock);
+    f->expires = meta->expires;
+    f->swr_until = meta->swr_until;
+    f->last_modified = meta->last_modified;
+    if (meta->etag) {
+        f->etag = Malloc(strlen(meta->etag) + 1);
+        strcpy(f->etag, meta->etag);
+    }
+    if (meta->vary) {
+        f->vary = intern(meta->vary);
+        f->vhash = meta->vhash;
+    }
+    if (f->state == FILL_PENDING)
+        f->state = meta->vary && !f->vary ? FILL_ABORTED : FILL_STREAMING;
+    wake_followers(f);
+    pthread_mutex_unlock(&f->lock);
+}
+
+/*
+ * cache_fill_share - 저장할 수 없지만 다른 클라이언트에게 보내도 되는
+ * 응답(no-cache, 이미 만료, 200이 아닌 상태 등)일 때 cache_fill_open 대신 호출
+ * 팔로워는 버퍼를 따라 읽지만 cache_fetch_end에서 캐시에 넣지 않는다.
+ */
+void cache_fill_share(inflight_t *f, cache_meta_t *meta) {
+    pthread_mutex_lock(&f->lock);
+    f->share_only = 1;
+    pthread_mutex_unlock(&f->lock);
+    cache_fill_open(f, meta);
+}
+
+/*
+ * cache_fill_abort - 너무 크거나 잘린 응답, 원 서버 오류, 재검증일 때 호출
+ * 기다리던 팔로워는 리더가 끝날 때까지 기다렸다가(큰 객체 계층에 들어갔거나
+ * 재검증된 사본이 있을 수 있음) 캐시를 다시 보고, 없으면 그중 하나가 새
+ * 리더가 되어 다시 가져온다.
+ */
+void cache_fill_abort(inflight_t *f) {
+    pthread_mutex_lock(&f->lock);
+    f->state = FILL_ABORTED;
+    wake_followers(f);
+    pthread_mutex_unlock(&f->lock);
+}
+
+/*
+ * cache_fill_pass - 다른 클라이언트에게 보낼 수 없는 응답(private,
+ * no-store)이거나 어느 계층에도 남지 않을 큰 응답일 때 호출. 팔로워는 새
+ * 리더를 뽑아 줄 서지 않고 곧바로 각자 가져온다.
+ */
+void cache_fill_pass(inflight_t *f) {
+    pthread_mutex_lock(&f->lock);
+    f->pass = 1;
+    f->state = FILL_ABORTED;
+    wake_followers(f);
+    pthread_mutex_unlock(&f->lock);
+}
+
+/*
+ * cache_fetch_end - 리더의 원 서버 요청이 끝났음을 알림
+ * 끝까지 채워진 응답은 (나누기만 하는 응답이 아니면) 슬랩 청크로 옮겨
+ * 캐시 객체로 저장하고, 따라 읽던 팔로워를 깨운 뒤 리더의 참조를 놓는다.
+ */
+void cache_fetch_end(inflight_t *f) {
+    cache_shard_t *sh = shard_of(f->hash);
+    cache_entry_t *e = NULL;
+    inflight_t **pp;
+
+    int done;
+
+    pthread_mutex_lock(&f->lock);
+    done = (f->state == FILL_STREAMING && f->len > 0);
+    f->state = done ? FILL_DONE : FILL_ABORTED;
+    f->ended = 1;
+    wake_followers(f);
+    pthread_mutex_unlock(&f->lock);
+
+    /* 리더만 버퍼를 채우므로 완료 후에는 락 없이 읽어도 된다. 팔로워가
+     * 아직 읽는 버퍼는 마지막 flight_put까지 남는다.
+     * 캐시에 넣은 뒤 표에서 빼야 새로 오는 요청이 둘 다 놓치지 않는다.
+     * 승인이 거부되면 insert_entry가 캐시 참조를 놓는다. */
+    if (done && !f->share_only) {
+        cache_meta_t meta = { f->expires, f->swr_until, f->last_modified, f->etag,
+                              f->vary, f->vhash };
+        if ((e = new_entry(f->key, f->hash, f->data, f->len, &meta)) != NULL)
+            insert_entry(sh, e, 0);
+    }
+
+    pthread_mutex_lock(&sh->flight_lock);
+    for (pp = &sh->flights; *pp; pp = &(*pp)->next) {
+        if (*pp == f) {
+            *pp = f->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sh->flight_lock);
+
+    flight_put(f);
+}
+
+/*
+ * cache_follow - 팔로워가 진행 중 요청의 버퍼를 따라 읽으며 fd로 보냄
+ * 반환값: 1 응답 전체를 보냄, -1 보내던 중 리더가 중단했거나(응답이 잘림)
+ *          클라이언트가 끊음,
+ *        2 리더가 아무것도 남기지 못하고 끝남. 캐시를 다시 보고
+ *          cache_fetch_begin으로 돌아가면 기다리던 팔로워 중 하나만 새
+ *          리더가 된다.
+ *        0 응답을 나눌 수 없음(cache_fill_pass). 직접 가져와야 한다.
+ * 응답에 Vary가 있는데 req가 리더와 다른 변형을 원하면 아무것도 보내지 않고
+ * 리더가 끝나기를 기다려 2를 반환한다(나눌 수 없는 응답이면 0).
+ * rio_wait 훅이 걸려 있으면(코루틴 엔진) 조건 변수에서 스레드를 재우는
+ * 대신 자기 eventfd를 훅으로 기다린다. 코루틴만 멈추므로 같은 루프에
+ * 있는 리더도 계속 돈다.
+ */
+int cache_follow(inflight_t *f, http_req_t *req, int fd) {
+    char buf[MAXBUF];
+    fill_waiter_t w = { -1, NULL };
+    size_t sent = 0, n;
+    int rc, gone = 0;
+
+    if (rio_wait)
+        w.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_lock(&f->lock);
+    if (w.fd >= 0) {
+        w.next = f->waiters;
+        f->waiters = &w;
+    }
+    for (;;) {
+        while (f->state == FILL_PENDING ||
+               (f->state == FILL_STREAMING && sent == f->len) ||
+               (f->state == FILL_ABORTED && !sent && !f->pass && !f->ended))
+            follow_wait(f, &w);
+        if (f->state == FILL_ABORTED || sent == f->len)
+            break;
+        if (sent == 0 && f->vary && http_vary_hash(req, f->vary) != f->vhash) {
+            /* 다른 변형: 리더가 끝날 때까지 기다려야 다시 줄 설 때 이 요청에
+             * 붙지 않고 같은 변형을 원하는 팔로워끼리 모인다 */
+            while (!f->ended)
+                follow_wait(f, &w);
+            break;
+        }
+
+        /* 리더가 버퍼를 늘릴 수 있으므로 락 안에서 복사하고 밖에서 쓴다 */
+        n = f->len - sent;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        memcpy(buf, f->data + sent, n);
+        pthread_mutex_unlock(&f->lock);
+        gone = (rio_writen(fd, buf, n) != n);
+        sent += n;
+        pthread_mutex_lock(&f->lock);
+        if (gone)
+            break;
+    }
+    if (gone)
+        rc = -1;
+    else if (f->state == FILL_DONE && sent == f->len)
+        rc = 1;
+    else if (sent)
+        rc = -1;
+    else
+        rc = f->pass ? 0 : 2;
+    unwatch(f, &w);
+    pthread_mutex_unlock(&f->lock);
+    if (w.fd >= 0)
+        close(w.fd);
+
+    flight_put(f);
+    return rc;
+}
+
+/*
+ * cache_unfollow - 따라 읽지 않기로 한 팔로워가 cache_fetch_begin에서 잡은
+ * 참조를 놓음
+ */
+void cache_unfollow(inflight_t *f) {
+    flight_put(f);
+}
+
+/*
+ * cache_purge - 키가 key인 객체(prefix면 key로 시작하는 모든 객체)를
+ * 메모리 캐시에서 뺌. 변형도 각각 세어 뺀 객체 수를 반환한다.
+ * 정확한 키는 그 키의 샤드만, 접두사는 모든 샤드의 기수 트리를 찾는다.
+ * 이미 보내는 중인 적중은 참조가 놓일 때까지 끝까지 보낸다.
+ */
+int cache_purge(char *key, int prefix) {
+    cache_shard_t *sh;
+    char **list;
+    int i, j, n, purged = 0;
+
+    for (i = 0; i < shard_count; i++) {
+        sh = &shards[i];
+        if (!prefix && sh != shard_of(hash_key(key)))
+            continue;
+        pthread_rwlock_wrlock(&sh->index_lock);
+        if (!prefix) {
+            purged += remove_key(sh, key);
+        } else {
+            n = radix_collect(&sh->keys, key, &list);
+            for (j = 0; j < n; j++)
+                purged += remove_key(sh, list[j]);
+            radix_free_keys(list, n);
+        }
+        pthread_rwlock_unlock(&sh->index_lock);
+    }
+    return purged;
+}
+
+/*
+ * hash_key - 문자열 키의 64비트 FNV-1a 해시
+ * 하위 비트는 버킷, 상위 비트는 샤드 선택에 쓰인다. FNV-1a는 끝 몇 바이트가
+ * 상위 비트에 거의 닿지 않아 /objects/1, /objects/2 같은 키가 한 샤드에
+ * 몰리므로, 마지막에 비트를 섞어(murmur3 fmix64) 모든 바이트가 퍼지게 한다.
+ */
+static unsigned long hash_key(char *key) {
+    unsigned long h = 14695981039346656037UL;
+
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 1099511628211UL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdUL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53UL;
+    h ^= h >> 33;
+    return h;
+}
+
+static cache_shard_t *shard_of(unsigned long hash) {
+    return shard_count == 1 ? &shards[0] : &shards[hash >> shard_shift];
+}
+
+/*
+ * find_entry - 샤드 인덱스에서 키와 req에 맞는 변형 검색
+ * (index_lock을 잡은 상태에서 호출)
+ * 같은 키의 변형은 모두 같은 Vary 목록을 가지므로 처음 만난 변형으로
+ * 보조 해시를 한 번만 구한다.
+ */
+static cache_entry_t *find_entry(cache_shard_t *sh, char *key, unsigned long hash,
+                                 http_req_t *req) {
+    cache_entry_t *e;
+    unsigned long vhash = 0;
+    int first = 1;
+
+    size_t len = strlen(key);
+
+    for (e = sh->buckets[hash & (CACHE_BUCKETS - 1)]; e; e = e->hnext) {
+        if (!same_key(e, hash, key, len))
+            continue;
+        if (!e->vary)
+            return e;
+        if (first) {
+            vhash = http_vary_hash(req, e->vary);
+            first = 0;
+        }
+        if (e->vhash == vhash)
+            return e;
+    }
+    return NULL;
+}
+
+/*
+ * indexed - e가 아직 샤드 인덱스에 있는지 (index_lock을 잡은 상태에서 호출)
+ */
+static int indexed(cache_shard_t *sh, cache_entry_t *e) {
+    cache_entry_t *x;
+
+    for (x = sh->buckets[e->hash & (CACHE_BUCKETS - 1)]; x; x = x->hnext)
+        if (x == e)
+            return 1;
+    return 0;
+}
+
+/*
+ * old_variants - 새 변형 e가 들어가면 URI의 변형 상한을 넘을 때 빼야 할
+ * 변형들을 오래된 것부터 drop에 담고 그 수를 반환 (많아야 CACHE_MAX_VARIANTS개)
+ * 체인 머리에 삽입하므로 체인에서 나중에 만나는 변형일수록 오래되었다.
+ */
+static int old_variants(cache_shard_t *sh, cache_entry_t *e, cache_entry_t **drop) {
+    cache_entry_t *x, *vars[CACHE_MAX_VARIANTS];
+    size_t count = 0, bytes = e->size;
+    int n = 0;
+
+    for (x = sh->buckets[e->hash & (CACHE_BUCKETS - 1)]; x; x = x->hnext) {
+        if (same_key(x, e->hash, e->key, e->key_len) && count < CACHE_MAX_VARIANTS) {
+            vars[count++] = x;
+            bytes += x->size;
+        }
+    }
+    while (count + 1 > CACHE_MAX_VARIANTS || (count > 0 && bytes > CACHE_VARIANT_BYTES)) {
+        drop[n++] = vars[--count];
+        bytes -= vars[count]->size;
+    }
+    return n;
+}
+
+/*
+ * same_key - e의 키가 key인지. 첫 캐시 라인의 해시와 길이가 맞을 때만
+ * 키 바이트를 비교한다.
+ */
+static int same_key(cache_entry_t *e, unsigned long hash, char *key, size_t len) {
+    return e->hash == hash && e->key_len == len && memcmp(e->key, key, len) == 0;
+}
+
+/*
+ * lookup - 인덱스에서 객체를 찾아 정책에 적중을 알리고 참조를 잡아 반환
+ * stalep가 NULL이면 신선한 객체만, 아니면 stale-while-revalidate 기간
+ * 안의 만료 객체도 찾는다.
+ */
+static cache_entry_t *lookup(cache_shard_t *sh, char *key, unsigned long hash,
+                             http_req_t *req, int *stalep) {
+    cache_entry_t *e;
+
+    pthread_rwlock_rdlock(&sh->index_lock);
+    if ((e = find_entry(sh, key, hash, req)) != NULL && !usable(e, time(NULL), stalep))
+        e = NULL;                   /* 만료: 재검증하거나 reaper가 회수한다 */
+    if (e) {
+        __atomic_add_fetch(&e->refcnt, 1, __ATOMIC_RELAXED);
+        cache_policy->hit(&sh->policy, e);
+    }
+    pthread_rwlock_unlock(&sh->index_lock);
+
+    return e;
+}
+
+/*
+ * usable - 객체를 지금 응답에 쓸 수 있는지 판정
+ * 신선하면 1. 만료되었어도 stalep가 주어지고 stale-while-revalidate
+ * 기간 안이면 *stalep를 1로 두고 1을 반환한다.
+ */
+static int usable(cache_entry_t *e, time_t now, int *stalep) {
+    if (stalep)
+        *stalep = 0;
+    if (e->expires > now)
+        return 1;
+    if (stalep && now < e->swr_until) {
+        *stalep = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * promote - 디스크 계층에서 객체를 찾아 메모리 캐시로 올림
+ * 참조를 하나 잡은 객체를 반환하며, 그 사이 다른 스레드가 같은 키를
+ * 넣었으면 그쪽을 덮어쓰지 않는다. 신선도 판정은 호출자가 한다.
+ */
+static cache_entry_t *promote(cache_shard_t *sh, char *key, unsigned long hash) {
+    cache_meta_t meta;
+    cache_entry_t *e;
+    size_t size;
+    char *data;
+
+    if (!disk_enabled() || (data = disk_get(key, &size, &meta)) == NULL)
+        return NULL;
+
+    e = size <= object_limit ? new_entry(key, hash, data, size, &meta) : NULL;
+    Free(data);
+    if (meta.etag)
+        Free(meta.etag);
+    if (!e)
+        return NULL;
+    if (reclaim_time(e) <= time(NULL)) {
+        cache_release(e);
+        return NULL;
+    }
+    e->refcnt++;                    /* 호출자의 참조 */
+    insert_entry(sh, e, 1);
+    return e;
+}
+
+/*
+ * persist - 객체를 디스크 계층에 기록 (호출자가 참조를 잡고 있어야 함)
+ * 디스크 계층은 키 하나에 레코드 하나이므로 Vary 변형은 기록하지 않는다.
+ */
+static void persist(cache_entry_t *e) {
+    cache_meta_t meta;
+
+    if (e->vary)
+        return;
+
+    meta.expires = e->expires;
+    meta.swr_until = e->swr_until;
+    meta.last_modified = e->last_modified;
+    meta.etag = cache_etag(e);
+    meta.vary = NULL;
+    meta.vhash = 0;
+    disk_put(e->key, e->data, e->size, &meta);
+}
+
+/*
+ * demote - 축출된 객체 목록(hnext로 연결) 중 디스크 사본이 밀려난 것을
+ * 다시 내리고 목록이 가진 참조를 놓음. 샤드 락 밖에서 호출한다.
+ */
+static void demote(cache_entry_t *victims) {
+    cache_entry_t *e;
+
+    while ((e = victims) != NULL) {
+        victims = e->hnext;
+        if (!disk_contains(e->key))
+            persist(e);
+        cache_release(e);
+    }
+}
+
+/*
+ * new_entry - data를 슬랩 청크로 복사한 캐시 객체 생성 (캐시 참조 1개)
+ * 슬랩 클래스에 자리를 만들지 못하면 NULL
+ */
+static cache_entry_t *new_entry(char *key, unsigned long hash, char *data, size_t size,
+                                cache_meta_t *meta) {
+    origin_t *org = origin_get(key);
+    size_t key_len = strlen(key), etag_len = meta->etag ? strlen(meta->etag) : 0;
+    const char *vary = NULL;
+    cache_entry_t *e;
+    char *chunk;
+    int rc;
+
+    if (key_len >= MAXLINE || (meta->vary && (vary = intern(meta->vary)) == NULL))
+        return NULL;
+    if (etag_len >= HTTP_ETAG_MAX)
+        etag_len = 0;               /* 너무 긴 ETag는 버리고 Last-Modified로만 재검증 */
+
+    /* 할당량을 넘은 호스트는 슬랩 축출로도 다른 호스트 객체를 밀어내지 못함 */
+    if ((chunk = slab_alloc(size, origin_over(org, size) ? org : NULL)) == NULL)
+        return NULL;
+    memcpy(chunk, data, size);
+    rc = posix_memalign((void **)&e, 64, offsetof(cache_entry_t, key) + key_len + 1 +
+                        (etag_len ? etag_len + 1 : 0));
+    if (rc != 0)
+        posix_error(rc, "posix_memalign error");
+
+    memcpy(e->key, key, key_len + 1);
+    e->key_len = key_len;
+    e->etag_len = etag_len;
+    if (etag_len)
+        memcpy(e->key + key_len + 1, meta->etag, etag_len + 1);
+    e->data = chunk;
+    e->size = size;
+    e->hash = hash;
+    e->expires = meta->expires;
+    e->swr_until = meta->swr_until;
+    e->last_modified = meta->last_modified;
+    e->origin = org;
+    e->vary = vary;
+    e->vhash = vary ? meta->vhash : 0;
+    e->timer.prev = e->timer.next = NULL;
+    e->refcnt = 1;                  /* 캐시가 가진 참조 */
+    e->referenced = 0;
+    e->segment = 0;
+    e->freq = 0;
+    e->heap_idx = 0;
+    e->priority = 0;
+    e->refreshing = 0;
+    return e;
+}
+
+/*
+ * reclaim_time - 객체를 캐시에서 회수할 시각
+ * 검증자가 있으면 재검증할 수 있도록 만료 후에도 잠시 남겨 두고,
+ * stale-while-revalidate 기간이 더 길면 그때까지 남겨 둔다.
+ */
+static time_t reclaim_time(cache_entry_t *e) {
+    time_t t = e->expires;
+
+    if (e->etag_len || e->last_modified > 0)
+        t += CACHE_STALE_KEEP;
+    return e->swr_until > t ? e->swr_until : t;
+}
+
+/*
+ * insert_entry - 객체를 샤드에 넣음. 받아들였으면 1, 거부했으면 0
+ * 샤드 공간이 부족하면 축출 정책이 고른 후보를 밀어내 자리를 만든다.
+ * 이때 TinyLFU가 축출 후보 쪽이 더 자주 쓰인다고 판단하면 새 객체를
+ * 받아들이지 않고 캐시 참조를 놓는다. 호스트 할당량을 넘은 후보는 승인
+ * 필터 없이 축출하고, 새 객체의 호스트가 할당량을 넘었으면 할당량 안의
+ * 후보를 밀어내지 않는다. 같은 변형이 이미 있으면 승인 검사
+ * 없이 교체하고, 같은 키의 다른 변형은 Vary 목록이 같을 때만 남기되
+ * URI별 변형 상한을 넘으면 오래된 것부터 뺀다. 디스크에서 올린
+ * 객체(from_disk)는 그 사이 들어온 같은 키의 객체를 덮지 않는다.
+ * 밀어낼 변형과 축출 후보는 먼저 모으기만 하고 승인이 정해진 뒤에
+ * 빼므로, 거부되면 아무것도 잃지 않는다(정책에서 뗀 후보는 restore로
+ * 되돌린다).
+ * 락을 놓은 뒤 원 서버에서 온 객체는 승인 여부와 관계없이 디스크에
+ * 기록하고(변형이면 예전 사본을 지운다), 축출된 객체 중 아직 회수 시각
+ * 전인 것은 디스크로 내린다.
+ */
+static int insert_entry(cache_shard_t *sh, cache_entry_t *e, int from_disk) {
+    cache_entry_t *old, **pp, *victim, *victims = NULL;
+    cache_entry_t *drop[CACHE_MAX_VARIANTS], **taken = NULL;
+    unsigned long h = e->hash;
+    time_t now = time(NULL);
+    size_t need, ntaken = 0, cap = 0;
+    int refresh = 0, admitted = 1, over, ndrop, i;
+
+    if (!from_disk && disk_enabled())
+        __atomic_add_fetch(&e->refcnt, 1, __ATOMIC_RELAXED);    /* persist 동안 */
+    pthread_rwlock_wrlock(&sh->index_lock);
+
+    /* 같은 키의 기존 객체: 같은 변형이거나 Vary 목록이 바뀌었으면 교체.
+     * 교체는 승인 검사를 거치지 않으므로 바로 뺀다 */
+    for (pp = &sh->buckets[h & (CACHE_BUCKETS - 1)]; (old = *pp) != NULL; ) {
+        if (!same_key(old, h, e->key, e->key_len)) {
+            pp = &old->hnext;
+            continue;
+        }
+        if (from_disk) {
+            pthread_rwlock_unlock(&sh->index_lock);
+            cache_release(e);
+            return 0;
+        }
+        if (old->vary == e->vary && old->vhash != e->vhash) {
+            pp = &old->hnext;
+            continue;
+        }
+        remove_entry(sh, old);      /* *pp는 old 다음 객체가 된다 */
+        refresh = 1;
+    }
+    ndrop = old_variants(sh, e, drop);
+    need = sh->bytes + e->size;
+    for (i = 0; i < ndrop; i++)
+        need -= drop[i]->size;
+
+    /* 공간 확보: 축출 후보는 정책에서 떼어 모으기만 한다. 할당량 안의
+     * 후보는 승인 필터로 비교하고, 밀어낼 변형이 후보로 나오면 이미 센
+     * 것이므로 떼기만 한다 */
+    over = origin_over(e->origin, e->size);
+    while (need > sh->capacity && (victim = cache_policy->victim(&sh->policy)) != NULL) {
+        for (i = 0; i < ndrop && drop[i] != victim; i++)
+            ;
+        if (i < ndrop) {
+            drop[i] = NULL;
+        } else if (!refresh && !origin_over(victim->origin, 0) &&
+                   ((over && victim->origin != e->origin) ||
+                    !tinylfu_admit(h, victim->hash))) {
+            admitted = 0;
+            break;
+        } else {
+            need -= victim->size;
+        }
+        cache_policy->remove(&sh->policy, victim);
+        if (ntaken == cap) {
+            cap = cap ? cap * 2 : 16;
+            taken = Realloc(taken, cap * sizeof(cache_entry_t *));
+        }
+        taken[ntaken++] = victim;
+    }
+
+    if (admitted) {
+        for (i = 0; i < ndrop; i++)
+            if (drop[i])
+                remove_entry(sh, drop[i]);
+        for (i = 0; i < ntaken; i++) {
+            victim = taken[i];
+            if (disk_enabled() && reclaim_time(victim) > now) {
+                __atomic_add_fetch(&victim->refcnt, 1, __ATOMIC_RELAXED);
+                unlink_entry(sh, victim);
+                victim->hnext = victims;    /* 인덱스에서 빠졌으므로 목록 연결에 재사용 */
+                victims = victim;
+            } else {
+                unlink_entry(sh, victim);
+            }
+        }
+        e->hnext = sh->buckets[h & (CACHE_BUCKETS - 1)];
+        sh->buckets[h & (CACHE_BUCKETS - 1)] = e;
+        cache_policy->insert(&sh->policy, e);
+        radix_insert(&sh->keys, e->key, e->key_len);
+        tw_add(&sh->wheel, &e->timer, reclaim_time(e));
+        sh->bytes += e->size;
+        origin_charge(e->origin, e->size, 1);
+        slab_set_owner(e->data, e);
+    } else {
+        while (ntaken > 0)
+            cache_policy->restore(&sh->policy, taken[--ntaken]);
+    }
+
+    pthread_rwlock_unlock(&sh->index_lock);
+    if (taken)
+        Free(taken);
+
+    if (!from_disk && disk_enabled()) {
+        if (e->vary)
+            disk_remove(e->key);    /* 변형이 생기기 전의 사본이 올라오지 않게 */
+        else
+            persist(e);             /* 메모리 승인과 별개로 디스크에는 남긴다 */
+        cache_release(e);
+    }
+    if (!admitted)
+        cache_release(e);
+    demote(victims);
+    return admitted;
+}
+
+/*
+ * wake_followers - f->lock을 쥔 채 불러 기다리는 팔로워를 모두 깨움
+ */
+static void wake_followers(inflight_t *f) {
+    uint64_t one = 1;
+    fill_waiter_t *w;
+
+    pthread_cond_broadcast(&f->cond);
+    for (w = f->waiters; w; w = w->next)
+        if (write(w->fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            fprintf(stderr, "eventfd write error: %s\n", strerror(errno));
+}
+
+/*
+ * follow_wait - f->lock을 쥔 채 불러 리더가 알릴 때까지 기다림
+ * 팔로워에게 eventfd가 있으면 락을 놓고 rio_wait 훅으로 기다린 뒤 쌓인
+ * 알림을 비운다. 훅이 실패하면 그 팔로워는 조건 변수로 돌아간다.
+ */
+static void follow_wait(inflight_t *f, fill_waiter_t *w) {
+    uint64_t count;
+
+    if (w->fd < 0) {
+        pthread_cond_wait(&f->cond, &f->lock);
+        return;
+    }
+    pthread_mutex_unlock(&f->lock);
+    if (rio_wait(w->fd, 0) < 0) {
+        pthread_mutex_lock(&f->lock);
+        unwatch(f, w);
+        close(w->fd);
+        w->fd = -1;
+        return;
+    }
+    while (read(w->fd, &count, sizeof(count)) > 0)
+        ;
+    pthread_mutex_lock(&f->lock);
+}
+
+/*
+ * unwatch - f->lock을 쥔 채 불러 팔로워 w를 알림 목록에서 뺌
+ */
+static void unwatch(inflight_t *f, fill_waiter_t *w) {
+    fill_waiter_t **pp;
+
+    if (w->fd < 0)
+        return;
+    for (pp = &f->waiters; *pp; pp = &(*pp)->next) {
+        if (*pp == w) {
+            *pp = w->next;
+            break;
+        }
+    }
+}
+
+/*
+ * flight_put - 진행 중 요청의 참조를 놓고 마지막이면 해제
+ * 완료된 요청의 버퍼는 캐시 객체가 소유하므로 그 참조만 놓는다.
+ */
+static void flight_put(inflight_t *f) {
+    int last;
+
+    pthread_mutex_lock(&f->lock);
+    last = (--f->refs == 0);
+    pthread_mutex_unlock(&f->lock);
+    if (!last)
+        return;
+
+    if (f->data)
+        Free(f->data);
+    pthread_cond_destroy(&f->cond);
+    pthread_mutex_destroy(&f->lock);
+    if (f->etag)
+        Free(f->etag);
+    Free(f->key);
+    Free(f);
+}
+
+/*
+ * head_length - 저장된 응답에서 상태줄부터 빈 줄까지의 길이. 빈 줄이 없으면 0
+ */
+static size_t head_length(char *data, size_t size) {
+    size_t i;
+
+    for (i = 0; i + 4 <= size; i++)
+        if (memcmp(data + i, "\r\n\r\n", 4) == 0)
+            return i + 4;
+    return 0;
+}
+
+/*
+ * remove_entry - 객체를 인덱스와 정책 상태에서 떼어내고 캐시의 참조를 놓음
+ * 샤드의 index_lock을 쓰기 모드로 잡은 상태에서 호출한다.
+ */
+static void remove_entry(cache_shard_t *sh, cache_entry_t *e) {
+    cache_policy->remove(&sh->policy, e);
+    unlink_entry(sh, e);
+}
+
+/*
+ * unlink_entry - 정책에서 이미 뗀 객체를 인덱스, 키 트리, 타이머에서
+ * 떼어내고 캐시의 참조를 놓음 (index_lock 쓰기 모드)
+ */
+static void unlink_entry(cache_shard_t *sh, cache_entry_t *e) {
+    cache_entry_t **pp;
+
+    for (pp = &sh->buckets[e->hash & (CACHE_BUCKETS - 1)]; *pp; pp = &(*pp)->hnext) {
+        if (*pp == e) {
+            *pp = e->hnext;
+            break;
+        }
+    }
+    radix_remove(&sh->keys, e->key, e->key_len);
+    tw_del(&e->timer);
+    sh->bytes -= e->size;
+    origin_charge(e->origin, e->size, 0);
+    cache_release(e);
+}
+
+/*
+ * remove_key - 키의 모든 변형을 샤드에서 뺌. 뺀 객체 수를 반환한다.
+ * 샤드의 index_lock을 쓰기 모드로 잡은 상태에서 호출한다.
+ */
+static int remove_key(cache_shard_t *sh, char *key) {
+    unsigned long h = hash_key(key);
+    size_t len = strlen(key);
+    cache_entry_t *e, **pp;
+    int n = 0;
+
+    for (pp = &sh->buckets[h & (CACHE_BUCKETS - 1)]; (e = *pp) != NULL; ) {
+        if (!same_key(e, h, key, len)) {
+            pp = &e->hnext;
+            continue;
+        }
+        remove_entry(sh, e);        /* *pp는 e 다음 객체가 된다 */
+        n++;
+    }
+    return n;
+}
+
+/*
+ * reaper - 1초마다 모든 샤드의 타이머 휠을 돌려 만료된 객체를 회수
+ */
+static void *reaper(void *vargp) {
+    int i;
+
+    Pthread_detach(pthread_self());
+    while (1) {
+        sleep(1);
+        for (i = 0; i < shard_count; i++) {
+            pthread_rwlock_wrlock(&shards[i].index_lock);
+            tw_advance(&shards[i].wheel, time(NULL), expire_entry, &shards[i]);
+            pthread_rwlock_unlock(&shards[i].index_lock);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * expire_entry - 타이머 휠 콜백: 만료된 객체를 캐시에서 제거
+ */
+static void expire_entry(tw_node_t *node, void *arg) {
+    cache_entry_t *e = (cache_entry_t *)((char *)node - offsetof(cache_entry_t, timer));
+
+    remove_entry((cache_shard_t *)arg, e);
+}
+
+/*
+ * pin_entry - 슬랩 축출 후보가 아직 해제 중이 아니면 참조를 잡음
+ * ctx는 할당량을 넘은 채 할당하는 호스트(아니면 NULL)이며, 이때는 그
+ * 호스트 자신이나 역시 할당량을 넘은 호스트의 객체만 축출한다.
+ * 슬랩 클래스 락 안에서 불리므로 원자 연산만 쓴다.
+ */
+static int pin_entry(void *owner, void *ctx) {
+    cache_entry_t *e = owner;
+    int n = __atomic_load_n(&e->refcnt, __ATOMIC_RELAXED);
+
+    if (ctx && e->origin != ctx && !origin_over(e->origin, 0))
+        return 0;
+
+    while (n > 0)
+        if (__atomic_compare_exchange_n(&e->refcnt, &n, n + 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return 1;
+    return 0;
+}
+
+/*
+ * evict_entry - 슬랩 클래스에 자리를 만들기 위해 객체를 샤드에서 뺌
+ * 정책 축출처럼 회수 시각 전인 객체는 디스크로 내리고 pin 참조를 놓는다.
+ */
+static void evict_entry(void *owner) {
+    cache_entry_t *e = owner;
+    cache_shard_t *sh = shard_of(e->hash);
+    int removed = 0;
+
+    pthread_rwlock_wrlock(&sh->index_lock);
+    if (indexed(sh, e)) {
+        remove_entry(sh, e);
+        removed = 1;
+    }
+    pthread_rwlock_unlock(&sh->index_lock);
+
+    if (removed && disk_enabled() && reclaim_time(e) > time(NULL)) {
+        e->hnext = NULL;
+        demote(e);
+    } else {
+        cache_release(e);
+    }
+}
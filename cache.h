@@ -0,0 +1,133 @@
+/*
+ * cache.h - 프록시 서버의 인메모리 객체 캐시 인터페이스
+ */
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "csapp.h"
+#include "http.h"
+#include "timerwheel.h"
+#include <stdint.h>
+
+/* 프록시 서버의 캐시 관련 상수 정의 */
+#define MAX_CACHE_SIZE 1049000  /* 최대 캐시 크기 (약 1MB) */
+#define MAX_OBJECT_SIZE 102400  /* 캐시 가능한 최대 객체 크기 (약 100KB) */
+
+#define CACHE_BUCKETS 1024      /* 샤드당 해시 인덱스 버킷 수 (2의 거듭제곱) */
+#define CACHE_DEFAULT_SHARDS 8  /* 기본 샤드 수: 샤드 몫이 MAX_OBJECT_SIZE 이상이 되도록 */
+#define CACHE_MAX_SHARDS 256    /* 최대 샤드 수 */
+#define CACHE_STALE_KEEP 3600   /* 검증자가 있는 객체를 만료 후 재검증용으로 남겨 둘 시간(초) */
+#define CACHE_MAX_VARIANTS 8    /* URI 하나가 가질 수 있는 Vary 변형 수 */
+#define CACHE_VARIANT_BYTES (2 * MAX_OBJECT_SIZE)  /* URI 하나의 변형들이 차지할 바이트 상한 */
+
+/* 원 서버 응답에서 얻은 객체의 신선도와 검증자 */
+typedef struct {
+    time_t expires;                 /* 신선도를 잃는 시각 */
+    time_t swr_until;               /* 이 시각까지는 만료 후에도 바로 응답하고 뒤에서 갱신 */
+    time_t last_modified;           /* Last-Modified (-1이면 없음) */
+    char *etag;                     /* ETag (NULL이면 없음) */
+    const char *vary;               /* 응답의 Vary 헤더 이름 목록 (NULL이면 없음) */
+    unsigned long vhash;            /* Vary가 가리킨 요청 헤더 값의 보조 해시 */
+} cache_meta_t;
+
+/*
+ * 캐시 객체: 원 서버 응답 전체(상태줄 + 헤더 + 본문)를 보관
+ * refcnt는 캐시 자신이 가진 참조 1개 + 객체를 클라이언트에 쓰고 있는
+ * 스레드 수이다. 축출되어 인덱스에서 떨어진 뒤에도 마지막 참조가
+ * cache_release될 때까지 메모리는 살아 있다.
+ * 응답에 Vary가 있으면 같은 키에 변형이 여럿 생긴다. 변형들은 키 해시가
+ * 같아 한 버킷 체인에 모이며, vhash로 서로 구별한다.
+ *
+ * 객체 머리는 64바이트 경계에 할당한다. 버킷 체인을 걷고 적중을 판정하는
+ * 필드는 첫 캐시 라인에, 정책과 재검증용 필드는 둘째 라인에 두고, 키와
+ * ETag 바이트는 머리 바로 뒤(key[])에 NUL로 끝내 이어 붙인다. Vary
+ * 목록은 인턴 표(intern.c)의 공유 문자열을 가리킨다.
+ */
+typedef struct cache_entry {
+    /* 첫 캐시 라인: 조회 경로 */
+    struct cache_entry *hnext;      /* 해시 버킷 체인 */
+    unsigned long hash;             /* 키의 해시 (샤드와 버킷 선택) */
+    unsigned long vhash;            /* 변형을 고르는 보조 해시 */
+    const char *vary;               /* 인턴한 Vary 헤더 이름 목록 (NULL이면 변형 없음) */
+    time_t expires;                 /* 신선도를 잃는 시각 */
+    char *data;                     /* 응답 바이트 (슬랩 청크) */
+    uint32_t size;                  /* 응답 크기 (MAX_OBJECT_SIZE 이하) */
+    int refcnt;                     /* 참조 수 (원자적으로 갱신) */
+    uint16_t key_len;               /* 키 길이 (MAXLINE 미만) */
+    uint8_t etag_len;               /* ETag 길이 (HTTP_ETAG_MAX 미만, 0이면 없음) */
+    char referenced;                /* CLOCK 참조 비트 (원자적으로 갱신) */
+    char refreshing;                /* 백그라운드 갱신이 예약됨 (원자적으로 갱신) */
+    char segment;                   /* LRU/SLRU 구역 */
+
+    /* 둘째 캐시 라인: 재검증, 축출 정책, 타이머 */
+    time_t swr_until;               /* stale-while-revalidate 허용 시각 */
+    time_t last_modified;           /* 재검증용 Last-Modified (-1이면 없음) */
+    struct origin *origin;          /* 호스트별 점유량 (origin.c) */
+    unsigned freq;                  /* GDSF 적중 횟수 */
+    size_t heap_idx;                /* GDSF 힙 위치 */
+    double priority;                /* GDSF 우선순위 */
+    struct cache_entry *prev;       /* 축출 정책의 리스트 (CLOCK 원형, LRU/SLRU 구역) */
+    struct cache_entry *next;
+    tw_node_t timer;                /* 샤드 타이머 휠의 회수 노드 */
+
+    char key[];                     /* 정규화된 URI, 이어서 ETag (각각 NUL로 끝남) */
+} cache_entry_t;
+
+/* 진행 중 요청의 채우기 상태 */
+#define FILL_PENDING   0            /* 헤더 수신 중: 팔로워는 아직 기다림 */
+#define FILL_STREAMING 1            /* 캐시 가능 판정: 팔로워가 따라 읽음 */
+#define FILL_DONE      2            /* 응답 완료 */
+#define FILL_ABORTED   3            /* 크기 초과, 나눌 수 없는 응답, 원 서버 오류 */
+
+/*
+ * 진행 중인 원 서버 요청: 같은 키의 미스가 동시에 여러 개 생기면 처음
+ * 미스한 스레드(리더)만 원 서버에서 가져온다. 리더는 받은 바이트를
+ * 클라이언트에 쓰는 동시에 data에 이어 붙이고, 나머지 스레드(팔로워)는
+ * 채워지는 data를 따라 읽으며 자기 클라이언트에 보낸다.
+ */
+typedef struct inflight {
+    char *key;
+    unsigned long hash;
+    pthread_mutex_t lock;           /* 아래 필드 보호 */
+    pthread_cond_t cond;            /* 바이트 추가나 상태 변화 알림 */
+    struct fill_waiter *waiters;    /* rio_wait 훅으로 기다리는 팔로워 (eventfd) */
+    int state;                      /* FILL_* */
+    int refs;                       /* 리더 1 + 따라 읽는 스레드 수 */
+    int share_only;                 /* 팔로워와 나누기만 하고 저장하지 않음 */
+    int pass;                       /* 응답을 다른 요청과 나눌 수 없음 (cache_fill_pass) */
+    int ended;                      /* 리더가 cache_fetch_end를 부름 */
+    char *data;                     /* 지금까지 받은 응답 바이트 */
+    size_t len, cap;
+    time_t expires;                 /* cache_fill_open에서 받은 신선도와 검증자 */
+    time_t swr_until;
+    time_t last_modified;
+    char *etag;
+    const char *vary;               /* 인턴한 Vary 목록 */
+    unsigned long vhash;
+    struct inflight *next;
+} inflight_t;
+
+void cache_init(int nshards, int hugepages);
+int cache_make_key(char *key, char *hostname, char *port, char *path);
+cache_entry_t *cache_lookup(char *key, http_req_t *req, int *stalep);
+int cache_claim_refresh(cache_entry_t *e);
+void cache_unclaim_refresh(cache_entry_t *e);
+cache_entry_t *cache_lookup_stale(char *key, http_req_t *req);
+cache_entry_t *cache_revalidate(cache_entry_t *e, cache_meta_t *meta, char *head, size_t len);
+int cache_send(cache_entry_t *e, int fd);
+void cache_release(cache_entry_t *e);
+char *cache_etag(cache_entry_t *e);
+void cache_insert(char *key, char *data, size_t size, cache_meta_t *meta);
+inflight_t *cache_fetch_begin(char *key, http_req_t *req, cache_entry_t **hitp,
+                              int *leaderp);
+int cache_fill_append(inflight_t *f, char *buf, size_t n);
+void cache_fill_open(inflight_t *f, cache_meta_t *meta);
+void cache_fill_share(inflight_t *f, cache_meta_t *meta);
+void cache_fill_abort(inflight_t *f);
+void cache_fill_pass(inflight_t *f);
+void cache_fetch_end(inflight_t *f);
+int cache_follow(inflight_t *f, http_req_t *req, int fd);
+void cache_unfollow(inflight_t *f);
+int cache_purge(char *key, int prefix);
+
+#endif /* __CACHE_H__ */
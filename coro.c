@@ -0,0 +1,561 @@
+/*
+ * coro.c - epoll 위에서 도는 스택 코루틴 엔진 (-e coro)
+ *
+ * reactor.c처럼 요청 처리를 콜백 상태 기계로 다시 쓰지 않고, 연결마다
+ * 작은 스택을 가진 코루틴 하나가 handle_transaction을 그대로 돈다.
+ * 소켓은 논블로킹이며, Rio 함수가 EAGAIN을 만나면 csapp의 rio_wait 훅으로
+ * coro_wait을 불러 fd를 epoll에 한 번짜리(EPOLLONESHOT)로 걸고 루프로
+ * 돌아간다. 준비되면 루프가 코루틴을 이어서 돌리고 Rio는 읽기/쓰기를 다시
+ * 한다. 그래서 기존의 직선형 코드는 바뀌지 않은 채 스레드 하나가 많은
+ * 트랜잭션을 동시에 끌고 간다.
+ *
+ * - 스택: mmap한 CORO_STACK 바이트 아래에 PROT_NONE 가드 페이지를 둔다.
+ *   넘치면 조용히 옆 메모리를 덮지 않고 SIGSEGV로 죽는다. MAP_NORESERVE라
+ *   실제로 건드린 페이지만 메모리를 차지하며, 끝난 코루틴의 스택은 루프마다
+ *   CORO_CACHE개까지 남겨 다시 쓴다.
+ * - 문맥 교환: x86-64에서는 호출 규약이 보존하라는 레지스터와 스택
+ *   포인터만 바꾸는 몇 줄짜리 어셈블리로, 시그널 마스크를 건드리는
+ *   swapcontext의 시스템 호출을 피한다. 다른 아키텍처는 ucontext를 쓴다.
+ * - 기다림: 원 서버 connect는 논블로킹으로 걸고 쓰기 가능해질 때까지,
+ *   진행 중 요청의 팔로워는 리더가 알리는 자기 eventfd를, 예열은 작업
+ *   스레드가 끝날 때 알리는 eventfd를 모두 같은 rio_wait 훅으로 기다린다.
+ *   그래서 기다리는 트랜잭션은 루프에 걸린 코루틴일 뿐 스레드를 잡지 않는다.
+ * - 블로킹 작업: 막는 호출만 남은 이름 풀이(getaddrinfo)는 coro_offload로
+ *   도우미 스레드에 맡기고 코루틴은 멈춘다. 도우미는 끝난 코루틴을 루프의
+ *   eventfd로 돌려준다. 도우미 스레드는 맡은 작업이 쉬는 도우미보다 많을 때
+ *   CORO_HELPERS_MAX까지 늘린다.
+ * - 비용: /proxy-stats는 살아 있는 코루틴 스택이 실제로 차지한 메모리를,
+ *   bench -C는 문맥 교환 한 번의 시간을 보여 준다.
+ *
+ * 루프는 여러 개(-r)일 수 있으며, 이벤트 엔진처럼 루프마다 SO_REUSEPORT로
+ * 자기 listen 소켓을 연다. 코루틴은 처음 돈 루프에서 끝까지 돈다.
+ */
+#include "coro.h"
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+/* epoll_event.data.u64: 코루틴이 아닌 것 */
+#define EV_LISTEN 0
+#define EV_WAKE 1
+
+#if defined(__x86_64__)
+typedef struct {
+    void *sp;                       /* 멈춘 곳의 스택 포인터 (레지스터는 스택에) */
+} ctx_t;
+#else
+typedef ucontext_t ctx_t;
+#endif
+
+struct loop;
+
+typedef struct coro {
+    ctx_t ctx;
+    char *stack;                    /* mmap한 영역 (맨 아래 페이지가 가드) */
+    struct loop *loop;
+    int fd;                         /* 처리할 연결 */
+    int done;
+    void (*job)(void *arg);         /* 도우미 스레드에 맡긴 작업 */
+    void *job_arg;
+    struct coro *next;              /* 실행 대기, 도우미 큐, 돌려받은 목록, 스택 캐시 */
+    struct coro *all_prev, *all_next;   /* 루프의 모든 스택 (통계용) */
+} coro_t;
+
+typedef struct loop {
+    int id;
+    int listen_fd;
+    int epfd;
+    int wake_fd;                    /* 도우미가 코루틴을 돌려줄 때 알림 */
+    ctx_t ctx;                      /* 루프 자신의 문맥 */
+    coro_t *current;                /* 지금 도는 코루틴 */
+    coro_t *ready, *ready_tail;     /* 다시 돌릴 코루틴 */
+    coro_t *cache;                  /* 다시 쓸 스택 */
+    int cached;
+    pthread_mutex_t lock;           /* returned, all 보호 */
+    coro_t *returned;               /* 도우미가 돌려준 코루틴 */
+    coro_t *all;                    /* 매핑한 모든 스택 (실행 중과 캐시) */
+    unsigned long spawned;          /* 만든 코루틴 수 (원자적으로 읽음) */
+    unsigned long active;           /* 살아 있는 코루틴 수 */
+    unsigned long switches;         /* 코루틴으로 들어간 횟수 */
+} loop_t;
+
+static void (*serve_conn)(int fd);
+static loop_t *loops;
+static int loop_count;
+static long page_size;
+static __thread loop_t *self;       /* 이 스레드가 돌리는 루프 (없으면 NULL) */
+static ctx_t *ping_ctx, *ping_back; /* coro_switch_ns가 오가는 두 문맥 */
+
+/* 도우미 스레드 큐 */
+static coro_t *help_head, *help_tail;
+static sem_t help_mutex, help_items;
+static int help_queued, help_idle, help_threads;
+
+static void *loop_thread(void *vargp);
+static void run_loop(loop_t *l);
+static void accept_all(loop_t *l);
+static void spawn(loop_t *l, int fd);
+static void resume(loop_t *l, coro_t *co);
+static void make_ready(loop_t *l, coro_t *co);
+static void take_returned(loop_t *l);
+static void coro_entry(void);
+static void *helper(void *vargp);
+static size_t resident(coro_t *co);
+static void ping(void);
+static void ctx_make(ctx_t *ctx, char *stack, size_t size, void (*entry)(void));
+static void ctx_swap(ctx_t *from, ctx_t *to);
+
+/*
+ * coro_start - 루프 count개가 각자 port에 listen 소켓을 열고 연결마다
+ * 코루틴을 띄워 serve(fd)를 돌림. 0번 루프는 호출한 스레드에서 돌며
+ * 돌아오지 않는다. serve는 fd를 닫고 돌아와야 한다.
+ */
+void coro_start(char *port, int count, void (*serve)(int fd)) {
+    struct epoll_event ev;
+    pthread_t tid;
+    loop_t *l;
+    int i;
+
+    serve_conn = serve;
+    page_size = sysconf(_SC_PAGESIZE);
+    Sem_init(&help_mutex, 0, 1);
+    Sem_init(&help_items, 0, 0);
+    loops = Calloc(count, sizeof(loop_t));
+    loop_count = count;
+    for (i = 0; i < count; i++) {
+        l = &loops[i];
+        l->id = i;
+        l->listen_fd = Open_listenfd_opt(port, count > 1);
+        fcntl(l->listen_fd, F_SETFL, fcntl(l->listen_fd, F_GETFL) | O_NONBLOCK);
+        if ((l->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            unix_error("epoll_create1 error");
+        if ((l->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            unix_error("eventfd error");
+        pthread_mutex_init(&l->lock, NULL);
+        ev.events = EPOLLIN;
+        ev.data.u64 = EV_LISTEN;
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->listen_fd, &ev) < 0)
+            unix_error("epoll_ctl error");
+        ev.data.u64 = EV_WAKE;
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->wake_fd, &ev) < 0)
+            unix_error("epoll_ctl error");
+    }
+    for (i = 1; i < count; i++)
+        Pthread_create(&tid, NULL, loop_thread, &loops[i]);
+    run_loop(&loops[0]);
+}
+
+/*
+ * coro_running - 부른 곳이 코루틴 안인지
+ */
+int coro_running(void) {
+    return self != NULL && self->current != NULL;
+}
+
+/*
+ * coro_wait - fd가 읽기(for_write면 쓰기) 가능해질 때까지 기다림
+ * 코루틴 안이면 fd를 epoll에 걸고 루프로 돌아가며, 밖이면 poll로 막힌다.
+ * csapp의 rio_wait 훅으로 쓴다. 실패하면 -1
+ */
+int coro_wait(int fd, int for_write) {
+    struct pollfd pfd = { fd, for_write ? POLLOUT : POLLIN, 0 };
+    struct epoll_event ev;
+    loop_t *l = self;
+    coro_t *co;
+
+    if (!l || !(co = l->current)) {
+        while (poll(&pfd, 1, -1) < 0)
+            if (errno != EINTR)
+                return -1;
+        return 0;
+    }
+    ev.events = (for_write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    ev.data.ptr = co;
+    if (epoll_ctl(l->epfd, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+        (errno != ENOENT || epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev) < 0))
+        return -1;
+    ctx_swap(&co->ctx, &l->ctx);
+    return 0;
+}
+
+/*
+ * coro_offload - fn(arg)를 도우미 스레드에서 돌리고 끝날 때까지 멈춤
+ * 코루틴 밖에서 부르면 그 자리에서 돌린다.
+ */
+void coro_offload(void (*fn)(void *arg), void *arg) {
+    loop_t *l = self;
+    pthread_t tid;
+    coro_t *co;
+
+    if (!l || !(co = l->current)) {
+        fn(arg);
+        return;
+    }
+    co->job = fn;
+    co->job_arg = arg;
+    co->next = NULL;
+    P(&help_mutex);
+    if (help_tail)
+        help_tail->next = co;
+    else
+        help_head = co;
+    help_tail = co;
+    if (++help_queued > help_idle && help_threads < CORO_HELPERS_MAX) {
+        help_threads++;
+        help_idle++;
+        Pthread_create(&tid, NULL, helper, NULL);
+    }
+    V(&help_mutex);
+    V(&help_items);
+    ctx_swap(&co->ctx, &l->ctx);
+}
+
+/*
+ * coro_stats - 루프별 만든/살아 있는 코루틴 수와 문맥 교환 횟수, 살아 있는
+ * 코루틴의 스택이 실제로 차지한 메모리(mincore)를 fd에 씀
+ */
+void coro_stats(int fd) {
+    char line[MAXLINE];
+    size_t stack, live;
+    coro_t *co;
+    loop_t *l;
+    int i, n;
+
+    if (!loops)
+        return;
+    n = snprintf(line, sizeof(line), "\ncoro: 루프 %d개, 도우미 스레드 %d개, 스택 %dKB\n"
+                 "%4s %12s %8s %14s %10s %10s\n", loop_count, help_threads, CORO_STACK / 1024,
+                 "id", "spawned", "active", "switches", "stack_kb", "kb/coro");
+    rio_writen(fd, line, n);
+    for (i = 0; i < loop_count; i++) {
+        l = &loops[i];
+        stack = live = 0;
+        pthread_mutex_lock(&l->lock);
+        for (co = l->all; co; co = co->all_next) {
+            if (__atomic_load_n(&co->done, __ATOMIC_RELAXED))
+                continue;           /* 캐시에서 기다리는 스택 */
+            stack += resident(co);
+            live++;
+        }
+        pthread_mutex_unlock(&l->lock);
+        n = snprintf(line, sizeof(line), "%4d %12lu %8lu %14lu %10zu %10.1f\n", i,
+                     __atomic_load_n(&l->spawned, __ATOMIC_RELAXED),
+                     __atomic_load_n(&l->active, __ATOMIC_RELAXED),
+                     __atomic_load_n(&l->switches, __ATOMIC_RELAXED),
+                     stack / 1024, live ? stack / 1024.0 / live : 0.0);
+        rio_writen(fd, line, n);
+    }
+}
+
+/*
+ * coro_switch_ns - 이 스레드와 빈 코루틴 사이를 rounds번 오가며 잰
+ * 문맥 교환 한 번의 평균 시간(ns). bench -C가 쓴다.
+ */
+double coro_switch_ns(long rounds) {
+    struct timespec t0, t1;
+    ctx_t main_ctx;
+    coro_t co;
+    long i;
+
+    if (!page_size)
+        page_size = sysconf(_SC_PAGESIZE);
+    co.stack = mmap(NULL, CORO_STACK + page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (co.stack == MAP_FAILED)
+        unix_error("mmap error");
+    ctx_make(&co.ctx, co.stack + page_size, CORO_STACK, ping);
+    ping_ctx = &co.ctx;
+    ping_back = &main_ctx;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < rounds; i++)
+        ctx_swap(&main_ctx, &co.ctx);   /* 들어갔다 돌아오면 두 번 */
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    munmap(co.stack, CORO_STACK + page_size);
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (2.0 * rounds);
+}
+
+static void *loop_thread(void *vargp) {
+    Pthread_detach(pthread_self());
+    run_loop(vargp);
+    return NULL;
+}
+
+/*
+ * run_loop - 실행 대기 코루틴을 모두 돌린 뒤 epoll에서 기다리기를 반복
+ */
+static void run_loop(loop_t *l) {
+    struct epoll_event events[CORO_EVENTS];
+    coro_t *co;
+    int i, n;
+
+    self = l;
+    while (1) {
+        while ((co = l->ready) != NULL) {
+            if ((l->ready = co->next) == NULL)
+                l->ready_tail = NULL;
+            resume(l, co);
+        }
+        if ((n = epoll_wait(l->epfd, events, CORO_EVENTS, -1)) < 0) {
+            if (errno == EINTR)
+                continue;
+            unix_error("epoll_wait error");
+        }
+        for (i = 0; i < n; i++) {
+            if (events[i].data.u64 == EV_LISTEN)
+                accept_all(l);
+            else if (events[i].data.u64 == EV_WAKE)
+                take_returned(l);
+            else
+                make_ready(l, events[i].data.ptr);
+        }
+    }
+}
+
+/*
+ * accept_all - 대기 중인 연결을 EAGAIN까지 모두 받아 코루틴을 띄움
+ */
+static void accept_all(loop_t *l) {
+    int fd;
+
+    while (1) {
+        if ((fd = accept(l->listen_fd, NULL, NULL)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                fprintf(stderr, "accept error: %s\n", strerror(errno));
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        spawn(l, fd);
+    }
+}
+
+/*
+ * spawn - fd를 처리할 코루틴을 만들어 실행 대기에 넣음
+ * 캐시에 남은 스택이 있으면 다시 쓰고, 없으면 가드 페이지를 붙여 새로 매핑한다.
+ */
+static void spawn(loop_t *l, int fd) {
+    coro_t *co;
+    char *stack;
+
+    if ((co = l->cache) != NULL) {
+        l->cache = co->next;
+        l->cached--;
+    } else {
+        stack = mmap(NULL, CORO_STACK + page_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED || mprotect(stack, page_size, PROT_NONE) < 0) {
+            fprintf(stderr, "coro: 스택 매핑 실패: %s\n", strerror(errno));
+            if (stack != MAP_FAILED)
+                munmap(stack, CORO_STACK + page_size);
+            close(fd);
+            return;
+        }
+        co = Malloc(sizeof(coro_t));
+        co->stack = stack;
+        co->loop = l;
+        co->all_prev = NULL;
+        pthread_mutex_lock(&l->lock);
+        if ((co->all_next = l->all) != NULL)
+            l->all->all_prev = co;
+        l->all = co;
+        pthread_mutex_unlock(&l->lock);
+    }
+    co->fd = fd;
+    co->done = 0;
+    ctx_make(&co->ctx, co->stack + page_size, CORO_STACK, coro_entry);
+    __atomic_add_fetch(&l->spawned, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&l->active, 1, __ATOMIC_RELAXED);
+    make_ready(l, co);
+}
+
+/*
+ * resume - 코루틴을 다음 멈출 곳까지 돌림. 끝났으면 스택을 캐시로
+ */
+static void resume(loop_t *l, coro_t *co) {
+    l->current = co;
+    __atomic_add_fetch(&l->switches, 1, __ATOMIC_RELAXED);
+    ctx_swap(&l->ctx, &co->ctx);
+    l->current = NULL;
+    if (!co->done)
+        return;
+    __atomic_sub_fetch(&l->active, 1, __ATOMIC_RELAXED);
+    if (l->cached < CORO_CACHE) {
+        co->next = l->cache;
+        l->cache = co;
+        l->cached++;
+        return;
+    }
+    pthread_mutex_lock(&l->lock);
+    if (co->all_prev)
+        co->all_prev->all_next = co->all_next;
+    else
+        l->all = co->all_next;
+    if (co->all_next)
+        co->all_next->all_prev = co->all_prev;
+    pthread_mutex_unlock(&l->lock);
+    munmap(co->stack, CORO_STACK + page_size);
+    Free(co);
+}
+
+static void make_ready(loop_t *l, coro_t *co) {
+    co->next = NULL;
+    if (l->ready_tail)
+        l->ready_tail->next = co;
+    else
+        l->ready = co;
+    l->ready_tail = co;
+}
+
+/*
+ * take_returned - 도우미가 작업을 끝내고 돌려준 코루틴을 실행 대기에 넣음
+ */
+static void take_returned(loop_t *l) {
+    uint64_t count;
+    coro_t *co, *next;
+
+    while (read(l->wake_fd, &count, sizeof(count)) > 0)
+        ;
+    pthread_mutex_lock(&l->lock);
+    co = l->returned;
+    l->returned = NULL;
+    pthread_mutex_unlock(&l->lock);
+    for (; co; co = next) {
+        next = co->next;
+        make_ready(l, co);
+    }
+}
+
+/*
+ * coro_entry - 새 코루틴이 처음 들어오는 곳: 연결을 처리하고 루프로 돌아감
+ */
+static void coro_entry(void) {
+    loop_t *l = self;
+    coro_t *co = l->current;
+
+    serve_conn(co->fd);
+    co->done = 1;
+    ctx_swap(&co->ctx, &l->ctx);    /* 돌아오지 않음 */
+}
+
+/*
+ * resident - 코루틴 스택 중 실제로 메모리에 올라온 바이트 (가드 페이지 제외)
+ */
+static size_t resident(coro_t *co) {
+    unsigned char vec[CORO_STACK / 4096];
+    size_t pages = CORO_STACK / page_size, i, n = 0;
+
+    if (pages > sizeof(vec) || mincore(co->stack + page_size, CORO_STACK, vec) < 0)
+        return 0;
+    for (i = 0; i < pages; i++)
+        n += vec[i] & 1;
+    return n * page_size;
+}
+
+/*
+ * ping - coro_switch_ns의 빈 코루틴: 들어오자마자 돌아가기를 반복
+ */
+static void ping(void) {
+    while (1)
+        ctx_swap(ping_ctx, ping_back);
+}
+
+/*
+ * helper - 도우미 스레드 루틴: 맡은 작업을 돌린 뒤 코루틴을 루프로 돌려줌
+ */
+static void *helper(void *vargp) {
+    uint64_t one = 1;
+    coro_t *co;
+    loop_t *l;
+
+    Pthread_detach(pthread_self());
+    while (1) {
+        P(&help_items);
+        P(&help_mutex);
+        co = help_head;
+        if ((help_head = co->next) == NULL)
+            help_tail = NULL;
+        help_queued--;
+        help_idle--;
+        V(&help_mutex);
+
+        co->job(co->job_arg);
+
+        l = co->loop;
+        pthread_mutex_lock(&l->lock);
+        co->next = l->returned;
+        l->returned = co;
+        pthread_mutex_unlock(&l->lock);
+        if (write(l->wake_fd, &one, sizeof(one)) < 0)
+            fprintf(stderr, "eventfd write error: %s\n", strerror(errno));
+        P(&help_mutex);
+        help_idle++;
+        V(&help_mutex);
+    }
+    return NULL;
+}
+
+#if defined(__x86_64__)
+/*
+ * coro_switch - 보존 레지스터를 스택에 넣고 *from에 스택 포인터를 남긴 뒤
+ * to 스택으로 바꿔 거기 넣어 둔 레지스터를 꺼내 돌아감
+ */
+void coro_switch(void **from, void *to);
+__asm__(".text\n"
+        ".globl coro_switch\n"
+        ".type coro_switch, @function\n"
+        "coro_switch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size coro_switch, .-coro_switch\n");
+
+/*
+ * ctx_make - 처음 바꿔 들어가면 entry가 불린 것처럼 보이게 스택을 꾸밈
+ * coro_switch가 꺼낼 레지스터 6개와 돌아갈 주소(entry), 그리고
+ * entry의 가짜 반환 주소를 쌓는다. 함수 진입 때 rsp는 16의 배수 + 8이다.
+ */
+static void ctx_make(ctx_t *ctx, char *stack, size_t size, void (*entry)(void)) {
+    void **sp = (void **)(((unsigned long)(stack + size)) & ~15UL);
+    int i;
+
+    *--sp = NULL;
+    *--sp = (void *)entry;
+    for (i = 0; i < 6; i++)
+        *--sp = NULL;
+    ctx->sp = sp;
+}
+
+static void ctx_swap(ctx_t *from, ctx_t *to) {
+    coro_switch(&from->sp, to->sp);
+}
+#else
+static void ctx_make(ctx_t *ctx, char *stack, size_t size, void (*entry)(void)) {
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = stack;
+    ctx->uc_stack.ss_size = size;
+    ctx->uc_link = NULL;
+    makecontext(ctx, entry, 0);
+}
+
+static void ctx_swap(ctx_t *from, ctx_t *to) {
+    swapcontext(from, to);
+}
+#endif
@@ -0,0 +1,21 @@
+/*
+ * coro.h - epoll 위에서 도는 스택 코루틴 엔진 인터페이스
+ */
+#ifndef __CORO_H__
+#define __CORO_H__
+
+#include "csapp.h"
+
+#define CORO_STACK (256 * 1024)     /* 코루틴 스택 크기 (가드 페이지 제외) */
+#define CORO_CACHE 1024             /* 루프마다 재사용하려고 남겨 둘 스택 수 */
+#define CORO_EVENTS 256             /* epoll_wait 한 번에 받을 이벤트 수 */
+#define CORO_HELPERS_MAX 256        /* 이름 풀이를 맡는 도우미 스레드 상한 */
+
+void coro_start(char *port, int count, void (*serve)(int fd));
+int coro_running(void);
+int coro_wait(int fd, int for_write);
+void coro_offload(void (*fn)(void *arg), void *arg);
+void coro_stats(int fd);
+double coro_switch_ns(long rounds);
+
+#endif /* __CORO_H__ */
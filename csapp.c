@@ -662,6 +662,14 @@ void V(sem_t *sem) {
  * The Rio package - Robust I/O functions
  ****************************************/
 
+/*
+ * rio_wait - If set, called when a Rio read/write on a non-blocking fd
+ *     fails with EAGAIN; it waits until fd is ready (for writing if
+ *     for_write) and returns 0 to retry, or -1 to fail the call. The
+ *     coroutine engine sets it to park the current coroutine instead.
+ */
+int (*rio_wait)(int fd, int for_write) = NULL;
+
 /*
  * rio_readn - Robustly read n bytes (unbuffered)
  */
@@ -675,6 +683,8 @@ ssize_t rio_readn(int fd, void *usrbuf, size_t n) {
     if ((nread = read(fd, bufp, nleft)) < 0) {
       if (errno == EINTR) /* Interrupted by sig handler return */
         nread = 0;        /* and call read() again */
+      else if (errno == EAGAIN && rio_wait && rio_wait(fd, 0) == 0)
+        nread = 0;
       else
         return -1; /* errno set by read() */
     } else if (nread == 0)
@@ -699,6 +709,8 @@ ssize_t rio_writen(int fd, void *usrbuf, size_t n) {
     if ((nwritten = write(fd, bufp, nleft)) <= 0) {
       if (errno == EINTR) /* Interrupted by sig handler return */
         nwritten = 0;     /* and call write() again */
+      else if (errno == EAGAIN && rio_wait && rio_wait(fd, 1) == 0)
+        nwritten = 0;
       else
         return -1; /* errno set by write() */
     }
@@ -724,6 +736,8 @@ static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n) {
   while (rp->rio_cnt <= 0) { /* Refill if buf is empty */
     rp->rio_cnt = read(rp->rio_fd, rp->rio_buf, sizeof(rp->rio_buf));
     if (rp->rio_cnt < 0) {
+      if (errno == EAGAIN && rio_wait && rio_wait(rp->rio_fd, 0) == 0)
+        continue;
       if (errno != EINTR) /* Interrupted by sig handler return */
         return -1;
     } else if (rp->rio_cnt == 0) /* EOF */
@@ -899,7 +913,15 @@ int open_clientfd(char *hostname, char *port) {
  *       -1 with errno set for other errors.
  */
 /* $begin open_listenfd */
-int open_listenfd(char *port) {
+int open_listenfd(char *port) { return open_listenfd_opt(port, 0); }
+/* $end open_listenfd */
+
+/*
+ * open_listenfd_opt - open_listenfd that can also set SO_REUSEPORT, so
+ *     several sockets (one per event loop) can listen on the same port
+ *     and the kernel spreads incoming connections across them.
+ */
+int open_listenfd_opt(char *port, int reuseport) {
   struct addrinfo hints, *listp, *p;
   int listenfd, rc, optval = 1;
 
@@ -923,6 +945,12 @@ int open_listenfd(char *port) {
     /* Eliminates "Address already in use" error from bind */
     setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, // line:netp:csapp:setsockopt
                (const void *)&optval, sizeof(int));
+    if (reuseport &&
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, (const void *)&optval,
+                   sizeof(int)) < 0) {
+      close(listenfd);
+      continue;
+    }
 
     /* Bind the descriptor to the address */
     if (bind(listenfd, p->ai_addr, p->ai_addrlen) == 0)
@@ -945,7 +973,6 @@ int open_listenfd(char *port) {
   }
   return listenfd;
 }
-/* $end open_listenfd */
 
 /****************************************************
  * Wrappers for reentrant protocol-independent helpers
@@ -966,4 +993,12 @@ int Open_listenfd(char *port) {
   return rc;
 }
 
+int Open_listenfd_opt(char *port, int reuseport) {
+  int rc;
+
+  if ((rc = open_listenfd_opt(port, reuseport)) < 0)
+    unix_error("Open_listenfd_opt error");
+  return rc;
+}
+
 /* $end csapp.c */
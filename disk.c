@@ -0,0 +1,439 @@
+/*
+ * disk.c - 프록시 캐시의 디스크 2차 계층
+ *
+ * 원 서버에서 받아 메모리 캐시에 들어간 객체는 이 계층에도 기록하고,
+ * 메모리에서 축출될 때 디스크 사본이 이미 밀려났으면 다시 내린다(demote).
+ * 메모리에서 미스가 나면 여기서 찾아 다시 메모리로 올린다(promote).
+ *
+ * 저장소는 예산 크기의 파일 하나를 mmap한 로그 구조 슬랩이다.
+ * 레코드는 쓰기 위치(head)에 차례로 붙이고, 파일 끝에 닿으면 처음으로
+ * 돌아가 가장 오래된 레코드부터 덮어쓴다. 따라서 디스크 계층의 축출은
+ * 쓰기 순서(FIFO)이며 예산을 넘지 않는다.
+ *
+ * 레코드 = 머리(disk_rec_t) + 키 + ETag + 응답 바이트 (DISK_ALIGN 정렬)
+ * 머리의 checksum은 레코드 전체를 덮으며 magic은 마지막에 쓴다.
+ * 시작할 때 파일을 한 번 훑어 온전한 레코드만으로 메모리 색인을
+ * 재구성하므로, 프로세스를 다시 띄워도 캐시가 따뜻한 채로 돌아온다.
+ *
+ * 색인과 파일 쓰기, 접두사 검색용 기수 트리(radix.c)는 disk_lock 하나로
+ * 보호한다. 호출자는 캐시 샤드 락을 잡지 않은 상태에서 부른다.
+ */
+#include "disk.h"
+#include "radix.h"
+#include <stdint.h>
+
+#define DISK_MAGIC 0x50584443u      /* "PXDC" */
+#define DISK_REC_MAGIC 0x52454331u  /* "REC1" */
+
+/* 파일 머리 */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                  /* 파일 크기 */
+} disk_hdr_t;
+
+/* 레코드 머리 */
+typedef struct {
+    uint32_t magic;
+    uint32_t key_len;
+    uint32_t etag_len;
+    uint32_t data_len;
+    uint64_t seq;                   /* 쓴 순서 */
+    uint64_t checksum;              /* magic, checksum을 0으로 둔 레코드의 FNV-1a */
+    int64_t expires;
+    int64_t swr_until;
+    int64_t last_modified;
+} disk_rec_t;
+
+/* 메모리 색인 항목: 파일의 레코드 하나 */
+typedef struct disk_index {
+    unsigned long hash;
+    size_t off;                     /* 레코드 시작 위치 */
+    size_t len;                     /* 정렬된 레코드 길이 */
+    int live;                       /* 색인에 걸려 있는지 (같은 키의 새 레코드가 오면 0) */
+    struct disk_index *hnext;       /* 해시 체인 */
+    struct disk_index *fnext;       /* 쓴 순서 */
+} disk_index_t;
+
+static char *base;                  /* mmap된 파일 */
+static size_t file_size;
+static size_t head;                 /* 다음 쓰기 위치 */
+static uint64_t next_seq;
+static disk_index_t *buckets[DISK_BUCKETS];
+static disk_index_t *fifo_head, *fifo_tail; /* 가장 오래된 / 가장 새 레코드 */
+static radix_t keys;                /* 살아 있는 레코드의 키 */
+static pthread_mutex_t disk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long fnv(unsigned long h, void *p, size_t n);
+static unsigned long rec_checksum(disk_rec_t *r);
+static size_t rec_len(disk_rec_t *r);
+static disk_index_t *find(char *key, unsigned long hash);
+static void unlink_hash(disk_index_t *ix);
+static void add_record(size_t off, size_t len);
+static void pop_oldest(void);
+static void rebuild(void);
+static int cmp_seq(const void *a, const void *b);
+
+/*
+ * disk_init - 디스크 계층 파일을 열어 mmap하고 색인을 재구성
+ * 파일이 없거나 크기가 예산과 다르면 새로 만든다. 실패하면 -1.
+ */
+int disk_init(char *path, size_t budget) {
+    int fd, fresh = 0;
+    struct stat st;
+    disk_hdr_t *hdr;
+
+    budget &= ~(size_t)(DISK_ALIGN - 1);
+    if (budget < DISK_HEADER_SIZE + MAX_OBJECT_SIZE + sizeof(disk_rec_t)) {
+        fprintf(stderr, "disk: 예산이 너무 작습니다 (%zu바이트)\n", budget);
+        return -1;
+    }
+    if ((fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+        fprintf(stderr, "disk: %s 열기 실패: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size != budget) {
+        if (ftruncate(fd, 0) < 0 || ftruncate(fd, budget) < 0) {
+            fprintf(stderr, "disk: %s 크기 조정 실패: %s\n", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        fresh = 1;
+    }
+    base = mmap(NULL, budget, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "disk: mmap 실패: %s\n", strerror(errno));
+        base = NULL;
+        return -1;
+    }
+    file_size = budget;
+
+    hdr = (disk_hdr_t *)base;
+    if (fresh || hdr->magic != DISK_MAGIC || hdr->size != budget) {
+        memset(base, 0, DISK_HEADER_SIZE);
+        hdr->magic = DISK_MAGIC;
+        hdr->version = 1;
+        hdr->size = budget;
+    }
+
+    rebuild();
+    return 0;
+}
+
+int disk_enabled(void) {
+    return base != NULL;
+}
+
+/*
+ * disk_put - 객체를 로그 끝에 기록 (메모리에서 축출될 때 호출)
+ * 공간이 모자라면 가장 오래된 레코드부터 덮어쓴다.
+ */
+void disk_put(char *key, char *data, size_t size, cache_meta_t *meta) {
+    disk_rec_t rec, *r;
+    size_t len;
+    char *p;
+
+    if (!base)
+        return;
+
+    rec.magic = 0;
+    rec.key_len = strlen(key);
+    rec.etag_len = meta->etag ? strlen(meta->etag) : 0;
+    rec.data_len = size;
+    rec.expires = meta->expires;
+    rec.swr_until = meta->swr_until;
+    rec.last_modified = meta->last_modified;
+    rec.checksum = 0;
+    len = rec_len(&rec);
+    if (len > file_size - DISK_HEADER_SIZE)
+        return;
+
+    pthread_mutex_lock(&disk_lock);
+
+    /* 파일 끝에 닿으면 처음으로: 뒤쪽에 남은 레코드는 모두 가장 오래된 것 */
+    if (head + len > file_size) {
+        while (fifo_head && fifo_head->off >= head)
+            pop_oldest();
+        head = DISK_HEADER_SIZE;
+    }
+    /* 덮어쓸 구간의 레코드 축출 */
+    while (fifo_head && fifo_head->off >= head && fifo_head->off < head + len)
+        pop_oldest();
+
+    /* 본문을 먼저 쓰고 checksum과 magic은 마지막에 */
+    r = (disk_rec_t *)(base + head);
+    rec.seq = next_seq++;
+    memcpy(r, &rec, sizeof(rec));
+    p = (char *)(r + 1);
+    memcpy(p, key, rec.key_len);
+    memcpy(p + rec.key_len, meta->etag, rec.etag_len);
+    memcpy(p + rec.key_len + rec.etag_len, data, size);
+    r->checksum = rec_checksum(r);
+    __atomic_store_n(&r->magic, DISK_REC_MAGIC, __ATOMIC_RELEASE);
+
+    add_record(head, len);
+    head += len;
+
+    pthread_mutex_unlock(&disk_lock);
+}
+
+/*
+ * disk_get - 키의 객체를 찾아 응답 바이트 복사본과 메타데이터를 반환
+ * 반환된 버퍼와 meta->etag(있으면)는 Malloc된 것으로 호출자가 Free한다.
+ * 없으면 NULL.
+ */
+char *disk_get(char *key, size_t *sizep, cache_meta_t *meta) {
+    unsigned long hash = fnv(14695981039346656037UL, key, strlen(key));
+    disk_index_t *ix;
+    disk_rec_t *r;
+    char *p, *data = NULL;
+
+    if (!base)
+        return NULL;
+
+    pthread_mutex_lock(&disk_lock);
+    if ((ix = find(key, hash)) != NULL) {
+        r = (disk_rec_t *)(base + ix->off);
+        p = (char *)(r + 1);
+        data = Malloc(r->data_len);
+        memcpy(data, p + r->key_len + r->etag_len, r->data_len);
+        *sizep = r->data_len;
+        meta->expires = r->expires;
+        meta->swr_until = r->swr_until;
+        meta->last_modified = r->last_modified;
+        meta->etag = NULL;
+        meta->vary = NULL;
+        meta->vhash = 0;
+        if (r->etag_len) {
+            meta->etag = Malloc(r->etag_len + 1);
+            memcpy(meta->etag, p + r->key_len, r->etag_len);
+            meta->etag[r->etag_len] = '\0';
+        }
+    }
+    pthread_mutex_unlock(&disk_lock);
+
+    return data;
+}
+
+/*
+ * disk_contains - 키의 레코드가 디스크 계층에 있는지 확인
+ */
+int disk_contains(char *key) {
+    unsigned long hash = fnv(14695981039346656037UL, key, strlen(key));
+    int found;
+
+    if (!base)
+        return 0;
+    pthread_mutex_lock(&disk_lock);
+    found = find(key, hash) != NULL;
+    pthread_mutex_unlock(&disk_lock);
+    return found;
+}
+
+/*
+ * disk_remove - 키를 색인에서 빼고 레코드를 무효화하여 재시작 후에도
+ * 되살아나지 않게 함 (공간은 덮어쓸 차례가 올 때 재사용된다)
+ */
+void disk_remove(char *key) {
+    unsigned long hash = fnv(14695981039346656037UL, key, strlen(key));
+    disk_index_t *ix;
+
+    if (!base)
+        return;
+    pthread_mutex_lock(&disk_lock);
+    if ((ix = find(key, hash)) != NULL) {
+        unlink_hash(ix);
+        ((disk_rec_t *)(base + ix->off))->magic = 0;
+    }
+    pthread_mutex_unlock(&disk_lock);
+}
+
+/*
+ * disk_purge - 키가 key인 레코드(prefix면 key로 시작하는 모든 레코드)를
+ * 색인에서 빼고 무효화. 지운 레코드 수를 반환한다.
+ */
+int disk_purge(char *key, int prefix) {
+    char **list;
+    disk_index_t *ix;
+    int i, n, purged = 0;
+
+    if (!base)
+        return 0;
+    pthread_mutex_lock(&disk_lock);
+    n = prefix ? radix_collect(&keys, key, &list) : 1;
+    for (i = 0; i < n; i++) {
+        char *k = prefix ? list[i] : key;
+        if ((ix = find(k, fnv(14695981039346656037UL, k, strlen(k)))) != NULL) {
+            unlink_hash(ix);
+            ((disk_rec_t *)(base + ix->off))->magic = 0;
+            purged++;
+        }
+    }
+    if (prefix)
+        radix_free_keys(list, n);
+    pthread_mutex_unlock(&disk_lock);
+    return purged;
+}
+
+static unsigned long fnv(unsigned long h, void *p, size_t n) {
+    unsigned char *c = p;
+
+    while (n--) {
+        h ^= *c++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+/*
+ * rec_checksum - magic과 checksum 필드를 0으로 보고 레코드 전체의 해시
+ */
+static unsigned long rec_checksum(disk_rec_t *r) {
+    disk_rec_t copy = *r;
+
+    copy.magic = 0;
+    copy.checksum = 0;
+    return fnv(fnv(14695981039346656037UL, &copy, sizeof(copy)), r + 1,
+               (size_t)r->key_len + r->etag_len + r->data_len);
+}
+
+static size_t rec_len(disk_rec_t *r) {
+    size_t len = sizeof(disk_rec_t) + (size_t)r->key_len + r->etag_len + r->data_len;
+
+    return (len + DISK_ALIGN - 1) & ~(size_t)(DISK_ALIGN - 1);
+}
+
+/*
+ * find - 살아 있는 레코드 중 키가 같은 것을 찾음 (disk_lock 보유)
+ */
+static disk_index_t *find(char *key, unsigned long hash) {
+    disk_index_t *ix;
+    disk_rec_t *r;
+    size_t klen = strlen(key);
+
+    for (ix = buckets[hash & (DISK_BUCKETS - 1)]; ix; ix = ix->hnext) {
+        r = (disk_rec_t *)(base + ix->off);
+        if (ix->hash == hash && r->key_len == klen && memcmp(r + 1, key, klen) == 0)
+            return ix;
+    }
+    return NULL;
+}
+
+static void unlink_hash(disk_index_t *ix) {
+    disk_rec_t *r = (disk_rec_t *)(base + ix->off);
+    disk_index_t **pp;
+
+    for (pp = &buckets[ix->hash & (DISK_BUCKETS - 1)]; *pp; pp = &(*pp)->hnext) {
+        if (*pp == ix) {
+            *pp = ix->hnext;
+            break;
+        }
+    }
+    ix->live = 0;
+    radix_remove(&keys, (char *)(r + 1), r->key_len);
+}
+
+/*
+ * add_record - off에 있는 레코드를 색인과 쓴 순서 목록의 끝에 추가
+ */
+static void add_record(size_t off, size_t len) {
+    disk_rec_t *r = (disk_rec_t *)(base + off);
+    disk_index_t *ix = Malloc(sizeof(disk_index_t));
+    disk_index_t *old;
+
+    ix->hash = fnv(14695981039346656037UL, r + 1, r->key_len);
+    ix->off = off;
+    ix->len = len;
+    ix->live = 1;
+    ix->fnext = NULL;
+
+    /* 같은 키의 예전 레코드는 색인에서만 뺀다 */
+    for (old = buckets[ix->hash & (DISK_BUCKETS - 1)]; old; old = old->hnext) {
+        disk_rec_t *o = (disk_rec_t *)(base + old->off);
+        if (old->hash == ix->hash && o->key_len == r->key_len &&
+            memcmp(o + 1, r + 1, r->key_len) == 0) {
+            unlink_hash(old);
+            break;
+        }
+    }
+    ix->hnext = buckets[ix->hash & (DISK_BUCKETS - 1)];
+    buckets[ix->hash & (DISK_BUCKETS - 1)] = ix;
+    radix_insert(&keys, (char *)(r + 1), r->key_len);
+
+    if (fifo_tail)
+        fifo_tail->fnext = ix;
+    else
+        fifo_head = ix;
+    fifo_tail = ix;
+}
+
+/*
+ * pop_oldest - 가장 오래된 레코드를 색인에서 지우고 magic을 무효화
+ */
+static void pop_oldest(void) {
+    disk_index_t *ix = fifo_head;
+
+    fifo_head = ix->fnext;
+    if (!fifo_head)
+        fifo_tail = NULL;
+    if (ix->live)
+        unlink_hash(ix);
+    ((disk_rec_t *)(base + ix->off))->magic = 0;
+    Free(ix);
+}
+
+/* 재구성 중 찾은 레코드 */
+typedef struct {
+    size_t off, len;
+    uint64_t seq;
+} found_t;
+
+/*
+ * rebuild - 파일을 훑어 온전한 레코드로 색인을 다시 만듦
+ * 레코드 경계를 잃은 구간은 DISK_ALIGN 단위로 건너뛰며 magic을 찾는다.
+ * 찾은 레코드를 쓴 순서(seq)로 정렬해 넣으면 같은 키는 새 것이 이긴다.
+ */
+static void rebuild(void) {
+    found_t *found = NULL;
+    size_t nfound = 0, cap = 0, off = DISK_HEADER_SIZE, len, i;
+    disk_rec_t *r;
+
+    while (off + sizeof(disk_rec_t) <= file_size) {
+        r = (disk_rec_t *)(base + off);
+        len = rec_len(r);
+        if (r->magic == DISK_REC_MAGIC && r->key_len < MAXLINE &&
+            r->data_len <= MAX_OBJECT_SIZE && r->etag_len < MAXLINE &&
+            off + len <= file_size && r->checksum == rec_checksum(r)) {
+            if (nfound == cap) {
+                cap = cap ? cap * 2 : 256;
+                found = Realloc(found, cap * sizeof(found_t));
+            }
+            found[nfound].off = off;
+            found[nfound].len = len;
+            found[nfound].seq = r->seq;
+            nfound++;
+            off += len;
+        } else {
+            off += DISK_ALIGN;
+        }
+    }
+
+    qsort(found, nfound, sizeof(found_t), cmp_seq);
+    head = DISK_HEADER_SIZE;
+    next_seq = 1;
+    for (i = 0; i < nfound; i++) {
+        add_record(found[i].off, found[i].len);
+        head = found[i].off + found[i].len;
+        next_seq = found[i].seq + 1;
+    }
+    if (found)
+        Free(found);
+    printf("디스크 캐시: 레코드 %zu개 복구\n", nfound);
+}
+
+static int cmp_seq(const void *a, const void *b) {
+    uint64_t x = ((found_t *)a)->seq, y = ((found_t *)b)->seq;
+
+    return x < y ? -1 : x > y;
+}
@@ -0,0 +1,23 @@
+/*
+ * disk.h - 프록시 캐시의 디스크 2차 계층 인터페이스
+ */
+#ifndef __DISK_H__
+#define __DISK_H__
+
+#include "csapp.h"
+#include "cache.h"
+
+#define DISK_DEFAULT_SIZE (64 << 20) /* 기본 디스크 계층 예산 (64MB) */
+#define DISK_HEADER_SIZE 4096       /* 파일 머리 영역 */
+#define DISK_ALIGN 64               /* 레코드 정렬 단위 */
+#define DISK_BUCKETS 4096           /* 색인 해시 버킷 수 (2의 거듭제곱) */
+
+int disk_init(char *path, size_t budget);
+int disk_enabled(void);
+void disk_put(char *key, char *data, size_t size, cache_meta_t *meta);
+char *disk_get(char *key, size_t *sizep, cache_meta_t *meta);
+int disk_contains(char *key);
+void disk_remove(char *key);
+int disk_purge(char *key, int prefix);
+
+#endif /* __DISK_H__ */
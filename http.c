@@ -0,0 +1,506 @@
+/*
+ * http.c - 캐시에 필요한 HTTP 요청/응답 헤더 해석
+ *
+ * forward_response가 받은 상태줄과 헤더를 한 줄씩 넘기면 신선도 계산에
+ * 필요한 값(Cache-Control, Expires, Date, Age 등)과 재검증에 쓸
+ * 검증자(ETag, Last-Modified), 변형을 가르는 Vary만 뽑아 둔다.
+ * 만료 시각 계산은 RFC 7234의 공유 캐시 규칙을 따른다.
+ *
+ * 클라이언트 요청 헤더는 줄 그대로 모아 두었다가, 응답의 Vary가 이름을
+ * 댄 헤더 값만으로 보조 해시를 만든다. 값은 앞뒤와 쉼표 주변 공백을
+ * 무시하므로 "gzip, br"과 "gzip,br"은 같은 변형이 된다.
+ *
+ * 이벤트 엔진(reactor.c)은 줄 단위 블로킹 읽기 대신 받은 만큼 버퍼에
+ * 모으며 http_req_scan으로 헤더 끝을 찾고, http_req_parse로 한 번에 나눈다.
+ *
+ * 304로 재검증한 객체는 http_merge_head로 304의 헤더를 저장된 헤더에
+ * 덮어써 새 Date, Cache-Control, ETag가 캐시된 사본에도 실리게 한다.
+ */
+#define _XOPEN_SOURCE 700           /* strptime */
+#define _DEFAULT_SOURCE             /* timegm */
+#include "http.h"
+#include "csapp.h"
+
+/* 304로 재검증할 때 저장된 값을 그대로 두는 응답 헤더 */
+static const char *pinned_hdrs[] = {
+    "Content-Length", "Content-Encoding", "Content-Range", "Transfer-Encoding",
+    "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Upgrade",
+};
+
+static char *skip_ws(char *p);
+static int header_is(char *line, char *name, char **valuep);
+static char *next_line(char *p, char *end);
+static size_t field_name(char *p, char *end);
+static int updatable(char *p, char *end);
+static int replaced(char *p, char *end, char *upd, char *uend);
+static void parse_cache_control(http_resp_t *r, char *v);
+static void parse_vary(http_resp_t *r, char *v);
+static unsigned long hash_value(unsigned long h, char *p, char *end);
+static unsigned long fnv(unsigned long h, int c);
+
+void http_resp_init(http_resp_t *r) {
+    r->status = 0;
+    r->content_length = -1;
+    r->max_age = r->s_maxage = r->swr = r->age = -1;
+    r->date = r->expires = r->last_modified = -1;
+    r->no_store = r->private_ = r->no_cache = 0;
+    r->etag[0] = '\0';
+    r->vary[0] = '\0';
+    r->vary_any = 0;
+}
+
+/*
+ * http_resp_parse_line - 상태줄 또는 헤더 한 줄을 해석
+ * 첫 호출은 상태줄이어야 한다.
+ */
+void http_resp_parse_line(http_resp_t *r, char *line) {
+    char *v;
+
+    if (r->status == 0) {
+        if (strncmp(line, "HTTP/1.", 7) == 0)
+            r->status = atoi(line + 9);
+        else
+            r->status = -1;
+        return;
+    }
+
+    if (header_is(line, "Content-Length", &v))
+        r->content_length = atol(v);
+    else if (header_is(line, "Cache-Control", &v))
+        parse_cache_control(r, v);
+    else if (header_is(line, "Expires", &v)) {
+        if ((r->expires = http_parse_date(v)) < 0)
+            r->expires = 0;         /* 잘못된 날짜는 이미 만료된 것으로 본다 */
+    }
+    else if (header_is(line, "Date", &v))
+        r->date = http_parse_date(v);
+    else if (header_is(line, "Age", &v))
+        r->age = atol(v);
+    else if (header_is(line, "Last-Modified", &v))
+        r->last_modified = http_parse_date(v);
+    else if (header_is(line, "ETag", &v)) {
+        /* 줄 끝의 CRLF를 떼고 길이 제한 안에서만 보관 */
+        size_t len = strcspn(v, "\r\n");
+        if (len < HTTP_ETAG_MAX) {
+            memcpy(r->etag, v, len);
+            r->etag[len] = '\0';
+        }
+    }
+    else if (header_is(line, "Vary", &v))
+        parse_vary(r, v);
+    else if (header_is(line, "Pragma", &v) && strncasecmp(v, "no-cache", 8) == 0)
+        r->no_cache = 1;
+}
+
+/*
+ * http_resp_parse_head - 상태줄부터 빈 줄까지 모인 헤더 [buf, buf + len)을
+ * 줄마다 http_resp_parse_line으로 해석
+ */
+void http_resp_parse_head(http_resp_t *r, char *buf, size_t len) {
+    char line[MAXLINE], *p, *next, *end = buf + len;
+    size_t n;
+
+    for (p = buf; p < end; p = next) {
+        if ((next = memchr(p, '\n', end - p)) == NULL)
+            break;
+        next++;
+        n = next - p < sizeof(line) ? next - p : sizeof(line) - 1;
+        memcpy(line, p, n);
+        line[n] = '\0';
+        http_resp_parse_line(r, line);
+    }
+}
+
+/*
+ * http_merge_head - 저장된 응답 헤더 [head, head + len)에 304 응답 헤더
+ * [upd, upd + upd_len)의 필드를 덮어써 dst에 만들고 그 길이를 반환
+ * 둘 다 상태줄로 시작해 빈 줄로 끝난다. 저장된 상태줄은 그대로 두고,
+ * 304에 같은 이름이 있는 저장된 줄은 모두 빼고 304의 줄을 빈 줄 앞에
+ * 붙인다. 본문에 묶인 필드와 홉 단위 필드(pinned_hdrs)는 304의 값으로
+ * 바꾸지 않는다(RFC 9111 3.2). dst는 len + upd_len바이트면 충분하다.
+ */
+size_t http_merge_head(char *dst, char *head, size_t len, char *upd, size_t upd_len) {
+    char *p, *next, *end = head + len, *uend = upd + upd_len, *d = dst;
+
+    for (p = head; p < end; p = next) {
+        next = next_line(p, end);
+        if (p != head && (*p == '\r' || *p == '\n'))
+            break;                  /* 빈 줄 */
+        if (p == head || !replaced(p, next, upd, uend)) {
+            memcpy(d, p, next - p);
+            d += next - p;
+        }
+    }
+    for (p = next_line(upd, uend); p < uend; p = next) {
+        next = next_line(p, uend);
+        if (updatable(p, next)) {
+            memcpy(d, p, next - p);
+            d += next - p;
+        }
+    }
+    memcpy(d, "\r\n", 2);
+    return d + 2 - dst;
+}
+
+/*
+ * http_resp_cacheable - 공유 캐시에 저장해도 되는 응답인지 판정
+ */
+int http_resp_cacheable(http_resp_t *r) {
+    return r->status == 200 && !r->no_store && !r->private_ && !r->vary_any;
+}
+
+/*
+ * http_resp_shareable - 저장은 못 해도 같은 때 같은 키를 요청한 다른
+ * 클라이언트에게 그대로 보내도 되는 응답인지 판정
+ */
+int http_resp_shareable(http_resp_t *r) {
+    return !r->no_store && !r->private_ && !r->vary_any;
+}
+
+/*
+ * http_resp_expiry - 응답이 신선함을 잃는 절대 시각
+ * 유효 시간은 s-maxage, max-age, Expires - Date 순으로 정하고, 아무것도
+ * 없으면 Last-Modified로부터의 경과 시간의 10%(CACHE_HEURISTIC_MAX 이하),
+ * 그것도 없으면 CACHE_DEFAULT_TTL을 쓴다. 여기서 원 서버가 밝힌
+ * 응답의 나이(Age, Date)를 빼고 now에 더한다.
+ * no-cache 응답은 매번 재검증해야 하므로 now를 반환한다.
+ */
+time_t http_resp_expiry(http_resp_t *r, time_t now) {
+    time_t date = r->date > 0 ? r->date : now;
+    long lifetime, age;
+
+    if (r->no_cache)
+        return now;
+
+    if (r->s_maxage >= 0)
+        lifetime = r->s_maxage;
+    else if (r->max_age >= 0)
+        lifetime = r->max_age;
+    else if (r->expires >= 0)
+        lifetime = r->expires > date ? r->expires - date : 0;
+    else if (r->last_modified > 0 && r->last_modified < date) {
+        lifetime = (date - r->last_modified) / 10;
+        if (lifetime > CACHE_HEURISTIC_MAX)
+            lifetime = CACHE_HEURISTIC_MAX;
+    } else
+        lifetime = CACHE_DEFAULT_TTL;
+
+    /* 나이: 원 서버 시계로 본 경과 시간과 Age 헤더 중 큰 값 */
+    age = now > date ? now - date : 0;
+    if (r->age > age)
+        age = r->age;
+
+    return lifetime > age ? now + (lifetime - age) : now;
+}
+
+/*
+ * http_parse_date - HTTP 날짜(IMF-fixdate, 예: "Sun, 06 Nov 1994 08:49:37 GMT")
+ * 해석할 수 없으면 -1을 반환한다.
+ */
+time_t http_parse_date(char *s) {
+    struct tm tm;
+
+    memset(&tm, 0, sizeof(tm));
+    s = skip_ws(s);
+    if (strptime(s, "%a, %d %b %Y %H:%M:%S GMT", &tm) == NULL &&
+        strptime(s, "%A, %d-%b-%y %H:%M:%S GMT", &tm) == NULL &&
+        strptime(s, "%a %b %d %H:%M:%S %Y", &tm) == NULL)
+        return -1;
+    return timegm(&tm);
+}
+
+/*
+ * http_format_date - 조건부 요청 헤더에 쓸 IMF-fixdate 문자열 생성
+ */
+void http_format_date(char *buf, size_t len, time_t t) {
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    strftime(buf, len, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+void http_req_init(http_req_t *q) {
+    q->headers[0] = '\0';
+    q->len = 0;
+}
+
+/*
+ * http_req_add_line - 요청 헤더 한 줄을 보관. 넘치면 -1
+ */
+int http_req_add_line(http_req_t *q, char *line) {
+    size_t n = strlen(line);
+
+    if (q->len + n >= HTTP_REQ_MAX)
+        return -1;
+    memcpy(q->headers + q->len, line, n + 1);
+    q->len += n;
+    return 0;
+}
+
+/*
+ * http_req_scan - 이어 받는 요청 바이트에서 헤더의 끝(빈 줄 다음)을 찾음
+ * *scanned는 지난 호출까지 훑은 위치로, 같은 버퍼에 이어 받으며 다시
+ * 부르면 새로 받은 부분만 본다. 찾으면 헤더 길이, 아직 없으면 0
+ */
+size_t http_req_scan(char *buf, size_t len, size_t *scanned) {
+    size_t i = *scanned > 3 ? *scanned - 3 : 0;
+
+    for (; i + 4 <= len; i++)
+        if (buf[i] == '\r' && memcmp(buf + i, "\r\n\r\n", 4) == 0)
+            return i + 4;
+    *scanned = len;
+    return 0;
+}
+
+/*
+ * http_req_parse - http_req_scan이 찾은 헤더 [buf, buf + len)을 해석
+ * 요청 줄을 method, uri, version(각각 size바이트)에 나누고 헤더 줄을 q에
+ * 모은다. 요청 줄이 size보다 길면 -1, 헤더를 다 보관하지 못하면 0, 그
+ * 밖에는 1을 반환한다. 블로킹 읽기 없이 handle_transaction과 같은 결과를 낸다.
+ */
+int http_req_parse(char *buf, size_t len, char *method, char *uri, char *version,
+                   size_t size, http_req_t *q) {
+    char line[HTTP_REQ_MAX];
+    char *p = buf, *end = buf + len, *next;
+    size_t n;
+    int ok = 1;
+
+    next = (char *)memchr(p, '\n', end - p) + 1;
+    if ((n = next - p) >= size)
+        return -1;
+    memcpy(line, p, n);
+    line[n] = '\0';
+    method[0] = uri[0] = version[0] = '\0';
+    sscanf(line, "%s %s %s", method, uri, version);
+
+    http_req_init(q);
+    for (p = next; p < end; p = next) {
+        next = (char *)memchr(p, '\n', end - p) + 1;
+        if ((n = next - p) == 2 && p[0] == '\r')
+            break;
+        if (n >= sizeof(line)) {
+            ok = 0;
+            continue;
+        }
+        memcpy(line, p, n);
+        line[n] = '\0';
+        if (http_req_add_line(q, line) < 0)
+            ok = 0;
+    }
+    return ok;
+}
+
+/*
+ * http_req_get - 요청 헤더 name의 값(앞뒤 공백 제외)을 buf에 복사
+ * 없거나 buf보다 길면 -1, 있으면 값의 길이를 반환한다.
+ */
+int http_req_get(http_req_t *q, char *name, char *buf, size_t size) {
+    size_t len = strlen(name), n;
+    char *line, *next, *v, *end;
+
+    for (line = q->headers; line < q->headers + q->len; line = next) {
+        next = line + strcspn(line, "\n");
+        next += (*next == '\n');
+        if (strncasecmp(line, name, len) != 0 || line[len] != ':')
+            continue;
+        for (v = line + len + 1; v < next && isspace((unsigned char)*v); v++)
+            ;
+        for (end = next; end > v && isspace((unsigned char)end[-1]); end--)
+            ;
+        if ((n = end - v) >= size)
+            return -1;
+        memcpy(buf, v, n);
+        buf[n] = '\0';
+        return n;
+    }
+    return -1;
+}
+
+/*
+ * http_vary_hash - vary 목록이 이름을 댄 요청 헤더 값들의 보조 해시
+ * 없는 헤더와 빈 값은 서로 다르게, 같은 이름의 여러 줄은 쉼표로 이은
+ * 값으로 본다. q가 NULL이면 헤더가 하나도 없는 요청으로 본다.
+ */
+unsigned long http_vary_hash(http_req_t *q, const char *vary) {
+    unsigned long h = 14695981039346656037UL;
+    const char *name = vary, *v;
+    char *line, *next, *end;
+    size_t len;
+    int found;
+
+    while (*name) {
+        len = strcspn(name, ",");
+        for (v = name; v < name + len; v++)
+            h = fnv(h, *v);
+        h = fnv(h, ':');
+
+        found = 0;
+        end = q ? q->headers + q->len : NULL;
+        for (line = q ? q->headers : NULL; line && line < end; line = next) {
+            next = line + strcspn(line, "\n");
+            next += (*next == '\n');
+            if (strncasecmp(line, name, len) != 0 || line[len] != ':')
+                continue;
+            if (found++)
+                h = fnv(h, ',');
+            h = hash_value(h, line + len + 1, next);
+        }
+        h = fnv(h, found ? '\n' : '\0');
+
+        name += len;
+        if (*name == ',')
+            name++;
+    }
+    return h;
+}
+
+static char *skip_ws(char *p) {
+    while (*p == ' ' || *p == '\t')
+        p++;
+    return p;
+}
+
+/*
+ * header_is - line이 name 헤더이면 값의 시작을 *valuep에 두고 1을 반환
+ */
+static int header_is(char *line, char *name, char **valuep) {
+    size_t len = strlen(name);
+
+    if (strncasecmp(line, name, len) != 0 || line[len] != ':')
+        return 0;
+    *valuep = skip_ws(line + len + 1);
+    return 1;
+}
+
+static char *next_line(char *p, char *end) {
+    char *nl = memchr(p, '\n', end - p);
+
+    return nl ? nl + 1 : end;
+}
+
+/*
+ * field_name - 헤더 줄 [p, end)의 필드 이름 길이. 빈 줄이나 이어지는 줄,
+ * 콜론이 없는 줄이면 0
+ */
+static size_t field_name(char *p, char *end) {
+    char *c;
+
+    if (p == end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        return 0;
+    for (c = p; c < end && *c != ':'; c++)
+        ;
+    return c < end ? c - p : 0;
+}
+
+/*
+ * updatable - 304의 헤더 줄 [p, end)로 저장된 헤더를 바꿔도 되는지 판정
+ */
+static int updatable(char *p, char *end) {
+    size_t i, len = field_name(p, end);
+
+    if (len == 0)
+        return 0;
+    for (i = 0; i < sizeof(pinned_hdrs) / sizeof(pinned_hdrs[0]); i++)
+        if (strlen(pinned_hdrs[i]) == len && strncasecmp(p, pinned_hdrs[i], len) == 0)
+            return 0;
+    return 1;
+}
+
+/*
+ * replaced - 저장된 헤더 줄 [p, end)를 304 헤더 [upd, uend)의 같은 이름
+ * 필드가 대신하는지 판정
+ */
+static int replaced(char *p, char *end, char *upd, char *uend) {
+    size_t len = field_name(p, end);
+    char *u, *next;
+
+    if (len == 0)
+        return 0;
+    for (u = next_line(upd, uend); u < uend; u = next) {
+        next = next_line(u, uend);
+        if (field_name(u, next) == len && strncasecmp(u, p, len) == 0 && updatable(u, next))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * parse_cache_control - 쉼표로 구분된 Cache-Control 지시자 해석
+ */
+static void parse_cache_control(http_resp_t *r, char *v) {
+    char *p = v;
+
+    while (*p) {
+        p = skip_ws(p);
+        if (strncasecmp(p, "s-maxage=", 9) == 0)
+            r->s_maxage = atol(p + 9);
+        else if (strncasecmp(p, "max-age=", 8) == 0)
+            r->max_age = atol(p + 8);
+        else if (strncasecmp(p, "stale-while-revalidate=", 23) == 0)
+            r->swr = atol(p + 23);
+        else if (strncasecmp(p, "no-store", 8) == 0)
+            r->no_store = 1;
+        else if (strncasecmp(p, "private", 7) == 0)
+            r->private_ = 1;
+        else if (strncasecmp(p, "no-cache", 8) == 0)
+            r->no_cache = 1;
+        while (*p && *p != ',')
+            p++;
+        if (*p == ',')
+            p++;
+    }
+}
+
+/*
+ * parse_vary - Vary 값의 헤더 이름을 소문자로 r->vary에 이어 붙임
+ * "*"이거나 목록이 HTTP_VARY_MAX를 넘으면 변형을 가를 수 없으므로
+ * vary_any를 세워 캐시하지 않게 한다.
+ */
+static void parse_vary(http_resp_t *r, char *v) {
+    size_t n = strlen(r->vary), len;
+
+    while (*(v = skip_ws(v))) {
+        len = strcspn(v, ", \t\r\n");
+        if (len == 1 && *v == '*')
+            r->vary_any = 1;
+        if (len > 0) {
+            if (n + len + 2 > HTTP_VARY_MAX) {
+                r->vary_any = 1;
+                return;
+            }
+            if (n > 0)
+                r->vary[n++] = ',';
+            while (len-- > 0)
+                r->vary[n++] = tolower((unsigned char)*v++);
+            r->vary[n] = '\0';
+        }
+        v += strcspn(v, ",");
+        if (*v != ',')
+            break;
+        v++;
+    }
+}
+
+/*
+ * hash_value - 헤더 값 [p, end)를 앞뒤와 쉼표 주변 공백을 빼고 해시
+ */
+static unsigned long hash_value(unsigned long h, char *p, char *end) {
+    int space = 0, last = ',';
+
+    for (; p < end && *p != '\r' && *p != '\n'; p++) {
+        if (*p == ' ' || *p == '\t') {
+            space = 1;
+            continue;
+        }
+        if (space && last != ',' && *p != ',')
+            h = fnv(h, ' ');
+        space = 0;
+        h = fnv(h, *p);
+        last = *p;
+    }
+    return h;
+}
+
+static unsigned long fnv(unsigned long h, int c) {
+    return (h ^ (unsigned char)c) * 1099511628211UL;
+}
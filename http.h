@@ -0,0 +1,58 @@
+/*
+ * http.h - 캐시에 필요한 HTTP 요청/응답 헤더 해석
+ */
+#ifndef __HTTP_H__
+#define __HTTP_H__
+
+#include <stddef.h>
+#include <time.h>
+
+#define CACHE_DEFAULT_TTL 300       /* 신선도 정보가 없는 응답의 기본 유효 시간(초) */
+#define CACHE_HEURISTIC_MAX 86400   /* Last-Modified 기반 추정 유효 시간 상한(초) */
+#define HTTP_ETAG_MAX 128           /* 보관할 ETag 최대 길이 */
+#define HTTP_VARY_MAX 128           /* 보관할 Vary 헤더 이름 목록 최대 길이 */
+#define HTTP_REQ_MAX 8192           /* 보관할 클라이언트 요청 헤더 최대 길이 */
+
+/* 클라이언트 요청 헤더: 원 서버 전달과 Vary 변형 선택에 쓴다 */
+typedef struct {
+    char headers[HTTP_REQ_MAX];     /* 요청 줄 다음의 헤더 줄들 (CRLF 포함, 빈 줄 제외) */
+    size_t len;
+} http_req_t;
+
+/* 응답 헤더에서 뽑아낸 캐시 관련 정보 (-1은 헤더 없음) */
+typedef struct {
+    int status;                     /* 상태 코드 */
+    long content_length;
+    long max_age;                   /* Cache-Control: max-age */
+    long s_maxage;                  /* Cache-Control: s-maxage (공유 캐시 우선) */
+    long swr;                       /* Cache-Control: stale-while-revalidate */
+    long age;                       /* Age */
+    time_t date;                    /* Date */
+    time_t expires;                 /* Expires (해석 불가한 값은 0 = 이미 만료) */
+    time_t last_modified;           /* Last-Modified */
+    char etag[HTTP_ETAG_MAX];       /* ETag (빈 문자열이면 없음) */
+    char vary[HTTP_VARY_MAX];       /* Vary 헤더 이름, 소문자로 쉼표 구분 (빈 문자열이면 없음) */
+    int vary_any;                   /* Vary: * 이거나 목록이 너무 김 (캐시 불가) */
+    int no_store;                   /* Cache-Control: no-store */
+    int private_;                   /* Cache-Control: private */
+    int no_cache;                   /* Cache-Control: no-cache / Pragma: no-cache */
+} http_resp_t;
+
+void http_resp_init(http_resp_t *r);
+void http_resp_parse_line(http_resp_t *r, char *line);
+void http_resp_parse_head(http_resp_t *r, char *buf, size_t len);
+size_t http_merge_head(char *dst, char *head, size_t len, char *upd, size_t upd_len);
+int http_resp_cacheable(http_resp_t *r);
+int http_resp_shareable(http_resp_t *r);
+time_t http_resp_expiry(http_resp_t *r, time_t now);
+time_t http_parse_date(char *s);
+void http_format_date(char *buf, size_t len, time_t t);
+void http_req_init(http_req_t *q);
+int http_req_add_line(http_req_t *q, char *line);
+size_t http_req_scan(char *buf, size_t len, size_t *scanned);
+int http_req_parse(char *buf, size_t len, char *method, char *uri, char *version,
+                   size_t size, http_req_t *q);
+int http_req_get(http_req_t *q, char *name, char *buf, size_t size);
+unsigned long http_vary_hash(http_req_t *q, const char *vary);
+
+#endif /* __HTTP_H__ */
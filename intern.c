@@ -0,0 +1,72 @@
+/*
+ * intern.c - 자주 반복되는 짧은 문자열(헤더 이름 목록)의 인턴 표
+ *
+ * 캐시 객체마다 Vary 헤더 이름 목록("accept-encoding" 등)을 따로 Malloc해
+ * 두면, 거의 모든 객체가 같은 몇 가지 목록을 각자 16~32바이트씩 들고 있게
+ * 된다. 인턴 표는 같은 문자열을 한 번만 보관하고 그 포인터를 나눠 준다.
+ * 따라서 객체는 포인터 하나만 가지며, 두 목록이 같은지는 포인터 비교로
+ * 끝난다.
+ *
+ * 인턴한 문자열은 지우지 않는다. 원 서버가 매번 다른 목록을 보내 표가
+ * 끝없이 자라지 않도록 INTERN_MAX개를 넘으면 NULL을 돌려주며, 호출자는
+ * 그 응답을 캐시하지 않는다. 이미 있는 문자열은 읽기 락만 잡고 찾는다.
+ */
+#include "intern.h"
+#include "csapp.h"
+
+/* 인턴한 문자열 하나: 본문이 머리 바로 뒤에 붙는다 */
+typedef struct interned {
+    struct interned *next;          /* 해시 체인 */
+    unsigned long hash;
+    char str[];
+} interned_t;
+
+static interned_t *buckets[INTERN_BUCKETS];
+static int count;
+static pthread_rwlock_t intern_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static interned_t *find(const char *s, unsigned long hash);
+
+/*
+ * intern - s와 같은 내용의 공유 문자열을 반환 (없으면 만듦)
+ * 표가 가득 찼으면 NULL
+ */
+const char *intern(const char *s) {
+    unsigned long h = 14695981039346656037UL;
+    const unsigned char *c;
+    interned_t *x;
+    size_t len;
+
+    for (c = (const unsigned char *)s; *c; c++) {
+        h ^= *c;
+        h *= 1099511628211UL;
+    }
+
+    pthread_rwlock_rdlock(&intern_lock);
+    x = find(s, h);
+    pthread_rwlock_unlock(&intern_lock);
+    if (x)
+        return x->str;
+
+    pthread_rwlock_wrlock(&intern_lock);
+    if ((x = find(s, h)) == NULL && count < INTERN_MAX) {
+        len = strlen(s);
+        x = Malloc(sizeof(interned_t) + len + 1);
+        memcpy(x->str, s, len + 1);
+        x->hash = h;
+        x->next = buckets[h & (INTERN_BUCKETS - 1)];
+        buckets[h & (INTERN_BUCKETS - 1)] = x;
+        count++;
+    }
+    pthread_rwlock_unlock(&intern_lock);
+    return x ? x->str : NULL;
+}
+
+static interned_t *find(const char *s, unsigned long hash) {
+    interned_t *x;
+
+    for (x = buckets[hash & (INTERN_BUCKETS - 1)]; x; x = x->next)
+        if (x->hash == hash && strcmp(x->str, s) == 0)
+            return x;
+    return NULL;
+}
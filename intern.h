@@ -0,0 +1,12 @@
+/*
+ * intern.h - 자주 반복되는 짧은 문자열(헤더 이름 목록)의 인턴 표 인터페이스
+ */
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+#define INTERN_BUCKETS 256          /* 표 해시 버킷 수 (2의 거듭제곱) */
+#define INTERN_MAX 4096             /* 인턴할 문자열 수 상한 */
+
+const char *intern(const char *s);
+
+#endif /* __INTERN_H__ */
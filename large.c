@@ -0,0 +1,381 @@
+/*
+ * large.c - MAX_OBJECT_SIZE를 넘는 큰 객체용 파일 캐시
+ *
+ * 메모리 캐시와 디스크 계층은 MAX_OBJECT_SIZE 이하만 다루지만, 원 서버
+ * 대역폭은 동영상 같은 큰 객체가 가장 많이 쓴다. 이 계층은 그런 객체를
+ * 캐시 디렉터리에 객체당 파일 하나로 두고 적중하면 sendfile로 보낸다.
+ *
+ * forward_response는 캐시할 수 있는 큰 응답을 large_begin으로 만든 임시
+ * 파일(tmp.*)에 클라이언트로 보내는 같은 루프에서 이어 쓴다. 응답을 끝까지
+ * 받았을 때만 large_commit이 이름을 obj.*로 바꾸고 색인에 건다. 따라서
+ * 받다 만 파일은 색인에 오르지 않아 응답에 쓰이지 않는다.
+ *
+ * 계층은 메모리 캐시와 따로 바이트 예산과 LRU를 가진다. 적중하면 리스트
+ * 머리로 옮기고, 새 객체가 들어갈 자리는 꼬리부터 축출해 만든다. 축출한
+ * 파일은 바로 지우지만, 보내는 중인 스레드가 있으면 열린 fd로 끝까지
+ * 보낸다. 만료된 객체는 조회할 때 뺀다(재검증하지 않는다).
+ *
+ * 색인은 메모리에만 있으므로 시작할 때 디렉터리의 tmp.*, obj.* 파일을
+ * 모두 지우고 빈 상태로 시작한다. 색인과 LRU, 접두사 검색용 기수
+ * 트리(radix.c)는 large_lock 하나로 보호한다.
+ */
+#include "large.h"
+#include "radix.h"
+#include <dirent.h>
+#include <sys/sendfile.h>
+
+/* 완성된 큰 객체: 응답 전체(상태줄 + 헤더 + 본문)를 담은 파일 하나 */
+struct large_entry {
+    char *key;
+    unsigned long hash;
+    char *path;
+    int fd;                         /* 읽기용으로 열어 둔 파일 */
+    size_t size;
+    time_t expires;
+    int refcnt;                     /* 색인 1 + 보내는 중인 스레드 수 (large_lock) */
+    struct large_entry *hnext;      /* 해시 체인 */
+    struct large_entry *prev;       /* LRU 리스트 (head가 최근) */
+    struct large_entry *next;
+};
+
+/* 받는 중인 큰 객체 */
+struct large_writer {
+    char *key;
+    char *path;                     /* 임시 파일 */
+    int fd;
+    size_t size;
+    int failed;                     /* 쓰기 실패나 예산 초과: commit하지 않는다 */
+};
+
+static char *cache_dir;
+static size_t budget, bytes;
+static unsigned long next_seq;
+static large_entry_t *buckets[LARGE_BUCKETS];
+static large_entry_t *lru_head, *lru_tail;
+static radix_t keys;
+static pthread_mutex_t large_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long hash_key(char *key);
+static large_entry_t *find(char *key, unsigned long hash);
+static void remove_entry(large_entry_t *e);
+static void lru_unlink(large_entry_t *e);
+static void lru_push(large_entry_t *e);
+static void put_entry(large_entry_t *e);
+static char *make_path(char *name);
+
+/*
+ * large_init - 캐시 디렉터리를 만들고 지난 실행의 파일을 지움. 실패하면 -1
+ */
+int large_init(char *dir, size_t size) {
+    DIR *d;
+    struct dirent *de;
+    char *path;
+
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        fprintf(stderr, "large: %s 만들기 실패: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    if ((d = opendir(dir)) == NULL) {
+        fprintf(stderr, "large: %s 열기 실패: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    cache_dir = dir;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, "tmp.", 4) != 0 && strncmp(de->d_name, "obj.", 4) != 0)
+            continue;
+        path = make_path(de->d_name);
+        unlink(path);
+        Free(path);
+    }
+    closedir(d);
+    budget = size;
+    return 0;
+}
+
+int large_enabled(void) {
+    return cache_dir != NULL;
+}
+
+/*
+ * large_lookup - 키에 해당하는 신선한 큰 객체를 참조를 잡은 채 반환
+ * 호출자는 large_send 뒤 large_release한다. 없거나 만료되었으면 NULL.
+ */
+large_entry_t *large_lookup(char *key) {
+    unsigned long h = hash_key(key);
+    large_entry_t *e;
+
+    if (!cache_dir)
+        return NULL;
+    pthread_mutex_lock(&large_lock);
+    if ((e = find(key, h)) != NULL) {
+        if (e->expires <= time(NULL)) {
+            remove_entry(e);
+            e = NULL;
+        } else {
+            e->refcnt++;
+            lru_unlink(e);
+            lru_push(e);
+        }
+    }
+    pthread_mutex_unlock(&large_lock);
+    return e;
+}
+
+/*
+ * large_send - 객체 파일 전체를 fd로 보냄
+ * 오프셋을 넘기는 sendfile은 파일 위치를 바꾸지 않으므로 여러 스레드가
+ * 같은 fd로 동시에 보낼 수 있다. sendfile이 실패하면 남은 부분을
+ * pread와 rio_writen으로 보낸다. 클라이언트가 끊었으면 -1
+ */
+int large_send(large_entry_t *e, int fd) {
+    char buf[MAXBUF];
+    off_t off = 0;
+    ssize_t n;
+
+    while ((size_t)off < e->size) {
+        if ((n = sendfile(fd, e->fd, &off, e->size - off)) > 0)
+            continue;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN && rio_wait && rio_wait(fd, 1) == 0)
+            continue;
+        break;
+    }
+    while ((size_t)off < e->size) {
+        n = e->size - off < sizeof(buf) ? e->size - off : sizeof(buf);
+        if ((n = pread(e->fd, buf, n, off)) <= 0 || rio_writen(fd, buf, n) != n)
+            return -1;
+        off += n;
+    }
+    return 0;
+}
+
+/*
+ * large_release - large_lookup으로 잡은 참조를 놓음
+ */
+void large_release(large_entry_t *e) {
+    pthread_mutex_lock(&large_lock);
+    put_entry(e);
+    pthread_mutex_unlock(&large_lock);
+}
+
+/*
+ * large_purge - 키가 key인 객체(prefix면 key로 시작하는 모든 객체)를 지움
+ * 지운 객체 수를 반환한다.
+ */
+int large_purge(char *key, int prefix) {
+    char **list;
+    large_entry_t *e;
+    int i, n, purged = 0;
+
+    if (!cache_dir)
+        return 0;
+    pthread_mutex_lock(&large_lock);
+    if (!prefix) {
+        if ((e = find(key, hash_key(key))) != NULL) {
+            remove_entry(e);
+            purged++;
+        }
+    } else {
+        n = radix_collect(&keys, key, &list);
+        for (i = 0; i < n; i++) {
+            if ((e = find(list[i], hash_key(list[i]))) != NULL) {
+                remove_entry(e);
+                purged++;
+            }
+        }
+        radix_free_keys(list, n);
+    }
+    pthread_mutex_unlock(&large_lock);
+    return purged;
+}
+
+/*
+ * large_begin - 큰 객체를 받을 임시 파일을 만듦. 실패하면 NULL
+ */
+large_writer_t *large_begin(char *key) {
+    large_writer_t *w;
+
+    if (!cache_dir)
+        return NULL;
+    w = Malloc(sizeof(large_writer_t));
+    w->path = make_path("tmp.XXXXXX");
+    if ((w->fd = mkstemp(w->path)) < 0) {
+        Free(w->path);
+        Free(w);
+        return NULL;
+    }
+    w->key = Malloc(strlen(key) + 1);
+    strcpy(w->key, key);
+    w->size = 0;
+    w->failed = 0;
+    return w;
+}
+
+/*
+ * large_append - 받은 바이트를 임시 파일에 이어 씀
+ * 쓰기에 실패하거나 예산을 넘으면 -1을 반환하며, 이후 commit은 abort가 된다.
+ */
+int large_append(large_writer_t *w, char *buf, size_t n) {
+    ssize_t rc;
+
+    if (w->failed)
+        return -1;
+    if (w->size + n > budget) {
+        w->failed = 1;
+        return -1;
+    }
+    while (n > 0) {
+        if ((rc = write(w->fd, buf, n)) < 0) {
+            if (errno == EINTR)
+                continue;
+            w->failed = 1;
+            return -1;
+        }
+        buf += rc;
+        n -= rc;
+        w->size += rc;
+    }
+    return 0;
+}
+
+/*
+ * large_commit - 끝까지 받은 객체를 색인에 걸고 writer를 해제
+ * 임시 파일의 이름을 obj.*로 바꾼 뒤에야 색인에 오른다. 같은 키의 이전
+ * 객체는 교체하고, 예산이 모자라면 LRU 꼬리부터 축출한다.
+ */
+void large_commit(large_writer_t *w, time_t expires) {
+    char name[64];
+    large_entry_t *e, *old;
+
+    if (w->failed || w->size == 0) {
+        large_abort(w);
+        return;
+    }
+
+    e = Malloc(sizeof(large_entry_t));
+    e->key = w->key;
+    e->hash = hash_key(w->key);
+    e->fd = w->fd;
+    e->size = w->size;
+    e->expires = expires;
+    e->refcnt = 1;                  /* 색인이 가진 참조 */
+
+    pthread_mutex_lock(&large_lock);
+    sprintf(name, "obj.%016lx.%lu", e->hash, next_seq++);
+    e->path = make_path(name);
+    if (rename(w->path, e->path) < 0) {
+        pthread_mutex_unlock(&large_lock);
+        unlink(w->path);
+        close(e->fd);
+        Free(e->path);
+        Free(e->key);
+        Free(e);
+        Free(w->path);
+        Free(w);
+        return;
+    }
+    if ((old = find(e->key, e->hash)) != NULL)
+        remove_entry(old);
+    while (bytes + e->size > budget && lru_tail)
+        remove_entry(lru_tail);
+    e->hnext = buckets[e->hash & (LARGE_BUCKETS - 1)];
+    buckets[e->hash & (LARGE_BUCKETS - 1)] = e;
+    lru_push(e);
+    radix_insert(&keys, e->key, strlen(e->key));
+    bytes += e->size;
+    pthread_mutex_unlock(&large_lock);
+
+    Free(w->path);
+    Free(w);
+}
+
+/*
+ * large_abort - 받다 만 객체의 임시 파일을 지우고 writer를 해제
+ */
+void large_abort(large_writer_t *w) {
+    unlink(w->path);
+    close(w->fd);
+    Free(w->path);
+    Free(w->key);
+    Free(w);
+}
+
+static unsigned long hash_key(char *key) {
+    unsigned long h = 14695981039346656037UL;
+
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+static large_entry_t *find(char *key, unsigned long hash) {
+    large_entry_t *e;
+
+    for (e = buckets[hash & (LARGE_BUCKETS - 1)]; e; e = e->hnext)
+        if (e->hash == hash && strcmp(e->key, key) == 0)
+            return e;
+    return NULL;
+}
+
+/*
+ * remove_entry - 객체를 색인과 LRU에서 빼고 파일을 지움 (large_lock 안에서)
+ * 보내는 중인 스레드가 있으면 fd는 마지막 참조가 놓일 때 닫힌다.
+ */
+static void remove_entry(large_entry_t *e) {
+    large_entry_t **pp;
+
+    for (pp = &buckets[e->hash & (LARGE_BUCKETS - 1)]; *pp; pp = &(*pp)->hnext) {
+        if (*pp == e) {
+            *pp = e->hnext;
+            break;
+        }
+    }
+    lru_unlink(e);
+    radix_remove(&keys, e->key, strlen(e->key));
+    bytes -= e->size;
+    unlink(e->path);
+    put_entry(e);
+}
+
+static void lru_unlink(large_entry_t *e) {
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        lru_head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        lru_tail = e->prev;
+}
+
+static void lru_push(large_entry_t *e) {
+    e->prev = NULL;
+    e->next = lru_head;
+    if (lru_head)
+        lru_head->prev = e;
+    else
+        lru_tail = e;
+    lru_head = e;
+}
+
+/*
+ * put_entry - 참조 하나를 놓고 마지막이면 해제 (large_lock 안에서)
+ */
+static void put_entry(large_entry_t *e) {
+    if (--e->refcnt > 0)
+        return;
+    close(e->fd);
+    Free(e->path);
+    Free(e->key);
+    Free(e);
+}
+
+static char *make_path(char *name) {
+    char *path = Malloc(strlen(cache_dir) + strlen(name) + 2);
+
+    sprintf(path, "%s/%s", cache_dir, name);
+    return path;
+}
@@ -0,0 +1,26 @@
+/*
+ * large.h - MAX_OBJECT_SIZE를 넘는 큰 객체용 파일 캐시 인터페이스
+ */
+#ifndef __LARGE_H__
+#define __LARGE_H__
+
+#include "csapp.h"
+
+#define LARGE_DEFAULT_BUDGET (256UL << 20) /* 기본 바이트 예산 (256MB) */
+#define LARGE_BUCKETS 1024          /* 색인 해시 버킷 수 (2의 거듭제곱) */
+
+typedef struct large_entry large_entry_t;
+typedef struct large_writer large_writer_t;
+
+int large_init(char *dir, size_t budget);
+int large_enabled(void);
+large_entry_t *large_lookup(char *key);
+int large_send(large_entry_t *e, int fd);
+void large_release(large_entry_t *e);
+int large_purge(char *key, int prefix);
+large_writer_t *large_begin(char *key);
+int large_append(large_writer_t *w, char *buf, size_t n);
+void large_commit(large_writer_t *w, time_t expires);
+void large_abort(large_writer_t *w);
+
+#endif /* __LARGE_H__ */
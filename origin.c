@@ -0,0 +1,193 @@
+/*
+ * origin.c - 원 서버(호스트)별 캐시 점유량, 할당량, 적중률
+ *
+ * 여럿이 함께 쓰는 포워드 프록시에서는 한 원 서버를 긁어 가는 크롤러
+ * 하나가 다른 사용자들의 자주 쓰는 객체를 모두 밀어낼 수 있다. 캐시 키의
+ * 호스트[:포트] 부분마다 메모리 캐시에 있는 바이트를 세고, 소프트
+ * 할당량(-Q)을 넘은 호스트는 다음처럼 다룬다(cache.c insert_entry).
+ *
+ * - 승인: 자리를 만들려면 축출이 필요한데 새 객체의 호스트가 할당량을
+ *   넘으면, 할당량 안의 다른 호스트 객체를 밀어내지 못한다.
+ * - 축출: 할당량을 넘은 호스트의 객체는 TinyLFU 비교 없이 축출된다.
+ *
+ * 빈 자리가 있으면 할당량을 넘어도 들어가므로 소프트 할당량이다.
+ * 할당량은 모든 호스트에 쓰는 기본값(-Q 바이트)과 호스트별 값
+ * (-Q 호스트=바이트)으로 정한다.
+ *
+ * 호스트 레코드는 한 번 만들면 지우지 않으며, ORIGIN_MAX개를 넘는
+ * 호스트는 ORIGIN_OTHER 하나로 묶어 센다. 표는 rwlock으로 보호하고,
+ * 이미 있는 호스트를 찾을 때는 읽기 락만 잡는다.
+ */
+#include "origin.h"
+
+static origin_t *buckets[ORIGIN_BUCKETS];
+static origin_t *other;
+static int origin_count_;           /* 만든 레코드 수 */
+static size_t default_quota;        /* 0이면 할당량 없음 */
+static pthread_rwlock_t origin_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static origin_t *lookup(char *name, size_t len, unsigned long hash, int create);
+static unsigned long hash_name(char *name, size_t len);
+static void print_origin(int fd, origin_t *o);
+
+/*
+ * origin_set_quota - "-Q 바이트" 또는 "-Q 호스트[:포트]=바이트"를 적용
+ * 스레드를 만들기 전에 호출한다. 형식이 틀리면 -1
+ */
+int origin_set_quota(char *arg) {
+    char *eq = strchr(arg, '='), *end;
+    unsigned long quota;
+    origin_t *o;
+    size_t len;
+
+    quota = strtoul(eq ? eq + 1 : arg, &end, 10);
+    if (*end != '\0' || end == (eq ? eq + 1 : arg))
+        return -1;
+    if (!eq) {
+        default_quota = quota;
+        return 0;
+    }
+    if ((len = eq - arg) == 0 || len >= ORIGIN_NAME_MAX)
+        return -1;
+    for (end = arg; end < eq; end++)
+        *end = tolower((unsigned char)*end);
+    o = lookup(arg, len, hash_name(arg, len), 1);
+    o->quota = quota;
+    return 0;
+}
+
+/*
+ * origin_get - 캐시 키(호스트[:포트]/경로)의 호스트 레코드를 찾거나 만듦
+ */
+origin_t *origin_get(char *key) {
+    size_t len = strcspn(key, "/");
+    unsigned long hash;
+    origin_t *o;
+
+    if (len >= ORIGIN_NAME_MAX)
+        len = ORIGIN_NAME_MAX - 1;
+    hash = hash_name(key, len);
+
+    pthread_rwlock_rdlock(&origin_lock);
+    if ((o = lookup(key, len, hash, 0)) == NULL && origin_count_ >= ORIGIN_MAX)
+        o = other;
+    pthread_rwlock_unlock(&origin_lock);
+    if (o)
+        return o;
+
+    pthread_rwlock_wrlock(&origin_lock);
+    o = lookup(key, len, hash, 1);
+    pthread_rwlock_unlock(&origin_lock);
+    return o;
+}
+
+/*
+ * origin_charge - 호스트의 캐시 점유량에 객체 하나를 더하거나(add) 뺌
+ */
+void origin_charge(origin_t *o, size_t size, int add) {
+    if (add) {
+        __atomic_add_fetch(&o->bytes, size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&o->objects, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_sub_fetch(&o->bytes, size, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&o->objects, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * origin_over - extra바이트를 더하면 호스트가 할당량을 넘는지
+ */
+int origin_over(origin_t *o, size_t extra) {
+    size_t quota = o->quota ? o->quota : default_quota;
+
+    return quota && __atomic_load_n(&o->bytes, __ATOMIC_RELAXED) + extra > quota;
+}
+
+/*
+ * origin_count - 요청 하나를 적중(hit) 또는 미스로 셈
+ */
+void origin_count(origin_t *o, int hit) {
+    __atomic_add_fetch(hit ? &o->hits : &o->misses, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * origin_stats - 호스트별 점유량과 적중률을 텍스트 표로 fd에 씀
+ * 쓰기는 느린 클라이언트나 코루틴 전환에서 멈출 수 있으므로, 읽기 락
+ * 안에서는 레코드 목록만 복사하고 락을 놓은 뒤 쓴다. 레코드는 지우지
+ * 않으므로 락 밖에서 읽어도 된다.
+ */
+void origin_stats(int fd) {
+    char line[MAXLINE];
+    origin_t *o, **rows;
+    int i, n, count = 0;
+
+    n = snprintf(line, sizeof(line), "\norigin: 기본 할당량 %zu바이트\n"
+                 "%-32s %10s %8s %10s %10s %10s %6s\n", default_quota,
+                 "host", "bytes", "objects", "quota", "hits", "misses", "hit%");
+    rio_writen(fd, line, n);
+
+    pthread_rwlock_rdlock(&origin_lock);
+    rows = Malloc((origin_count_ + 1) * sizeof(origin_t *));
+    for (i = 0; i < ORIGIN_BUCKETS; i++)
+        for (o = buckets[i]; o; o = o->next)
+            rows[count++] = o;
+    if (other)
+        rows[count++] = other;
+    pthread_rwlock_unlock(&origin_lock);
+
+    for (i = 0; i < count; i++)
+        print_origin(fd, rows[i]);
+    Free(rows);
+}
+
+/*
+ * lookup - 표에서 호스트 검색. create면 없을 때 만든다 (쓰기 락 필요)
+ */
+static origin_t *lookup(char *name, size_t len, unsigned long hash, int create) {
+    origin_t *o;
+
+    for (o = buckets[hash & (ORIGIN_BUCKETS - 1)]; o; o = o->next)
+        if (strncmp(o->name, name, len) == 0 && o->name[len] == '\0')
+            return o;
+    if (!create)
+        return NULL;
+
+    if (origin_count_ >= ORIGIN_MAX) {
+        if (!other) {
+            other = Calloc(1, sizeof(origin_t));
+            strcpy(other->name, ORIGIN_OTHER);
+        }
+        return other;
+    }
+    o = Calloc(1, sizeof(origin_t));
+    memcpy(o->name, name, len);
+    o->name[len] = '\0';
+    o->next = buckets[hash & (ORIGIN_BUCKETS - 1)];
+    buckets[hash & (ORIGIN_BUCKETS - 1)] = o;
+    origin_count_++;
+    return o;
+}
+
+static unsigned long hash_name(char *name, size_t len) {
+    unsigned long h = 14695981039346656037UL;
+
+    while (len-- > 0) {
+        h ^= (unsigned char)*name++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+static void print_origin(int fd, origin_t *o) {
+    char line[MAXLINE];
+    unsigned long hits = __atomic_load_n(&o->hits, __ATOMIC_RELAXED);
+    unsigned long misses = __atomic_load_n(&o->misses, __ATOMIC_RELAXED);
+    int n;
+
+    n = snprintf(line, sizeof(line), "%-32s %10zu %8lu %10zu %10lu %10lu %6.1f\n",
+                 o->name, __atomic_load_n(&o->bytes, __ATOMIC_RELAXED),
+                 __atomic_load_n(&o->objects, __ATOMIC_RELAXED),
+                 o->quota ? o->quota : default_quota, hits, misses,
+                 hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+    rio_writen(fd, line, n);
+}
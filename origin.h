@@ -0,0 +1,31 @@
+/*
+ * origin.h - 원 서버(호스트)별 캐시 점유량, 할당량, 적중률 인터페이스
+ */
+#ifndef __ORIGIN_H__
+#define __ORIGIN_H__
+
+#include "csapp.h"
+
+#define ORIGIN_BUCKETS 256          /* 호스트 표 해시 버킷 수 (2의 거듭제곱) */
+#define ORIGIN_MAX 1024             /* 따로 셀 호스트 수 (넘으면 ORIGIN_OTHER로 묶음) */
+#define ORIGIN_NAME_MAX 256         /* 보관할 호스트[:포트] 최대 길이 */
+#define ORIGIN_OTHER "(other)"
+
+/* 원 서버 하나의 통계. 바이트와 카운터는 원자적으로 갱신한다. */
+typedef struct origin {
+    char name[ORIGIN_NAME_MAX];     /* 캐시 키의 호스트[:포트] 부분 */
+    size_t quota;                   /* 이 호스트의 소프트 할당량 (0이면 기본값) */
+    size_t bytes;                   /* 메모리 캐시에 있는 이 호스트 객체의 바이트 */
+    unsigned long objects;          /* 메모리 캐시에 있는 객체 수 */
+    unsigned long hits, misses;     /* 캐시로 응답한 요청 / 원 서버로 간 요청 */
+    struct origin *next;            /* 해시 체인 */
+} origin_t;
+
+int origin_set_quota(char *arg);
+origin_t *origin_get(char *key);
+void origin_charge(origin_t *o, size_t size, int add);
+int origin_over(origin_t *o, size_t extra);
+void origin_count(origin_t *o, int hit);
+void origin_stats(int fd);
+
+#endif /* __ORIGIN_H__ */
@@ -0,0 +1,313 @@
+/*
+ * policy.c - 캐시 축출 정책
+ *
+ * 크기가 수백 바이트인 HTML부터 100KB 이미지까지 섞인 트래픽에서는 어떤
+ * 정책이 나은지가 트래픽마다 다르므로, 샤드가 축출 정책을 함수 표로
+ * 불러 쓰게 하고 시작할 때 하나를 고른다(-p).
+ *
+ * - clock: second chance. 적중은 참조 비트만 원자적으로 세우므로 락이
+ *   필요 없다. 기본값.
+ * - lru: 적중한 객체를 리스트 머리로 옮기고 꼬리부터 축출.
+ * - slru: 시험 구역과 보호 구역으로 나눈 LRU. 새 객체는 시험 구역에
+ *   들어가고 다시 적중해야 보호 구역(예산의 SLRU_PROTECTED_PCT%)으로
+ *   오른다. 한 번 훑고 지나가는 요청이 자주 쓰는 객체를 밀어내지 못한다.
+ * - gdsf: GreedyDual-Size-Frequency. 우선순위 L + 빈도/크기가 가장 낮은
+ *   객체를 축출하고 L을 그 값으로 올린다. 작고 자주 쓰이는 객체를 오래
+ *   남기며, L이 오르면서 오래 적중하지 않은 큰 객체도 결국 밀려난다.
+ *
+ * 적중 때 리스트나 힙을 고치는 정책은 샤드의 읽기 락 아래에서 정책 상태의
+ * lock을 잡는다. 삽입, 제거, 축출은 쓰기 락 아래이므로 따로 잡지 않는다.
+ */
+#include "policy.h"
+
+cache_policy_t *cache_policy;
+
+static void clock_insert(policy_state_t *ps, cache_entry_t *e);
+static void clock_remove(policy_state_t *ps, cache_entry_t *e);
+static void clock_hit(policy_state_t *ps, cache_entry_t *e);
+static cache_entry_t *clock_victim(policy_state_t *ps);
+static void clock_restore(policy_state_t *ps, cache_entry_t *e);
+static void lru_insert(policy_state_t *ps, cache_entry_t *e);
+static void lru_remove(policy_state_t *ps, cache_entry_t *e);
+static void lru_hit(policy_state_t *ps, cache_entry_t *e);
+static cache_entry_t *lru_victim(policy_state_t *ps);
+static void lru_restore(policy_state_t *ps, cache_entry_t *e);
+static void slru_hit(policy_state_t *ps, cache_entry_t *e);
+static cache_entry_t *slru_victim(policy_state_t *ps);
+static void gdsf_insert(policy_state_t *ps, cache_entry_t *e);
+static void gdsf_remove(policy_state_t *ps, cache_entry_t *e);
+static void gdsf_hit(policy_state_t *ps, cache_entry_t *e);
+static cache_entry_t *gdsf_victim(policy_state_t *ps);
+static void gdsf_restore(policy_state_t *ps, cache_entry_t *e);
+static void list_push(policy_state_t *ps, int seg, cache_entry_t *e);
+static void list_append(policy_state_t *ps, int seg, cache_entry_t *e);
+static void list_unlink(policy_state_t *ps, cache_entry_t *e);
+static double gdsf_priority(policy_state_t *ps, cache_entry_t *e);
+static void heap_up(policy_state_t *ps, size_t i);
+static void heap_down(policy_state_t *ps, size_t i);
+
+static cache_policy_t policies[] = {
+    { "clock", clock_insert, clock_remove, clock_hit, clock_victim, clock_restore },
+    { "lru", lru_insert, lru_remove, lru_hit, lru_victim, lru_restore },
+    { "slru", lru_insert, lru_remove, slru_hit, slru_victim, lru_restore },
+    { "gdsf", gdsf_insert, gdsf_remove, gdsf_hit, gdsf_victim, gdsf_restore },
+};
+
+/*
+ * policy_select - 이름으로 축출 정책을 고름. 모르는 이름이면 -1
+ */
+int policy_select(char *name) {
+    int i;
+
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        if (strcasecmp(name, policies[i].name) == 0) {
+            cache_policy = &policies[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * policy_init - 샤드 하나의 정책 상태 초기화
+ */
+void policy_init(policy_state_t *ps, size_t capacity) {
+    if (!cache_policy)
+        policy_select(POLICY_DEFAULT);
+    memset(ps, 0, sizeof(*ps));
+    pthread_mutex_init(&ps->lock, NULL);
+    ps->capacity = capacity;
+}
+
+/*
+ * clock_insert - 새 객체를 바늘 바로 뒤(가장 나중에 검사될 위치)에 삽입
+ */
+static void clock_insert(policy_state_t *ps, cache_entry_t *e) {
+    if (!ps->hand) {
+        e->prev = e->next = e;
+        ps->hand = e;
+        return;
+    }
+    e->next = ps->hand;
+    e->prev = ps->hand->prev;
+    ps->hand->prev->next = e;
+    ps->hand->prev = e;
+}
+
+static void clock_remove(policy_state_t *ps, cache_entry_t *e) {
+    if (e->next == e) {
+        ps->hand = NULL;
+        return;
+    }
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+    if (ps->hand == e)
+        ps->hand = e->next;
+}
+
+static void clock_hit(policy_state_t *ps, cache_entry_t *e) {
+    __atomic_store_n(&e->referenced, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * clock_victim - 참조 비트가 꺼진 객체를 만날 때까지 바늘을 돌림
+ * 바늘을 후보 다음으로 옮겨 두므로, 승인 필터가 후보를 살려도 다음
+ * 호출은 다른 객체를 본다.
+ */
+static cache_entry_t *clock_victim(policy_state_t *ps) {
+    cache_entry_t *e;
+
+    if (!ps->hand)
+        return NULL;
+    while (__atomic_exchange_n(&ps->hand->referenced, 0, __ATOMIC_RELAXED))
+        ps->hand = ps->hand->next;
+    e = ps->hand;
+    ps->hand = e->next;
+    return e;
+}
+
+/*
+ * clock_restore - 되돌린 후보를 바늘 위치에 넣어 다음에 가장 먼저 검사
+ */
+static void clock_restore(policy_state_t *ps, cache_entry_t *e) {
+    clock_insert(ps, e);
+    ps->hand = e;
+}
+
+static void lru_insert(policy_state_t *ps, cache_entry_t *e) {
+    list_push(ps, SEG_PROBATION, e);
+}
+
+static void lru_remove(policy_state_t *ps, cache_entry_t *e) {
+    list_unlink(ps, e);
+}
+
+static void lru_hit(policy_state_t *ps, cache_entry_t *e) {
+    pthread_mutex_lock(&ps->lock);
+    if (ps->head[SEG_PROBATION] != e) {
+        list_unlink(ps, e);
+        list_push(ps, SEG_PROBATION, e);
+    }
+    pthread_mutex_unlock(&ps->lock);
+}
+
+static cache_entry_t *lru_victim(policy_state_t *ps) {
+    return ps->tail[SEG_PROBATION];
+}
+
+/*
+ * lru_restore - 되돌린 후보를 원래 구역의 꼬리에 다시 붙임 (LRU, SLRU)
+ */
+static void lru_restore(policy_state_t *ps, cache_entry_t *e) {
+    list_append(ps, e->segment, e);
+}
+
+/*
+ * slru_hit - 적중한 객체를 보호 구역 머리로 올림. 보호 구역이 넘치면
+ * 꼬리를 시험 구역 머리로 내려 한 번 더 기회를 준다.
+ */
+static void slru_hit(policy_state_t *ps, cache_entry_t *e) {
+    size_t limit = ps->capacity / 100 * SLRU_PROTECTED_PCT;
+    cache_entry_t *t;
+
+    pthread_mutex_lock(&ps->lock);
+    if (ps->head[SEG_PROTECTED] != e) {
+        list_unlink(ps, e);
+        list_push(ps, SEG_PROTECTED, e);
+        while (ps->seg_bytes[SEG_PROTECTED] > limit &&
+               (t = ps->tail[SEG_PROTECTED]) != e) {
+            list_unlink(ps, t);
+            list_push(ps, SEG_PROBATION, t);
+        }
+    }
+    pthread_mutex_unlock(&ps->lock);
+}
+
+static cache_entry_t *slru_victim(policy_state_t *ps) {
+    return ps->tail[SEG_PROBATION] ? ps->tail[SEG_PROBATION] : ps->tail[SEG_PROTECTED];
+}
+
+static void gdsf_insert(policy_state_t *ps, cache_entry_t *e) {
+    if (ps->heap_len == ps->heap_cap) {
+        ps->heap_cap = ps->heap_cap ? ps->heap_cap * 2 : 64;
+        ps->heap = Realloc(ps->heap, ps->heap_cap * sizeof(cache_entry_t *));
+    }
+    e->freq = 1;
+    e->priority = gdsf_priority(ps, e);
+    e->heap_idx = ps->heap_len;
+    ps->heap[ps->heap_len++] = e;
+    heap_up(ps, e->heap_idx);
+}
+
+static void gdsf_remove(policy_state_t *ps, cache_entry_t *e) {
+    size_t i = e->heap_idx;
+
+    ps->heap[i] = ps->heap[--ps->heap_len];
+    ps->heap[i]->heap_idx = i;
+    if (i < ps->heap_len) {
+        heap_up(ps, i);
+        heap_down(ps, ps->heap[i]->heap_idx);
+    }
+}
+
+static void gdsf_hit(policy_state_t *ps, cache_entry_t *e) {
+    pthread_mutex_lock(&ps->lock);
+    e->freq++;
+    e->priority = gdsf_priority(ps, e);
+    heap_down(ps, e->heap_idx);     /* 우선순위는 오르기만 한다 */
+    pthread_mutex_unlock(&ps->lock);
+}
+
+/*
+ * gdsf_victim - 우선순위가 가장 낮은 객체. L을 그 값으로 올려 남은
+ * 객체들이 상대적으로 늙게 한다.
+ */
+static cache_entry_t *gdsf_victim(policy_state_t *ps) {
+    if (ps->heap_len == 0)
+        return NULL;
+    ps->inflation = ps->heap[0]->priority;
+    return ps->heap[0];
+}
+
+/*
+ * gdsf_restore - 되돌린 후보를 빈도와 우선순위를 유지한 채 힙에 다시 넣음
+ * victim이 올린 L은 되돌리지 않는다.
+ */
+static void gdsf_restore(policy_state_t *ps, cache_entry_t *e) {
+    e->heap_idx = ps->heap_len;
+    ps->heap[ps->heap_len++] = e;
+    heap_up(ps, e->heap_idx);
+}
+
+static double gdsf_priority(policy_state_t *ps, cache_entry_t *e) {
+    return ps->inflation + (double)e->freq * 1024.0 / (double)(e->size + 1);
+}
+
+static void list_push(policy_state_t *ps, int seg, cache_entry_t *e) {
+    e->segment = seg;
+    e->prev = NULL;
+    e->next = ps->head[seg];
+    if (ps->head[seg])
+        ps->head[seg]->prev = e;
+    else
+        ps->tail[seg] = e;
+    ps->head[seg] = e;
+    ps->seg_bytes[seg] += e->size;
+}
+
+static void list_append(policy_state_t *ps, int seg, cache_entry_t *e) {
+    e->segment = seg;
+    e->next = NULL;
+    e->prev = ps->tail[seg];
+    if (ps->tail[seg])
+        ps->tail[seg]->next = e;
+    else
+        ps->head[seg] = e;
+    ps->tail[seg] = e;
+    ps->seg_bytes[seg] += e->size;
+}
+
+static void list_unlink(policy_state_t *ps, cache_entry_t *e) {
+    int seg = e->segment;
+
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        ps->head[seg] = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        ps->tail[seg] = e->prev;
+    ps->seg_bytes[seg] -= e->size;
+}
+
+static void heap_up(policy_state_t *ps, size_t i) {
+    cache_entry_t *e = ps->heap[i];
+    size_t parent;
+
+    while (i > 0 && ps->heap[parent = (i - 1) / 2]->priority > e->priority) {
+        ps->heap[i] = ps->heap[parent];
+        ps->heap[i]->heap_idx = i;
+        i = parent;
+    }
+    ps->heap[i] = e;
+    e->heap_idx = i;
+}
+
+static void heap_down(policy_state_t *ps, size_t i) {
+    cache_entry_t *e = ps->heap[i];
+    size_t child;
+
+    while ((child = 2 * i + 1) < ps->heap_len) {
+        if (child + 1 < ps->heap_len &&
+            ps->heap[child + 1]->priority < ps->heap[child]->priority)
+            child++;
+        if (ps->heap[child]->priority >= e->priority)
+            break;
+        ps->heap[i] = ps->heap[child];
+        ps->heap[i]->heap_idx = i;
+        i = child;
+    }
+    ps->heap[i] = e;
+    e->heap_idx = i;
+}
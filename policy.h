@@ -0,0 +1,50 @@
+/*
+ * policy.h - 캐시 축출 정책 인터페이스
+ */
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include "cache.h"
+
+#define POLICY_DEFAULT "clock"      /* 기본 축출 정책 */
+#define SLRU_PROTECTED_PCT 80       /* SLRU 보호 구역이 차지할 샤드 예산 비율(%) */
+
+#define SEG_PROBATION 0             /* SLRU 시험 구역 (LRU는 이 구역만 씀) */
+#define SEG_PROTECTED 1             /* SLRU 보호 구역: 두 번 이상 적중한 객체 */
+
+/*
+ * 샤드마다 하나씩 두는 정책 상태. 삽입, 제거, 축출 후보 선택은 샤드의
+ * index_lock을 쓰기 모드로 잡은 상태에서, 적중 갱신은 읽기 모드로 잡은
+ * 상태에서 불린다. 적중 때 리스트를 고치는 정책은 lock으로 서로를 막는다.
+ */
+typedef struct {
+    pthread_mutex_t lock;           /* 적중 갱신끼리의 보호 */
+    size_t capacity;                /* 샤드 바이트 예산 */
+    cache_entry_t *hand;            /* CLOCK 바늘 */
+    cache_entry_t *head[2], *tail[2]; /* LRU/SLRU 구역별 리스트 (head가 최근) */
+    size_t seg_bytes[2];            /* 구역별 바이트 수 */
+    cache_entry_t **heap;           /* GDSF 우선순위 최소 힙 */
+    size_t heap_len, heap_cap;
+    double inflation;               /* GDSF 기준값 L: 마지막으로 축출한 우선순위 */
+} policy_state_t;
+
+/*
+ * 축출 정책: 시작할 때 이름으로 하나를 고른다
+ * restore는 victim으로 받아 remove한 후보를 축출하지 않기로 했을 때 다시
+ * 축출 쪽 끝에 되돌린다. 여러 개를 뗐으면 뗀 역순으로 부른다.
+ */
+typedef struct {
+    char *name;
+    void (*insert)(policy_state_t *ps, cache_entry_t *e);
+    void (*remove)(policy_state_t *ps, cache_entry_t *e);
+    void (*hit)(policy_state_t *ps, cache_entry_t *e);
+    cache_entry_t *(*victim)(policy_state_t *ps);
+    void (*restore)(policy_state_t *ps, cache_entry_t *e);
+} cache_policy_t;
+
+extern cache_policy_t *cache_policy;
+
+int policy_select(char *name);
+void policy_init(policy_state_t *ps, size_t capacity);
+
+#endif /* __POLICY_H__ */
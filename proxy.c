@@ -1,22 +1,98 @@
 #include "csapp.h"
+#include "cache.h"
+#include "coro.h"
+#include "disk.h"
+#include "http.h"
+#include "large.h"
+#include "origin.h"
+#include "policy.h"
+#include "proxy.h"
+#include "reactor.h"
+#include "refresh.h"
+#include "sched.h"
+#include "slab.h"
+#include "urlnorm.h"
 #include <stdio.h>
-
-/* 프록시 서버의 캐시 관련 상수 정의 */
-#define MAX_CACHE_SIZE 1049000  /* 최대 캐시 크기 (약 1MB) */
-#define MAX_OBJECT_SIZE 102400  /* 캐시 가능한 최대 객체 크기 (약 100KB) */
+#include <sys/eventfd.h>
 
 /* User-Agent 헤더 문자열 상수 */
 static const char *user_agent_hdr = 
     "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 "
     "Firefox/10.0.3\r\n";
 
+/* 클라이언트 요청에서 원 서버로 넘기지 않는 헤더: 프록시가 직접 쓰는 것,
+ * 홉 간 헤더, 그리고 응답 모양을 바꿔 팔로워와 캐시가 나눠 쓸 수 없게
+ * 만드는 범위/조건부 요청 헤더 */
+static const char *dropped_hdrs[] = {
+    "Host", "User-Agent", "Connection", "Proxy-Connection", "Keep-Alive",
+    "TE", "Trailer", "Upgrade", "Range", "If-Range", "If-Match",
+    "If-None-Match", "If-Modified-Since", "If-Unmodified-Since",
+};
+
+/* 프록시 자신에게 보내는 상태 조회 경로 (origin-form 요청) */
+#define STATS_PATH "/proxy-stats"
+
+/* 캐시 예열 경로: POST 본문의 URL 목록(한 줄에 하나)을 미리 가져옴 */
+#define WARM_PATH "/proxy-warm"
+#define WARM_MAX_BODY (1 << 20)     /* 예열 요청 본문 상한 */
+#define WARM_WORKERS 4              /* 동시에 가져올 URL 수 */
+
+/* 작업 스레드 풀: 수락한 연결을 유한 큐로 넘기면 작업 훔치기 스케줄러가
+ * 고정된 수의 스레드에 나눠 줌 */
+#define POOL_THREADS 32             /* 기본 작업 스레드 수 (-t) */
+#define POOL_QUEUE 256              /* 기본 연결 큐 깊이 (-k) */
+#define POOL_WAIT_MS 200            /* 큐가 가득 찼을 때 기다릴 시간. 넘으면 503 */
+
+/* 스케줄러 작업: 연결 fd와 관리 포트 연결인지 */
+#define TASK(fd, admin) (((fd) << 1) | (admin))
+
+/* 예열 작업: 작업 스레드들이 next를 나눠 가지며 URL을 하나씩 가져옴 */
+typedef struct {
+    char **urls;
+    int count;
+    int next;
+    int cached;                     /* 끝난 뒤 캐시에 있는 URL 수 */
+    int done_fd;                    /* 코루틴 안의 예열: 끝난 작업 스레드를 알리는 eventfd */
+    pthread_mutex_t lock;
+} warm_t;
+
+/* 코루틴 엔진에서 도우미 스레드에 맡기는 이름 풀이의 인자와 결과 */
+typedef struct {
+    char *hostname, *port;
+    struct addrinfo *addrs;
+    int rc;
+} resolve_t;
+
+/* 관리 포트. 지정하면 PURGE와 예열은 이 포트로만 받는다 */
+static char *admin_port = NULL;
+
+/* 연결을 받아 돌리는 엔진: 작업 스레드 풀(thread), 이벤트 루프(epoll, uring),
+ * 코루틴(coro) */
+static char *engine = "thread";
+
+/* 원 서버가 stale-while-revalidate를 밝히지 않은 응답에 줄 기본 기간(초) */
+static long swr_default = 0;
+
 /* 함수 프로토타입 */
-void handle_transaction(int fd);
-void send_request(int server_fd, char *method, char *path, char *hostname);
-void forward_response(int server_fd, int client_fd);
-void send_error(int fd, char *cause, char *err_num, char *short_msg, char *long_msg);
-void *thread(void *vargp);
-int parse_uri(char *uri, char *hostname, char *path, char *port);
+void handle_transaction(int fd, int admin);
+void serve_handoff(int fd, handoff_t *h);
+void purge(int fd, char *uri);
+void warm(int fd, rio_t *rio, http_req_t *req);
+void *warm_worker(void *vargp);
+void send_text(int fd, char *text);
+void send_request(int server_fd, char *method, char *path, char *hostname,
+                  http_req_t *req, cache_entry_t *stale);
+void forward_response(int server_fd, int client_fd, http_req_t *req, inflight_t *flight,
+                      cache_entry_t *stale);
+void send_stats(int fd);
+void serve(int task);
+void serve_coro(int fd);
+int submit_conn(int fd);
+int connect_origin(char *hostname, char *port);
+void resolve_job(void *arg);
+void *admin_thread(void *vargp);
+void refresh_object(refresh_job_t *job);
+void usage(char *prog);
 
 /* 
  * main - 프록시 서버의 시작점
@@ -25,62 +101,271 @@ int parse_uri(char *uri, char *hostname, char *path, char *port);
 int main(int argc, char *argv[]) {
     setbuf(stdout, NULL);  /* 디버깅을 위한 표준 출력 버퍼링 비활성화 */
 
-    int listen_fd, conn_fd, *conn_fdp;
+    int listen_fd, conn_fd, *admin_fdp;
     char hostname[MAXLINE], port[MAXLINE];
     socklen_t client_len;
     struct sockaddr_storage client_addr;
     pthread_t tid;
+    int opt, cache_shards = CACHE_DEFAULT_SHARDS, hugepages = 0;
+    int pool_threads = POOL_THREADS, pool_queue = POOL_QUEUE;
+    int reactors = sysconf(_SC_NPROCESSORS_ONLN), pin = 0;
+    char *disk_path = NULL, *large_dir = NULL;
+    size_t disk_size = DISK_DEFAULT_SIZE, large_budget = LARGE_DEFAULT_BUDGET;
 
     /* 명령행 인자 검사 */
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <port>\n", argv[0]);
-        exit(0);
+    while ((opt = getopt(argc, argv, "s:w:d:D:Hp:qL:B:Q:A:t:k:e:r:c")) != -1) {
+        switch (opt) {
+        case 's':  /* 캐시 샤드 수 */
+            cache_shards = atoi(optarg);
+            break;
+        case 'w':  /* 기본 stale-while-revalidate 기간(초) */
+            swr_default = atol(optarg);
+            break;
+        case 'd':  /* 디스크 계층 파일 */
+            disk_path = optarg;
+            break;
+        case 'D':  /* 디스크 계층 크기(바이트) */
+            disk_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'H':  /* 슬랩 아레나를 거대 페이지로 */
+            hugepages = 1;
+            break;
+        case 'p':  /* 축출 정책 */
+            if (policy_select(optarg) < 0)
+                usage(argv[0]);
+            break;
+        case 'q':  /* 캐시 키에서 질의 인자 정렬 */
+            url_sort_query = 1;
+            break;
+        case 'L':  /* 큰 객체 캐시 디렉터리 */
+            large_dir = optarg;
+            break;
+        case 'B':  /* 큰 객체 캐시 예산(바이트) */
+            large_budget = strtoul(optarg, NULL, 10);
+            break;
+        case 'Q':  /* 원 서버별 소프트 할당량: 바이트 또는 호스트=바이트 */
+            if (origin_set_quota(optarg) < 0)
+                usage(argv[0]);
+            break;
+        case 'A':  /* 관리 포트 (PURGE, 예열) */
+            admin_port = optarg;
+            break;
+        case 't':  /* 작업 스레드 수 */
+            if ((pool_threads = atoi(optarg)) < 1)
+                usage(argv[0]);
+            break;
+        case 'k':  /* 연결 큐 깊이 */
+            if ((pool_queue = atoi(optarg)) < 1)
+                usage(argv[0]);
+            break;
+        case 'e':  /* 엔진 */
+            if (strcmp(optarg, "thread") != 0 && strcmp(optarg, "epoll") != 0 &&
+                strcmp(optarg, "uring") != 0 && strcmp(optarg, "coro") != 0)
+                usage(argv[0]);
+            engine = optarg;
+            break;
+        case 'r':  /* 이벤트 엔진 스레드 수 */
+            if ((reactors = atoi(optarg)) < 1)
+                usage(argv[0]);
+            break;
+        case 'c':  /* 엔진 스레드를 CPU에 묶음 */
+            pin = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+
+    cache_init(cache_shards, hugepages);
+    if (disk_path && disk_init(disk_path, disk_size) < 0)
+        exit(1);
+    if (large_dir && large_init(large_dir, large_budget) < 0)
+        exit(1);
+    refresh_init(refresh_object);
+    sched_init(pool_threads, pool_queue, serve);
+    /* 끊긴 연결에 쓰면 EPIPE로 그 트랜잭션만 끝낸다 */
+    Signal(SIGPIPE, SIG_IGN);
+    if (admin_port) {
+        admin_fdp = Malloc(sizeof(int));
+        *admin_fdp = Open_listenfd(admin_port);
+        Pthread_create(&tid, NULL, admin_thread, admin_fdp);
     }
 
-    listen_fd = Open_listenfd(argv[1]);
+    /* 코루틴 엔진: 루프마다 자기 listen 소켓으로 받은 연결을 코루틴으로
+     * 처리. Rio가 EAGAIN을 만나면 코루틴이 멈추고 루프가 다른 연결을 돌림 */
+    if (strcmp(engine, "coro") == 0) {
+        rio_wait = coro_wait;
+        coro_start(argv[optind], reactors < 1 ? 1 : reactors, serve_coro);
+    }
 
+    /* 이벤트 엔진: 엔진 스레드마다 자기 listen 소켓으로 연결을 받아 돌리고,
+     * 작업 스레드는 넘긴 요청만 처리. uring은 io_uring 링에서 기다리며,
+     * 커널이 지원하지 않으면 epoll로 돈다 */
+    if (strcmp(engine, "thread") != 0) {
+        reactor_init(submit_conn);
+        reactor_start(argv[optind], reactors < 1 ? 1 : reactors, pin,
+                      strcmp(engine, "uring") == 0);
+    }
+
+    listen_fd = Open_listenfd(argv[optind]);
+    /* 큐가 가득 차면 잠시 기다리고, 그래도 자리가 없으면 503으로 거절 */
     while (1) {
         client_len = sizeof(client_addr);
-        conn_fdp = Malloc(sizeof(int));
-        *conn_fdp = Accept(listen_fd, (SA *) &client_addr, &client_len);
-        Pthread_create(&tid, NULL, thread, conn_fdp);
+        conn_fd = Accept(listen_fd, (SA *) &client_addr, &client_len);
+        if (sched_submit(TASK(conn_fd, 0), POOL_WAIT_MS) < 0) {
+            printf("과부하: 연결 거절\n");
+            send_error(conn_fd, "", "503", "서비스 불가",
+                       "프록시가 과부하 상태입니다. 잠시 후 다시 시도하세요");
+            Close(conn_fd);
+        }
     }
 }
 
 /*
- 스레드 루틴
-*/
-void *thread(void *vargp) {
-    int conn_fd = *((int *)vargp);
-    Pthread_detach(pthread_self());
-    Free(vargp);
-    handle_transaction(conn_fd);
+ * usage - 사용법 출력 후 종료
+ */
+void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-s cache_shards] [-w swr_seconds] [-d disk_file] "
+            "[-D disk_bytes] [-H] [-p clock|lru|slru|gdsf] [-q] [-L large_dir] "
+            "[-B large_bytes] [-Q [host=]quota_bytes]... [-A admin_port] [-t threads] "
+            "[-k queue_depth] [-e thread|epoll|uring|coro] [-r reactors] [-c] <port>\n", prog);
+    exit(0);
+}
+
+/*
+ * serve - 스케줄러 작업 하나(연결 하나)를 처리하고 닫음
+ * 이벤트 엔진이 요청을 읽은 뒤 넘긴 연결은 그 요청부터 이어서 처리한다.
+ */
+void serve(int task) {
+    int conn_fd = task >> 1;
+    handoff_t *h;
+
+    if ((h = reactor_take(conn_fd)) != NULL)
+        serve_handoff(conn_fd, h);
+    else
+        handle_transaction(conn_fd, task & 1);
     Close(conn_fd);
+}
+
+/*
+ * serve_coro - 코루틴 엔진이 연결 하나마다 코루틴 안에서 부름
+ */
+void serve_coro(int fd) {
+    handle_transaction(fd, 0);
+    Close(fd);
+}
 
+/*
+ * submit_conn - 이벤트 엔진이 넘기는 연결을 큐에 넣음 (기다리지 않음)
+ */
+int submit_conn(int fd) {
+    return sched_submit(TASK(fd, 0), 0);
+}
+
+/*
+ * admin_thread - 관리 포트의 연결을 받아 admin 연결로 스케줄러에 넘김
+ * 예열처럼 오래 걸리는 관리 요청이 작업 스레드 하나를 잡아도, 그 스레드
+ * 덱에 남은 작업은 다른 스레드가 훔쳐 간다. 관리 연결은 거절하지 않고
+ * 큐에 자리가 날 때까지 기다린다.
+ */
+void *admin_thread(void *vargp) {
+    int listen_fd = *((int *)vargp), conn_fd;
+    socklen_t client_len;
+    struct sockaddr_storage client_addr;
+
+    Pthread_detach(pthread_self());
+    Free(vargp);
+    while (1) {
+        client_len = sizeof(client_addr);
+        conn_fd = Accept(listen_fd, (SA *) &client_addr, &client_len);
+        sched_submit(TASK(conn_fd, 1), -1);
+    }
     return NULL;
 }
 
 /*
  * handle_transaction - 단일 HTTP 트랜잭션 처리
  * 클라이언트의 요청을 받아 서버로 전달하고 응답을 회신
+ * PURGE와 예열(POST WARM_PATH)은 관리 포트가 없거나 admin 연결일 때만 받는다.
  */
-void handle_transaction(int client_fd) {
-    int server_fd;
+void handle_transaction(int client_fd, int admin) {
     char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE];
-    char hostname[MAXLINE], path[MAXLINE], port[MAXLINE];
-    rio_t client_rio, server_rio;
+    int hdr_ok = 1;
+    rio_t client_rio;
+    http_req_t req;
 
     printf("\n<<<< 새로운 클라이언트 요청 >>>>\n");
 
     /* 요청 라인 읽기 */
     Rio_readinitb(&client_rio, client_fd);
-    if (!Rio_readlineb(&client_rio, buf, MAXLINE))
+    if (rio_readlineb(&client_rio, buf, MAXLINE) <= 0)
         return;
 
     printf("클라이언트 요청 라인: %s", buf);
     sscanf(buf, "%s %s %s", method, uri, version);
     printf("메소드: %s, URI: %s, 버전: %s\n", method, uri, version);
 
+    /* 요청 헤더 읽기: 너무 길면 Vary 변형을 가를 수 없으므로 캐시를 거치지 않음 */
+    http_req_init(&req);
+    while (rio_readlineb(&client_rio, buf, MAXLINE) > 0 && strcmp(buf, "\r\n") != 0)
+        if (http_req_add_line(&req, buf) < 0)
+            hdr_ok = 0;
+
+    dispatch(client_fd, &client_rio, method, uri, &req, hdr_ok, admin);
+}
+
+/*
+ * serve_handoff - 이벤트 엔진이 읽어 넘긴 요청을 블로킹 소켓으로 처리
+ * 엔진이 헤더 뒤까지 받아 둔 바이트는 rio 버퍼에 미리 채워 둔다.
+ * 진행 중 요청의 팔로워는 먼저 따라 읽고, 따라 읽지 못하면 처음부터 처리한다.
+ * 리더의 응답을 나눌 수 없었으면 캐시를 거치지 않고 직접 가져온다.
+ */
+void serve_handoff(int fd, handoff_t *h) {
+    rio_t rio;
+    origin_t *org;
+    int rc;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    Rio_readinitb(&rio, fd);
+    memcpy(rio.rio_buf, h->rest, h->rest_len);
+    rio.rio_cnt = h->rest_len;
+
+    if (h->flight) {
+        printf("진행 중인 요청을 따라 읽음: %s\n", h->flight->key);
+        org = origin_get(h->flight->key);
+        if ((rc = cache_follow(h->flight, h->req, fd)) == 1 || rc == -1) {
+            origin_count(org, 1);
+            reactor_handoff_free(h);
+            return;
+        }
+        if (rc == 0)
+            h->hdr_ok = 0;
+    }
+    dispatch(fd, &rio, h->method, h->uri, h->req, h->hdr_ok, 0);
+    reactor_handoff_free(h);
+}
+
+/*
+ * dispatch - 읽어 들인 요청을 종류에 따라 처리
+ * rio는 요청 헤더 뒤의 본문(예열 목록)을 읽을 클라이언트 버퍼이다.
+ */
+void dispatch(int client_fd, rio_t *rio, char *method, char *uri, http_req_t *req,
+              int hdr_ok, int admin) {
+    /* 관리 요청: 캐시 비우기와 예열 */
+    if (strcasecmp(method, "PURGE") == 0 ||
+        (strcasecmp(method, "POST") == 0 && strcmp(uri, WARM_PATH) == 0)) {
+        if (admin_port && !admin)
+            send_error(client_fd, method, "403", "금지됨",
+                       "관리 요청은 관리 포트로만 받습니다");
+        else if (strcasecmp(method, "PURGE") == 0)
+            purge(client_fd, uri);
+        else
+            warm(client_fd, rio, req);
+        return;
+    }
+
     /* 지원하는 메소드 검사 */
     if (strcasecmp(method, "GET") != 0 && strcasecmp(method, "HEAD") != 0) {
         send_error(client_fd, method, "501", "지원하지 않는 요청",
@@ -88,6 +373,29 @@ void handle_transaction(int client_fd) {
         return;
     }
 
+    /* 프록시 상태 조회 */
+    if (strcmp(uri, STATS_PATH) == 0) {
+        send_stats(client_fd);
+        return;
+    }
+
+    proxy_request(client_fd, method, uri, req, hdr_ok);
+}
+
+/*
+ * proxy_request - GET/HEAD 요청 하나를 캐시나 원 서버에서 가져와 응답
+ * 헤더를 다 보관하지 못한 요청(!hdr_ok)은 캐시를 거치지 않는다.
+ * uri는 파싱하며 고쳐 쓴다.
+ */
+void proxy_request(int client_fd, char *method, char *uri, http_req_t *req, int hdr_ok) {
+    int server_fd;
+    char hostname[MAXLINE], path[MAXLINE], port[MAXLINE], key[MAXLINE];
+    cache_entry_t *cached, *stale = NULL;
+    large_entry_t *large;
+    inflight_t *flight = NULL;
+    origin_t *org;
+    int is_get, leader = 0, stale_hit = 0, retried, rc;
+
     /* URI 파싱 */
     if (parse_uri(uri, hostname, path, port) < 0) {
         send_error(client_fd, uri, "400", "잘못된 요청",
@@ -95,23 +403,137 @@ void handle_transaction(int client_fd) {
         return;
     }
 
+    /* 캐시 조회: GET 요청은 캐시에 있으면 서버에 연결하지 않고 바로 응답 */
+    is_get = (strcasecmp(method, "GET") == 0) && hdr_ok &&
+             cache_make_key(key, hostname, port, path) == 0;
+    if (is_get) {
+        org = origin_get(key);
+        for (retried = 0; ; retried++) {
+            if ((cached = cache_lookup(key, req, &stale_hit)) == NULL) {
+                if ((large = large_lookup(key)) != NULL) {
+                    printf("큰 객체 캐시 적중: %s\n", key);
+                    origin_count(org, 1);
+                    large_send(large, client_fd);
+                    large_release(large);
+                    return;
+                }
+                flight = cache_fetch_begin(key, req, &cached, &leader);
+            }
+            if (cached) {
+                printf("캐시 적중%s: %s\n", stale_hit ? "(만료, 백그라운드 갱신)" : "", key);
+                origin_count(org, 1);
+                cache_send(cached, client_fd);
+                /* 만료 사본을 보냈으면 갱신을 한 번만 예약; 참조는 작업으로 넘어감 */
+                if (stale_hit && cache_claim_refresh(cached)) {
+                    if (refresh_submit(hostname, port, path, key, req, cached) == 0)
+                        return;
+                    cache_unclaim_refresh(cached);
+                }
+                cache_release(cached);
+                return;
+            }
+            /* 같은 키를 이미 가져오는 스레드가 있으면 그 응답을 따라 읽음 */
+            if (!flight || leader)
+                break;
+            printf("진행 중인 요청을 따라 읽음: %s\n", key);
+            if ((rc = cache_follow(flight, req, client_fd)) == 1 || rc == -1) {
+                origin_count(org, 1);
+                return;
+            }
+            flight = NULL;
+            /* 리더가 객체 없이 끝났거나(재검증, 큰 객체, 원 서버 오류, 잘린
+             * 응답) 다른 변형을 받았으면 캐시를 다시 보고, 없으면 기다리던
+             * 팔로워 중 하나만 새 리더가 된다. 새 리더도 실패하면 줄줄이
+             * 기다리지 않도록 한 번만 다시 줄 선다. 나눌 수 없는 응답이었으면
+             * 직접 가져옴 */
+            if (rc != 2 || retried)
+                break;
+        }
+        /* 리더는 만료된 사본이 있으면 조건부 요청으로 재검증 */
+        if (flight)
+            stale = cache_lookup_stale(key, req);
+        origin_count(org, 0);
+    }
+
     /* 서버 연결 */
     printf("서버 연결 시도: %s:%s\n", hostname, port);
-    server_fd = Open_clientfd(hostname, port);
+    server_fd = connect_origin(hostname, port);
     if (server_fd < 0) {
         send_error(client_fd, hostname, "404", "찾을 수 없음",
                    "서버에 연결할 수 없습니다");
+        if (flight)
+            cache_fetch_end(flight);
+        if (stale)
+            cache_release(stale);
         return;
     }
 
     /* 서버와의 통신 처리 */
-    Rio_readinitb(&server_rio, server_fd);
-    send_request(server_fd, method, path, hostname);
-    forward_response(server_fd, client_fd);
+    send_request(server_fd, method, path, hostname, req, stale);
+    forward_response(server_fd, client_fd, req, flight, stale);
+    if (flight)
+        cache_fetch_end(flight);
+    if (stale)
+        cache_release(stale);
 
     Close(server_fd);
 }
 
+/*
+ * connect_origin - 원 서버에 연결
+ * 코루틴 안에서는 논블로킹 connect를 걸고 끝날 때까지 rio_wait 훅으로
+ * 코루틴만 멈춘다. 주소는 숫자면 바로 풀고, 이름이면 getaddrinfo만
+ * 도우미 스레드에 맡긴다(이벤트 엔진의 풀이 스레드와 같다). 받은 소켓은
+ * 논블로킹이라 Rio가 EAGAIN에서 코루틴을 멈춘다.
+ */
+int connect_origin(char *hostname, char *port) {
+    struct addrinfo hints, *p;
+    socklen_t len = sizeof(int);
+    resolve_t r;
+    int fd = -1, err;
+
+    if (!coro_running())
+        return open_clientfd(hostname, port);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_NUMERICHOST;
+    r.hostname = hostname;
+    r.port = port;
+    if ((r.rc = getaddrinfo(hostname, port, &hints, &r.addrs)) != 0)
+        coro_offload(resolve_job, &r);
+    if (r.rc != 0)
+        return -1;
+    for (p = r.addrs; p; p = p->ai_next) {
+        if ((fd = socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         p->ai_protocol)) < 0)
+            continue;
+        err = 0;
+        if (connect(fd, p->ai_addr, p->ai_addrlen) < 0 &&
+            (errno != EINPROGRESS || rio_wait(fd, 1) < 0 ||
+             getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0))
+            err = -1;
+        if (err == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(r.addrs);
+    return fd;
+}
+
+void resolve_job(void *arg) {
+    resolve_t *r = arg;
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+    if ((r->rc = getaddrinfo(r->hostname, r->port, &hints, &r->addrs)) != 0)
+        fprintf(stderr, "getaddrinfo failed (%s:%s): %s\n", r->hostname, r->port,
+                gai_strerror(r->rc));
+}
+
 /*
  * parse_uri - URI를 호스트명, 경로, 포트로 파싱
  * 반환값: 성공시 0, 실패시 -1
@@ -149,67 +571,451 @@ int parse_uri(char *uri, char *hostname, char *path, char *port) {
 
 /*
  * send_request - 서버에 HTTP 요청 전송
- * 필요한 모든 HTTP 헤더를 포함하여 요청
  */
-void send_request(int server_fd, char *method, char *path, char *hostname) {
-    char buf[MAXLINE];
+void send_request(int server_fd, char *method, char *path, char *hostname,
+                  http_req_t *req, cache_entry_t *stale) {
+    size_t len;
+    char *buf = format_request(method, path, hostname, req, stale, &len);
 
-    printf("\n<<<< 서버로 프록시 요청 전송 >>>>\n");
+    printf("\n<<<< 서버로 프록시 요청 전송 >>>>\n%s", buf);
+    if (rio_writen(server_fd, buf, len) != len)
+        fprintf(stderr, "원 서버 요청 전송 실패: %s\n", strerror(errno));
+    Free(buf);
+}
 
-    /* 요청 라인 전송 */
-    sprintf(buf, "%s %s HTTP/1.0\r\n", method, path);
-    printf("요청 라인: %s", buf);
-    Rio_writen(server_fd, buf, strlen(buf));
+/*
+ * format_request - 원 서버로 보낼 요청 전체를 Malloc한 버퍼에 만듦
+ * 필요한 모든 HTTP 헤더를 포함하며, 길이는 *lenp에 둔다.
+ * 클라이언트 헤더 중 dropped_hdrs가 아닌 것(Accept-Encoding 등)은 그대로
+ * 넘겨 원 서버가 Vary에 맞는 변형을 고르게 한다.
+ * stale이 주어지면 그 검증자로 If-None-Match / If-Modified-Since를 붙여
+ * 바뀌지 않은 객체는 본문 없이 304로 받는다.
+ */
+char *format_request(char *method, char *path, char *hostname, http_req_t *req,
+                     cache_entry_t *stale, size_t *lenp) {
+    size_t size = strlen(method) + strlen(path) + strlen(hostname) + req->len + MAXLINE;
+    char *buf = Malloc(size), date[64], *line, *next;
+    size_t n;
 
-    /* 헤더 전송 */
-    sprintf(buf, "Host: %s\r\n", hostname);
-    printf("<헤더>\nHost: %s", buf);
-    Rio_writen(server_fd, buf, strlen(buf));
+    /* 요청 라인과 프록시가 정하는 헤더 */
+    n = snprintf(buf, size, "%s %s HTTP/1.0\r\nHost: %s\r\n%sConnection: close\r\n",
+                 method, path, hostname, user_agent_hdr);
 
-    sprintf(buf, "%s", user_agent_hdr);
-    printf("User-Agent: %s", buf);
-    Rio_writen(server_fd, buf, strlen(buf));
+    /* 클라이언트 헤더 */
+    for (line = req->headers; line < req->headers + req->len; line = next) {
+        next = line + strcspn(line, "\n");
+        next += (*next == '\n');
+        if (forwardable(line)) {
+            memcpy(buf + n, line, next - line);
+            n += next - line;
+        }
+    }
 
-    sprintf(buf, "Connection: close\r\n");
-    printf("Connection: %s", buf);
-    Rio_writen(server_fd, buf, strlen(buf));
+    /* 조건부 요청 헤더 */
+    if (stale && cache_etag(stale))
+        n += snprintf(buf + n, size - n, "If-None-Match: %s\r\n", cache_etag(stale));
+    if (stale && stale->last_modified > 0) {
+        http_format_date(date, sizeof(date), stale->last_modified);
+        n += snprintf(buf + n, size - n, "If-Modified-Since: %s\r\n", date);
+    }
 
-    sprintf(buf, "Proxy-Connection: close\r\n\r\n");
-    printf("Proxy-Connection: %s", buf);
-    Rio_writen(server_fd, buf, strlen(buf));
+    n += snprintf(buf + n, size - n, "Proxy-Connection: close\r\n\r\n");
+    *lenp = n;
+    return buf;
 }
 
 /*
  * forward_response - 서버로부터 받은 응답을 클라이언트에게 전달
  * 헤더와 본문을 모두 전송하며 진행 상황을 출력
+ * flight가 주어지면 클라이언트에 쓴 바이트를 같은 루프에서 캐시 버퍼에도
+ * 붙인다. 헤더 끝에서 Cache-Control 등으로 신선도를 계산해 캐시 여부와
+ * 팔로워에게 나눌지를 정한다(store_begin).
+ * 조건부 요청(stale)에 304가 오면 304의 헤더를 캐시된 사본에 합치고
+ * 신선도를 갱신한 뒤(cache_revalidate) 그 사본을 클라이언트에 보낸다.
+ * 캐시할 수 있지만 MAX_OBJECT_SIZE를 넘거나 길이를 모르는 응답은 큰 객체
+ * 계층(large.c)의 임시 파일에도 쓰고, 끝까지 받았을 때만 commit한다.
+ * 길이를 모르던 응답이 메모리 캐시에 들어갈 만큼 작았으면 파일은 버린다.
+ * 클라이언트가 끊으면 이 트랜잭션만 끝난다. 캐시나 팔로워를 위해 채우던
+ * 응답이면 원 서버에서 끝까지 받는다.
  */
-void forward_response(int server_fd, int client_fd) {
-    char buf[MAXLINE];
+void forward_response(int server_fd, int client_fd, http_req_t *req, inflight_t *flight,
+                      cache_entry_t *stale) {
+    char buf[MAXLINE], head[MAXBUF];
     rio_t rio;
     ssize_t n;
-    int total_bytes = 0, header_end = 0;
+    int total_bytes = 0, header_end = 0, head_len = 0, hdr_bytes;
+    int filling = (flight != NULL), client_ok = 1;
+    large_writer_t *large = NULL;
+    http_resp_t resp;
+    cache_meta_t meta;
+    cache_entry_t *fresh;
 
     printf("\n<<<< 서버 응답 수신 >>>>\n");
     Rio_readinitb(&rio, server_fd);
+    http_resp_init(&resp);
+
+    /* 상태줄: 재검증 성공이면 원 서버 헤더는 클라이언트에 보내지 않음 */
+    if ((n = rio_readlineb(&rio, buf, MAXLINE)) <= 0)
+        return;
+    http_resp_parse_line(&resp, buf);
+    if (stale && resp.status == 304) {
+        printf("재검증 성공(304): 캐시된 사본 사용\n");
+        do {
+            if (head_len != 0)      /* 상태줄은 이미 해석함 */
+                http_resp_parse_line(&resp, buf);
+            if (head_len >= 0 && head_len + n <= sizeof(head)) {
+                memcpy(head + head_len, buf, n);
+                head_len += n;
+            } else {
+                head_len = -1;      /* 헤더가 너무 길면 신선도만 갱신 */
+            }
+        } while (strcmp(buf, "\r\n") != 0 && (n = rio_readlineb(&rio, buf, MAXLINE)) > 0);
+        make_meta(&resp, req, &meta, time(NULL));
+        fresh = cache_revalidate(stale, &meta, head_len > 0 ? head : NULL, head_len);
+        if (flight)
+            cache_fill_abort(flight);  /* 팔로워는 갱신된 캐시에서 읽음 */
+        cache_send(fresh, client_fd);
+        cache_release(fresh);
+        return;
+    }
 
     /* 헤더 전달 */
-    while ((n = Rio_readlineb(&rio, buf, MAXLINE)) != 0) {
+    do {
         printf("수신: %s", buf);
-        Rio_writen(client_fd, buf, n);
+        if (client_ok && rio_writen(client_fd, buf, n) != n)
+            client_ok = 0;
+        if (total_bytes > 0)
+            http_resp_parse_line(&resp, buf);
+        if (filling && cache_fill_append(flight, buf, n) < 0)
+            filling = 0;
+        if (head_len >= 0 && head_len + n <= sizeof(head)) {
+            memcpy(head + head_len, buf, n);
+            head_len += n;
+        } else {
+            head_len = -1;          /* 헤더가 너무 길면 큰 객체로 받지 않음 */
+        }
         total_bytes += n;
 
         if (strcmp(buf, "\r\n") == 0) {
             header_end = 1;
             break;
         }
-    }
+    } while ((n = rio_readlineb(&rio, buf, MAXLINE)) > 0);
+    hdr_bytes = total_bytes;
+
+    /* 헤더만 보고 캐시 여부 결정 */
+    if (filling)
+        large = store_begin(&resp, req, flight, header_end, hdr_bytes, head, head_len,
+                            &meta, &filling);
 
     /* 본문 전달 */
-    while ((n = Rio_readlineb(&rio, buf, MAXLINE)) != 0) {
-        Rio_writen(client_fd, buf, n);
+    while ((client_ok || filling || large) && (n = rio_readlineb(&rio, buf, MAXLINE)) > 0) {
+        if (client_ok && rio_writen(client_fd, buf, n) != n)
+            client_ok = 0;
+        if (filling && cache_fill_append(flight, buf, n) < 0)
+            filling = 0;
+        if (large)
+            large_append(large, buf, n);
         total_bytes += n;
     }
     printf("<<<< 응답 전송 완료 >>>>\r\n");
+
+    store_end(flight, large, &resp, total_bytes - hdr_bytes, filling, meta.expires);
+}
+
+/*
+ * store_begin - 응답 헤더를 다 받은 뒤 캐시 여부를 정함 (채우는 리더만)
+ * 캐시할 수 있으면 만료 시각과 함께 팔로워에게 연다. 저장할 수 없어도
+ * 다른 클라이언트에게 보내도 되는 응답(no-cache, 200이 아님 등)이면
+ * 저장하지 않고 팔로워에게만 연다. 그 밖에는 채우기를 중단하고 *fillingp를
+ * 0으로 둔다. 캐시할 수 있지만 메모리 캐시에 못 넣는 응답이면 큰 객체
+ * writer를 만들어 head를 먼저 써 두고 반환하며, 팔로워는 리더가 끝난 뒤
+ * 그 계층에서 읽는다. 어디에도 남지 않고 나눌 수도 없는 응답이면 팔로워가
+ * 곧바로 각자 가져가게 한다(cache_fill_pass).
+ * hdr_bytes는 받은 헤더 바이트, head_len이 -1이면 헤더가 head에 다 담기지
+ * 않은 것이다.
+ */
+large_writer_t *store_begin(http_resp_t *resp, http_req_t *req, inflight_t *flight,
+                            int header_end, int hdr_bytes, char *head, int head_len,
+                            cache_meta_t *meta, int *fillingp) {
+    large_writer_t *large = NULL;
+    time_t now = time(NULL);
+    int storable, fits;
+
+    make_meta(resp, req, meta, now);
+    storable = header_end && http_resp_cacheable(resp) && meta->expires > now;
+    fits = resp->content_length < 0 || hdr_bytes + resp->content_length <= MAX_OBJECT_SIZE;
+    if (storable && fits)
+        cache_fill_open(flight, meta);
+    else if (header_end && fits && http_resp_shareable(resp))
+        cache_fill_share(flight, meta);
+    else
+        *fillingp = 0;
+    if (storable && (!*fillingp || resp->content_length < 0) && !resp->vary[0] &&
+        head_len > 0 && (large = large_begin(flight->key)) != NULL)
+        large_append(large, head, head_len);
+    if (!*fillingp) {
+        if (!header_end || large)
+            cache_fill_abort(flight);
+        else
+            cache_fill_pass(flight);
+    }
+    return large;
+}
+
+/*
+ * store_end - 응답을 다 받은 뒤 캐시 채우기와 큰 객체 writer를 정리
+ * 원 서버가 Content-Length만큼 보내기 전에 닫은 응답은 어느 계층에도
+ * 남기지 않는다. 채우던 것은 cache_fetch_end 전에 중단해 잘린 객체가
+ * 캐시되지 않게 한다. 길이를 모르던 응답이 메모리 캐시에 들어갈 만큼
+ * 작았으면(filling) 파일은 버린다.
+ */
+void store_end(inflight_t *flight, large_writer_t *large, http_resp_t *resp,
+               long body_bytes, int filling, time_t expires) {
+    int truncated = resp->content_length >= 0 && body_bytes != resp->content_length;
+
+    if (filling && truncated)
+        cache_fill_abort(flight);
+    if (!large)
+        return;
+    if (resp->content_length >= 0 ? !truncated : !filling)
+        large_commit(large, expires);
+    else
+        large_abort(large);
+}
+
+/*
+ * make_meta - 해석한 응답 헤더로 캐시 객체의 신선도와 검증자를 채움
+ * 응답에 Vary가 있으면 req의 해당 헤더 값으로 변형의 보조 해시를 만든다.
+ */
+void make_meta(http_resp_t *resp, http_req_t *req, cache_meta_t *meta, time_t now) {
+    meta->expires = http_resp_expiry(resp, now);
+    meta->swr_until = meta->expires + (resp->swr >= 0 ? resp->swr : swr_default);
+    meta->last_modified = resp->last_modified;
+    meta->etag = resp->etag[0] ? resp->etag : NULL;
+    meta->vary = resp->vary[0] ? resp->vary : NULL;
+    meta->vhash = meta->vary ? http_vary_hash(req, meta->vary) : 0;
+}
+
+/*
+ * forwardable - 클라이언트 요청 헤더 줄을 원 서버로 넘길지 판정
+ */
+int forwardable(char *line) {
+    size_t i, len;
+
+    for (i = 0; i < sizeof(dropped_hdrs) / sizeof(dropped_hdrs[0]); i++) {
+        len = strlen(dropped_hdrs[i]);
+        if (strncasecmp(line, dropped_hdrs[i], len) == 0 && line[len] == ':')
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * refresh_object - 갱신 스레드에서 만료 객체를 원 서버에서 다시 가져옴
+ * 검증자가 있으면 조건부 요청을 보내 304면 헤더와 신선도만 갱신하고, 새 응답이
+ * 오면 전체를 버퍼에 모아 캐시의 객체를 한 번에 교체한다.
+ * 갱신 스레드는 클라이언트가 없으므로 읽기/쓰기 오류에도 프록시를 끝내지
+ * 않도록 대문자 래퍼 대신 rio_* 를 쓴다. 오류가 나거나 본문이
+ * Content-Length보다 짧으면 멀쩡한 만료 사본을 그대로 두고 갱신 예약을
+ * 풀어 다음 적중이 다시 시도하게 한다.
+ */
+void refresh_object(refresh_job_t *job) {
+    int server_fd, header_end = 0, failed = 0;
+    char buf[MAXLINE], *object, *request;
+    size_t total = 0, hdr_bytes = 0, len;
+    ssize_t n;
+    rio_t rio;
+    http_resp_t resp;
+    cache_meta_t meta;
+    time_t now;
+
+    printf("백그라운드 갱신: %s\n", job->key);
+    if ((server_fd = open_clientfd(job->hostname, job->port)) < 0) {
+        cache_unclaim_refresh(job->stale);
+        return;
+    }
+    request = format_request("GET", job->path, job->hostname, job->req, job->stale, &len);
+    printf("\n<<<< 서버로 프록시 요청 전송 >>>>\n%s", request);
+    failed = (rio_writen(server_fd, request, len) != len);
+    Free(request);
+
+    rio_readinitb(&rio, server_fd);
+    http_resp_init(&resp);
+    object = Malloc(MAX_OBJECT_SIZE);
+    while (!failed && (n = rio_readlineb(&rio, buf, MAXLINE)) != 0) {
+        if (n < 0) {
+            failed = 1;
+            break;
+        }
+        if (!header_end) {
+            http_resp_parse_line(&resp, buf);
+            header_end = (strcmp(buf, "\r\n") == 0);
+            hdr_bytes = total + n;
+            if (resp.status == 304 && header_end)
+                break;
+        }
+        if (total + n > MAX_OBJECT_SIZE) {
+            total = MAX_OBJECT_SIZE + 1;
+            break;
+        }
+        memcpy(object + total, buf, n);
+        total += n;
+    }
+    Close(server_fd);
+    if (resp.status != 304 && resp.content_length >= 0 && total <= MAX_OBJECT_SIZE &&
+        total - hdr_bytes != resp.content_length)
+        failed = 1;                 /* 원 서버가 본문 도중에 닫음 */
+
+    now = time(NULL);
+    make_meta(&resp, job->req, &meta, now);
+    if (failed || !header_end)
+        cache_unclaim_refresh(job->stale);
+    else if (resp.status == 304)
+        cache_release(cache_revalidate(job->stale, &meta, object, total));
+    else if (http_resp_cacheable(&resp) && meta.expires > now && total <= MAX_OBJECT_SIZE)
+        cache_insert(job->key, object, total, &meta);
+    else
+        cache_unclaim_refresh(job->stale);
+    Free(object);
+}
+
+/*
+ * purge - PURGE 요청: URI의 캐시 키를 모든 계층에서 지움
+ * URI가 '*'로 끝나면 그 앞까지로 만든 키(호스트[:포트]/경로)로 시작하는
+ * 모든 객체를 지운다. http://host/img/ 뒤에 '*'를 붙이면 그 경로 아래를,
+ * http://host/ 뒤에 붙이면 호스트 전체를 지운다.
+ * 디스크를 먼저 비워 메모리 미스가 지운 사본을 다시 올리지 않게 한다.
+ */
+void purge(int fd, char *uri) {
+    char hostname[MAXLINE], path[MAXLINE], port[MAXLINE], key[MAXLINE], text[MAXLINE * 2];
+    size_t len = strlen(uri);
+    int prefix = 0, disk, mem, big;
+
+    if (len > 0 && uri[len - 1] == '*') {
+        uri[len - 1] = '\0';
+        prefix = 1;
+    }
+    if (parse_uri(uri, hostname, path, port) < 0 ||
+        cache_make_key(key, hostname, port, path) < 0) {
+        send_error(fd, uri, "400", "잘못된 요청", "프록시가 URI를 파싱할 수 없습니다");
+        return;
+    }
+    disk = disk_purge(key, prefix);
+    mem = cache_purge(key, prefix);
+    big = large_purge(key, prefix);
+    printf("캐시 비움: %s%s (메모리 %d, 디스크 %d, 큰 객체 %d)\n",
+           key, prefix ? "*" : "", mem, disk, big);
+    snprintf(text, sizeof(text), "purged %s%s: memory %d, disk %d, large %d\n",
+             key, prefix ? "*" : "", mem, disk, big);
+    send_text(fd, text);
+}
+
+/*
+ * warm - 예열 요청: 본문의 URL 목록(공백이나 줄바꿈으로 구분)을 최대
+ * WARM_WORKERS개 스레드로 나눠 가져와 캐시에 넣고, 끝나면 요약을 응답
+ * 코루틴 안에서는 작업 스레드가 끝날 때마다 eventfd에 알리게 하고 그것을
+ * rio_wait 훅으로 기다려 루프를 막지 않는다.
+ */
+void warm(int fd, rio_t *rio, http_req_t *req) {
+    char len_buf[32], *body, *url, *save, text[MAXLINE];
+    pthread_t tids[WARM_WORKERS];
+    uint64_t count;
+    long len;
+    int i, cap = 0, workers, done;
+    warm_t w;
+
+    if (http_req_get(req, "Content-Length", len_buf, sizeof(len_buf)) < 0 ||
+        (len = atol(len_buf)) <= 0 || len > WARM_MAX_BODY) {
+        send_error(fd, WARM_PATH, "400", "잘못된 요청",
+                   "예열 목록은 Content-Length와 함께 1MB까지 받습니다");
+        return;
+    }
+    body = Malloc(len + 1);
+    if (rio_readnb(rio, body, len) != len) {
+        Free(body);
+        return;
+    }
+    body[len] = '\0';
+
+    w.urls = NULL;
+    w.count = w.next = w.cached = 0;
+    for (url = strtok_r(body, " \t\r\n", &save); url; url = strtok_r(NULL, " \t\r\n", &save)) {
+        if (w.count == cap) {
+            cap = cap ? cap * 2 : 64;
+            w.urls = Realloc(w.urls, cap * sizeof(char *));
+        }
+        w.urls[w.count++] = url;
+    }
+
+    pthread_mutex_init(&w.lock, NULL);
+    workers = w.count < WARM_WORKERS ? w.count : WARM_WORKERS;
+    w.done_fd = coro_running() ? eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) : -1;
+    for (i = 0; i < workers; i++)
+        Pthread_create(&tids[i], NULL, warm_worker, &w);
+    /* 코루틴 안이면 작업 스레드가 다 끝날 때까지 코루틴만 멈춤 */
+    for (done = 0; w.done_fd >= 0 && done < workers && rio_wait(w.done_fd, 0) == 0; )
+        if (read(w.done_fd, &count, sizeof(count)) == sizeof(count))
+            done += count;
+    for (i = 0; i < workers; i++)
+        Pthread_join(tids[i], NULL);
+    if (w.done_fd >= 0)
+        close(w.done_fd);
+    pthread_mutex_destroy(&w.lock);
+
+    printf("캐시 예열: URL %d개 중 %d개 캐시됨\n", w.count, w.cached);
+    snprintf(text, sizeof(text), "warmed %d urls: %d cached\n", w.count, w.cached);
+    send_text(fd, text);
+    if (w.urls)
+        Free(w.urls);
+    Free(body);
+}
+
+/*
+ * warm_worker - 예열 작업 스레드: 다음 URL을 가져와 클라이언트 대신
+ * /dev/null로 응답을 받고, 끝난 뒤 캐시에 들어갔는지 센다
+ */
+void *warm_worker(void *vargp) {
+    warm_t *w = vargp;
+    char uri[MAXLINE], hostname[MAXLINE], path[MAXLINE], port[MAXLINE], key[MAXLINE];
+    cache_entry_t *cached;
+    large_entry_t *large;
+    http_req_t req;
+    uint64_t one = 1;
+    int i, fd = Open("/dev/null", O_WRONLY, 0);
+
+    http_req_init(&req);
+    while (1) {
+        pthread_mutex_lock(&w->lock);
+        i = w->next++;
+        pthread_mutex_unlock(&w->lock);
+        if (i >= w->count)
+            break;
+        if (strlen(w->urls[i]) >= MAXLINE)
+            continue;
+
+        strcpy(uri, w->urls[i]);
+        proxy_request(fd, "GET", uri, &req, 1);
+
+        strcpy(uri, w->urls[i]);
+        if (parse_uri(uri, hostname, path, port) < 0 ||
+            cache_make_key(key, hostname, port, path) < 0)
+            continue;
+        if ((cached = cache_lookup(key, &req, NULL)) != NULL) {
+            cache_release(cached);
+        } else if ((large = large_lookup(key)) != NULL) {
+            large_release(large);
+        } else {
+            continue;
+        }
+        pthread_mutex_lock(&w->lock);
+        w->cached++;
+        pthread_mutex_unlock(&w->lock);
+    }
+    Close(fd);
+    if (w->done_fd >= 0 && write(w->done_fd, &one, sizeof(one)) < 0)
+        fprintf(stderr, "eventfd write error: %s\n", strerror(errno));
+    return NULL;
 }
 
 /*
@@ -217,23 +1023,60 @@ void forward_response(int server_fd, int client_fd) {
  * HTML 형식의 에러 페이지 생성 및 전송
  */
 void send_error(int fd, char *cause, char *err_num, char *short_msg, char *long_msg) {
-    char buf[MAXLINE], body[MAXBUF];
+    char buf[MAXLINE + MAXBUF];
+    size_t n = format_error(buf, sizeof(buf), cause, err_num, short_msg, long_msg);
+
+    if (rio_writen(fd, buf, n) != n)
+        fprintf(stderr, "에러 응답 전송 실패: %s\n", strerror(errno));
+}
+
+/*
+ * format_error - 에러 응답(헤더와 HTML 본문)을 buf에 만들고 길이를 반환
+ */
+size_t format_error(char *buf, size_t size, char *cause, char *err_num, char *short_msg,
+                    char *long_msg) {
+    char body[MAXBUF];
+    size_t len, n;
 
     /* 응답 본문 생성 */
-    sprintf(body, "<html><title>프록시 오류</title>");
-    sprintf(body, "%s<body bgcolor=""ffffff"">\r\n", body);
-    sprintf(body, "%s%s: %s\r\n", body, err_num, short_msg);
-    sprintf(body, "%s<p>%s: %s\r\n", body, long_msg, cause);
-    sprintf(body, "%s<hr><em>프록시 웹 서버</em>\r\n", body);
-
-    /* 응답 헤더 전송 */
-    sprintf(buf, "HTTP/1.0 %s %s\r\n", err_num, short_msg);
-    Rio_writen(fd, buf, strlen(buf));
-    sprintf(buf, "Content-type: text/html\r\n");
-    Rio_writen(fd, buf, strlen(buf));
-    sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-    Rio_writen(fd, buf, strlen(buf));
-
-    /* 응답 본문 전송 */
-    Rio_writen(fd, body, strlen(body));
+    len = snprintf(body, sizeof(body), "<html><title>프록시 오류</title>"
+                   "<body bgcolor=""ffffff"">\r\n%s: %s\r\n<p>%s: %s\r\n"
+                   "<hr><em>프록시 웹 서버</em>\r\n", err_num, short_msg, long_msg, cause);
+    if (len >= sizeof(body))
+        len = sizeof(body) - 1;
+
+    /* 응답 헤더 */
+    n = snprintf(buf, size, "HTTP/1.0 %s %s\r\nContent-type: text/html\r\n"
+                 "Content-length: %d\r\n\r\n%s", err_num, short_msg, (int)len, body);
+    return n < size ? n : size - 1;
+}
+
+/*
+ * send_text - 관리 요청의 결과를 200 text/plain으로 응답
+ */
+void send_text(int fd, char *text) {
+    char buf[MAXLINE];
+
+    sprintf(buf, "HTTP/1.0 200 OK\r\nContent-type: text/plain; charset=utf-8\r\n"
+            "Content-length: %d\r\n\r\n", (int)strlen(text));
+    if (rio_writen(fd, buf, strlen(buf)) == strlen(buf))
+        rio_writen(fd, text, strlen(text));
+}
+
+/*
+ * send_stats - 캐시 메모리 사용 현황(슬랩 클래스별)과 원 서버별 점유량,
+ * 적중률을 text/plain으로 응답
+ * 본문 길이를 미리 모르므로 연결 종료로 끝을 알린다.
+ */
+void send_stats(int fd) {
+    char *hdr = "HTTP/1.0 200 OK\r\nContent-type: text/plain; charset=utf-8\r\n"
+                "Connection: close\r\n\r\n";
+
+    if (rio_writen(fd, hdr, strlen(hdr)) != strlen(hdr))
+        return;
+    slab_stats(fd);
+    origin_stats(fd);
+    sched_stats(fd);
+    reactor_stats(fd);
+    coro_stats(fd);
 }
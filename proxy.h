@@ -0,0 +1,29 @@
+/*
+ * proxy.h - 이벤트 엔진(reactor.c)과 함께 쓰는 proxy.c의 요청 처리 함수
+ */
+#ifndef __PROXY_H__
+#define __PROXY_H__
+
+#include "csapp.h"
+#include "cache.h"
+#include "http.h"
+#include "large.h"
+
+void dispatch(int client_fd, rio_t *rio, char *method, char *uri, http_req_t *req,
+              int hdr_ok, int admin);
+void proxy_request(int client_fd, char *method, char *uri, http_req_t *req, int hdr_ok);
+int parse_uri(char *uri, char *hostname, char *path, char *port);
+char *format_request(char *method, char *path, char *hostname, http_req_t *req,
+                     cache_entry_t *stale, size_t *lenp);
+void make_meta(http_resp_t *resp, http_req_t *req, cache_meta_t *meta, time_t now);
+int forwardable(char *line);
+large_writer_t *store_begin(http_resp_t *resp, http_req_t *req, inflight_t *flight,
+                            int header_end, int hdr_bytes, char *head, int head_len,
+                            cache_meta_t *meta, int *fillingp);
+void store_end(inflight_t *flight, large_writer_t *large, http_resp_t *resp,
+               long body_bytes, int filling, time_t expires);
+void send_error(int fd, char *cause, char *err_num, char *short_msg, char *long_msg);
+size_t format_error(char *buf, size_t size, char *cause, char *err_num, char *short_msg,
+                    char *long_msg);
+
+#endif /* __PROXY_H__ */
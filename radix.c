@@ -0,0 +1,205 @@
+/*
+ * radix.c - 캐시 키의 접두사 검색용 기수 트리
+ *
+ * 호스트나 경로 접두사로 캐시를 비울 때 모든 객체를 훑지 않도록, 캐시
+ * 계층마다 키를 압축 트라이에도 넣어 둔다. 노드는 공통 접두사를 한
+ * label로 묶으며, 같은 키가 여러 번 들어오면(Vary 변형) count만 늘린다.
+ * 접두사 검색은 접두사 길이만큼 내려간 뒤 그 아래 부분 트리만 돌아
+ * 키를 복사해 돌려주므로, 호출자는 그 키로 자기 색인을 고칠 수 있다.
+ *
+ * 락은 없다. 호출자가 자기 색인을 보호하는 락 안에서 부른다.
+ */
+#include "radix.h"
+#include "csapp.h"
+
+/* radix_collect가 모으는 키 목록 */
+typedef struct {
+    char **keys;
+    int n, cap;
+} keylist_t;
+
+static radix_node_t *new_node(char *label, size_t len, int count);
+static radix_node_t *find_child(radix_node_t *n, char c);
+static void split(radix_node_t *c, size_t at);
+static int remove_at(radix_node_t *n, char *key, size_t len, int root);
+static void merge(radix_node_t *n);
+static void walk_node(radix_node_t *n, char *buf, size_t blen, keylist_t *list);
+
+void radix_init(radix_t *r) {
+    memset(r, 0, sizeof(*r));
+}
+
+/*
+ * radix_insert - 키를 넣거나 이미 있으면 count를 하나 늘림
+ */
+void radix_insert(radix_t *r, char *key, size_t len) {
+    radix_node_t *n = &r->root, *c;
+    size_t i;
+
+    for (;;) {
+        if (len == 0) {
+            n->count++;
+            return;
+        }
+        if ((c = find_child(n, key[0])) == NULL) {
+            c = new_node(key, len, 1);
+            c->sibling = n->child;
+            n->child = c;
+            return;
+        }
+        for (i = 0; i < c->len && i < len && c->label[i] == key[i]; i++)
+            ;
+        if (i < c->len)
+            split(c, i);
+        n = c;
+        key += i;
+        len -= i;
+    }
+}
+
+/*
+ * radix_remove - 키의 count를 하나 줄이고, 0이 되면 노드를 지우거나
+ * 자식 하나와 합쳐 트리를 압축된 채로 유지
+ */
+void radix_remove(radix_t *r, char *key, size_t len) {
+    remove_at(&r->root, key, len, 1);
+}
+
+/*
+ * radix_collect - prefix로 시작하는 키를 모두 복사해 *keysp에 둠
+ * 키 수를 반환하며, 1개 이상이면 호출자가 radix_free_keys로 푼다.
+ */
+int radix_collect(radix_t *r, char *prefix, char ***keysp) {
+    char buf[MAXLINE];
+    size_t blen = 0, plen = strlen(prefix), i;
+    radix_node_t *n = &r->root, *c;
+    keylist_t list = { NULL, 0, 0 };
+
+    *keysp = NULL;
+    while (plen > 0) {
+        if ((c = find_child(n, prefix[0])) == NULL)
+            return 0;
+        for (i = 0; i < c->len && i < plen && c->label[i] == prefix[i]; i++)
+            ;
+        if (i < c->len && i < plen)
+            return 0;
+        if (blen + c->len >= sizeof(buf))
+            return 0;
+        memcpy(buf + blen, c->label, c->len);
+        blen += c->len;
+        n = c;
+        prefix += i;
+        plen -= i;
+    }
+    walk_node(n, buf, blen, &list);
+    *keysp = list.keys;
+    return list.n;
+}
+
+void radix_free_keys(char **keys, int n) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        Free(keys[i]);
+    if (keys)
+        Free(keys);
+}
+
+static radix_node_t *new_node(char *label, size_t len, int count) {
+    radix_node_t *n = Calloc(1, sizeof(radix_node_t));
+
+    n->label = Malloc(len);
+    memcpy(n->label, label, len);
+    n->len = len;
+    n->count = count;
+    return n;
+}
+
+static radix_node_t *find_child(radix_node_t *n, char c) {
+    radix_node_t *x;
+
+    for (x = n->child; x && x->label[0] != c; x = x->sibling)
+        ;
+    return x;
+}
+
+/*
+ * split - c의 label을 at에서 나눠 뒤쪽을 c의 유일한 자식으로 내림
+ */
+static void split(radix_node_t *c, size_t at) {
+    radix_node_t *d = new_node(c->label + at, c->len - at, c->count);
+
+    d->child = c->child;
+    c->child = d;
+    c->len = at;                    /* label 버퍼는 그대로 앞부분만 쓴다 */
+    c->count = 0;
+}
+
+/*
+ * remove_at - n 아래에서 남은 키를 지움. n을 부모에서 떼어야 하면 1
+ */
+static int remove_at(radix_node_t *n, char *key, size_t len, int root) {
+    radix_node_t *c, **pp;
+
+    if (len == 0) {
+        if (n->count > 0)
+            n->count--;
+    } else {
+        if ((c = find_child(n, key[0])) == NULL || c->len > len ||
+            memcmp(c->label, key, c->len) != 0)
+            return 0;
+        if (remove_at(c, key + c->len, len - c->len, 0)) {
+            for (pp = &n->child; *pp != c; pp = &(*pp)->sibling)
+                ;
+            *pp = c->sibling;
+            Free(c->label);
+            Free(c);
+        }
+    }
+
+    if (root || n->count > 0)
+        return 0;
+    if (!n->child)
+        return 1;
+    if (!n->child->sibling)
+        merge(n);
+    return 0;
+}
+
+/*
+ * merge - 키가 끝나지 않는 노드 n을 유일한 자식과 합침
+ */
+static void merge(radix_node_t *n) {
+    radix_node_t *c = n->child;
+    char *label = Malloc(n->len + c->len);
+
+    memcpy(label, n->label, n->len);
+    memcpy(label + n->len, c->label, c->len);
+    Free(n->label);
+    Free(c->label);
+    n->label = label;
+    n->len += c->len;
+    n->count = c->count;
+    n->child = c->child;
+    Free(c);
+}
+
+static void walk_node(radix_node_t *n, char *buf, size_t blen, keylist_t *list) {
+    radix_node_t *c;
+
+    if (n->count > 0) {
+        if (list->n == list->cap) {
+            list->cap = list->cap ? list->cap * 2 : 16;
+            list->keys = Realloc(list->keys, list->cap * sizeof(char *));
+        }
+        list->keys[list->n] = Malloc(blen + 1);
+        memcpy(list->keys[list->n], buf, blen);
+        list->keys[list->n++][blen] = '\0';
+    }
+    for (c = n->child; c; c = c->sibling) {
+        if (blen + c->len >= MAXLINE)
+            continue;
+        memcpy(buf + blen, c->label, c->len);
+        walk_node(c, buf, blen + c->len, list);
+    }
+}
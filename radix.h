@@ -0,0 +1,28 @@
+/*
+ * radix.h - 캐시 키의 접두사 검색용 기수 트리 인터페이스
+ */
+#ifndef __RADIX_H__
+#define __RADIX_H__
+
+#include <stddef.h>
+
+/* 압축 트라이 노드: 루트에서 이 노드까지의 label을 이으면 키가 된다 */
+typedef struct radix_node {
+    char *label;
+    size_t len;
+    int count;                      /* 이 키로 끝나는 항목 수 (0이면 중간 노드) */
+    struct radix_node *child;       /* 첫 자식 (자식끼리 label 첫 바이트가 다름) */
+    struct radix_node *sibling;
+} radix_node_t;
+
+typedef struct {
+    radix_node_t root;              /* label이 빈 루트 */
+} radix_t;
+
+void radix_init(radix_t *r);
+void radix_insert(radix_t *r, char *key, size_t len);
+void radix_remove(radix_t *r, char *key, size_t len);
+int radix_collect(radix_t *r, char *prefix, char ***keysp);
+void radix_free_keys(char **keys, int n);
+
+#endif /* __RADIX_H__ */
@@ -0,0 +1,1475 @@
+/*
+ * reactor.c - epoll 기반 이벤트 엔진 (-e epoll)
+ *
+ * 작업 스레드 모델에서는 느린 원 서버 하나, 느린 클라이언트 하나가 스레드
+ * 하나를 통째로 묶는다. 이 엔진은 한 스레드가 epoll(엣지 트리거)로
+ * 논블로킹 소켓 여러 개를 돌리며, 연결마다 명시적인 상태 기계를 둔다.
+ *
+ *   READ_REQUEST -> RESOLVE -> CONNECT -> SEND -> RELAY -> DONE
+ *
+ * - READ_REQUEST: 받은 만큼 버퍼에 모으며 http_req_scan으로 헤더 끝을
+ *   찾는다. 헤더가 끝나면 proxy_request와 같은 순서로 캐시를 본다.
+ *   적중이면 SEND_CACHED로 가서 슬랩 memfd에서 sendfile로 보낸다.
+ * - RESOLVE: 숫자 주소는 바로 풀고, 이름은 풀이 스레드가 getaddrinfo로
+ *   풀어 eventfd로 알린다.
+ * - CONNECT: 논블로킹 connect. 실패하면 다음 주소를 시도한다.
+ * - SEND: format_request로 만든 요청을 보낸다.
+ * - RELAY: 응답 헤더를 모아 해석한 뒤(store_begin) 본문을 중계하며
+ *   캐시 채우기와 큰 객체 파일에 같이 쓴다(tee). 클라이언트가 받지 못하면
+ *   원 서버에서 더 읽지 않는다. 조건부 요청에 304가 오면 캐시된 사본을
+ *   보낸다.
+ *
+ * 소켓은 처음 등록할 때 읽기/쓰기를 함께 엣지 트리거로 걸고, 각 상태는
+ * EAGAIN이 날 때까지 진행한다. 이벤트가 오면 어느 쪽 소켓이든 연결의 현재
+ * 상태를 다시 돌릴 뿐이다. 한 번의 epoll_wait 묶음 안에서 끝난 연결은
+ * 묶음을 다 처리한 뒤에 해제한다.
+ *
+ * 블로킹이 필요한 요청은 작업 스레드 풀로 넘긴다(handoff): GET/HEAD가 아닌
+ * 메소드와 프록시 자신에게 오는 요청(origin-form: 상태 조회, PURGE, 예열),
+ * 진행 중 요청의 팔로워, 큰 객체 적중이다. epoll에서 fd를 빼고 읽은
+ * 요청을 fd로 찾는 표에 둔 뒤 fd를 큐에 넣으면, 작업 스레드가
+ * reactor_take로 꺼내 이어서 처리한다.
+ *
+ * 연결 하나가 잡는 메모리는 연결 구조체와 요청 버퍼뿐이며, 요청 헤더와
+ * 중계 버퍼는 요청을 읽은 뒤에 만든다.
+ *
+ * 엔진 스레드는 여러 개(-r)일 수 있다. 스레드마다 SO_REUSEPORT로 같은
+ * 포트에 자기 listen 소켓을 열고 자기 epoll 집합을 가지므로, 커널이
+ * 새 연결을 소켓들에 나눠 주며 받는 쪽에서 한 스레드를 거치지 않는다.
+ * 연결은 받은 스레드에서 끝까지 돌고 옮겨 가지 않는다. 이름 풀이 결과도
+ * 연결이 속한 스레드의 eventfd로 돌아간다. -c를 주면 i번째 스레드를
+ * i번째 CPU에 묶어 연결 상태가 한 코어의 캐시에 머물게 한다.
+ *
+ * -e uring이면 엔진 스레드마다 io_uring 링(uring.c)을 하나 두고 링에서
+ * 기다린다. 연결 수락은 다중 수락(multishot accept) 한 번으로 받고, epoll
+ * 집합은 링에 다중 poll로 걸어 요청 읽기, 이름 풀이, 연결, 요청 전송은
+ * 위와 같은 상태 기계로 돈다. 응답 헤더를 처리한 뒤의 본문 중계는 링으로
+ * 옮긴다: 두 소켓을 epoll에서 빼 등록 fd 칸에 올리고, 원 서버 쪽에 다중
+ * 수신(multishot recv)을 제공 버퍼 링과 함께 한 번 걸면, 받은 버퍼가
+ * 그대로 클라이언트로 보낼 조각 큐에 들어간다. 조각들은 연결된(IO_LINK)
+ * send 사슬로 순서대로 보내므로 조각마다 시스템 호출이 들지 않는다. 큐가
+ * URING_QUEUE_HIGH를 넘으면 수신을 취소하고 URING_QUEUE_LOW 아래로
+ * 내려가면 다시 건다. 제공 버퍼가 떨어져 수신이 멈춘(-ENOBUFS) 연결은
+ * 버퍼가 돌아오면 다시 건다. 링을 만들 수 없으면 epoll로 돈다.
+ */
+#include "reactor.h"
+#include "large.h"
+#include "origin.h"
+#include "proxy.h"
+#include "refresh.h"
+#include "slab.h"
+#include "uring.h"
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+
+/* 연결 상태 */
+enum {
+    C_READ_REQUEST,                 /* 요청 헤더 수신 중 */
+    C_RESOLVE,                      /* 풀이 스레드가 이름을 푸는 중 */
+    C_CONNECT,                      /* 원 서버에 연결 중 */
+    C_SEND,                         /* 요청 전송 중 */
+    C_RELAY,                        /* 응답 중계 중 */
+    C_SEND_CACHED,                  /* 캐시 객체 전송 중 */
+    C_REPLY,                        /* 프록시가 만든 응답(에러) 전송 중 */
+    C_DONE
+};
+
+/* epoll에 건 소켓의 종류 */
+enum { EP_LISTEN, EP_WAKE, EP_CLIENT, EP_UPSTREAM };
+
+/* 링 연산의 종류: user_data의 아래 3비트 (위는 연결이나 엔진 스레드 주소) */
+enum { U_ACCEPT, U_EPOLL, U_RECV, U_SEND, U_CANCEL };
+#define U_DATA(p, op) ((unsigned long)(p) | (op))
+
+#define URING_QUEUE_HIGH 16         /* 이만큼 쌓이면 원 서버 수신을 멈춤 */
+#define URING_QUEUE_LOW 4           /* 이 아래로 내려가면 다시 받음 */
+#define URING_CHAIN 16              /* 한 사슬에 연결할 send 수 */
+
+struct conn;
+struct reactor;
+
+/* epoll_event.data.ptr이 가리키는 것 */
+typedef struct {
+    int kind;
+    struct conn *conn;
+} endpoint_t;
+
+/* 클라이언트로 보낼 조각: 제공 버퍼(bid) 또는 중계 버퍼(bid -1)의 일부 */
+typedef struct {
+    int bid;
+    char *p;
+    size_t len;
+} chunk_t;
+
+typedef struct conn {
+    struct reactor *r;
+    int state;
+    int fd;                         /* 클라이언트 (작업 스레드로 넘기면 -1) */
+    int up_fd;                      /* 원 서버 (-1이면 없음) */
+    endpoint_t cl_ep, up_ep;
+
+    /* READ_REQUEST */
+    char *in;
+    size_t in_len, in_cap, scanned;
+
+    /* 요청을 읽은 뒤 */
+    char *hostname, *port, *path, *key;
+    http_req_t *req;
+    struct addrinfo *addrs, *ai;    /* 풀이 결과와 지금 시도하는 주소 */
+    int gai_rc;
+    char *msg;                      /* 보낼 요청이나 에러 응답 */
+    size_t msg_len, msg_off;
+
+    /* 캐시 적중 */
+    cache_entry_t *cached;
+    int stale_hit;
+    int slab_fd;                    /* 슬랩 memfd (-1이면 메모리에서 send) */
+    off_t slab_off;
+    size_t zc_start, zc_end;        /* sendfile로 보낼 본문 구간 (slab_locate) */
+    size_t sent;
+
+    /* 원 서버 응답 */
+    inflight_t *flight;             /* 리더로 채우는 진행 중 요청 */
+    cache_entry_t *stale;           /* 재검증할 만료 사본 */
+    int filling;
+    large_writer_t *large;
+    http_resp_t *resp;
+    cache_meta_t meta;
+    char *buf;                      /* 중계 버퍼 (MAXBUF) */
+    size_t buf_len, buf_off;
+    int header_done, up_eof, client_gone;
+    long body_bytes;
+
+    /* 링으로 본문 중계 (-e uring) */
+    int uring;                      /* 본문을 링으로 중계 중 */
+    int cl_slot, up_slot;           /* 등록 fd 칸 (-1이면 없음) */
+    chunk_t *q;                     /* 보낼 조각 [q_head, q_len) */
+    int q_head, q_len, q_cap;
+    int sending;                    /* 끝나지 않은 send 수 */
+    int pending;                    /* 끝나지 않은 링 연산 수 (0이어야 해제) */
+    int recv_armed, canceling, starved, failed;
+    struct conn *snext;             /* 버퍼 부족 목록 */
+
+    struct conn *next;              /* 풀이 큐, 풀이 완료 목록, 해제 대기 목록 */
+} conn_t;
+
+typedef struct reactor {
+    int id;
+    int cpu;                        /* 묶을 CPU (-1이면 묶지 않음) */
+    int listen_fd;                  /* 이 스레드만 받는 SO_REUSEPORT 소켓 */
+    int epfd;
+    int wake_fd;                    /* 풀이 완료를 알리는 eventfd */
+    endpoint_t listen_ep, wake_ep;
+    pthread_mutex_t lock;           /* resolved 보호 */
+    conn_t *resolved;               /* 풀이 스레드가 돌려준 연결 */
+    conn_t *dead;                   /* 이번 묶음에서 끝난 연결 */
+    unsigned long accepted;         /* 받은 연결 수 (원자적으로 읽음) */
+    unsigned long active;           /* 돌고 있는 연결 수 */
+    uring_t *ring;                  /* -e uring의 링 (NULL이면 epoll만) */
+    int *slots, nslots;             /* 비어 있는 등록 fd 칸 */
+    conn_t *starved;                /* 제공 버퍼가 떨어져 수신이 멈춘 연결 */
+} reactor_t;
+
+static int (*submit_conn)(int fd);
+
+static reactor_t *reactors;
+static int reactor_count;
+
+/* 작업 스레드로 넘긴 연결: fd로 찾는다 */
+static handoff_t **handoffs;
+static int handoff_max;
+static pthread_mutex_t handoff_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* 이름 풀이 큐 */
+static conn_t *resolve_head, *resolve_tail;
+static sem_t resolve_mutex, resolve_items;
+
+static void *reactor_thread(void *vargp);
+static void loop(reactor_t *r);
+static void handle_events(reactor_t *r, struct epoll_event *events, int n);
+static void reap(reactor_t *r);
+static void pin_cpu(int cpu);
+static void accept_all(reactor_t *r);
+static void add_conn(reactor_t *r, int fd);
+static void wake_up(reactor_t *r);
+static void run(conn_t *c);
+static void read_request(conn_t *c);
+static void on_request(conn_t *c, size_t hlen);
+static void handoff(conn_t *c, char *method, char *uri, int hdr_ok, inflight_t *flight,
+                    size_t hlen);
+static void resolve(conn_t *c);
+static void *resolver(void *vargp);
+static void start_connect(conn_t *c);
+static void connect_done(conn_t *c);
+static void send_upstream(conn_t *c);
+static void relay(conn_t *c);
+static int response_header(conn_t *c, size_t hlen);
+static void tee_body(conn_t *c, char *p, size_t n);
+static void finish_relay(conn_t *c, int failed);
+static void start_cached(conn_t *c);
+static void send_cached(conn_t *c);
+static void reply(conn_t *c, char *cause, char *err_num, char *short_msg, char *long_msg);
+static void send_reply(conn_t *c);
+static void fail_upstream(conn_t *c);
+static int flush(int fd, char *buf, size_t len, size_t *offp);
+static void conn_done(conn_t *c);
+static void conn_free(conn_t *c);
+static int watch(reactor_t *r, int fd, endpoint_t *ep);
+static int ring_init(reactor_t *r);
+static void ring_loop(reactor_t *r);
+static void ring_accept(reactor_t *r);
+static void ring_poll(reactor_t *r);
+static void ring_complete(reactor_t *r, struct io_uring_cqe *cqe);
+static int ring_relay_start(conn_t *c);
+static void ring_relay(conn_t *c);
+static void ring_recv(conn_t *c);
+static void ring_send(conn_t *c);
+static void ring_cancel(conn_t *c);
+static void ring_on_recv(conn_t *c, struct io_uring_cqe *cqe);
+static void ring_on_send(conn_t *c, int res);
+static void ring_push(conn_t *c, int bid, char *p, size_t len);
+static void ring_drop(conn_t *c);
+static void ring_relay_free(conn_t *c);
+static void set_nonblock(int fd);
+static char *dup_str(char *s);
+
+/*
+ * reactor_init - 넘김 표를 만들고 이름 풀이 스레드를 띄움
+ * submit은 넘긴 fd를 작업 스레드 큐에 넣으며 자리가 없으면 -1을 반환해야
+ * 한다 (엔진 스레드를 막지 않도록 기다리지 않는다).
+ */
+void reactor_init(int (*submit)(int fd)) {
+    struct rlimit rl;
+    pthread_t tid;
+    int i;
+
+    submit_conn = submit;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur == RLIM_INFINITY ||
+        rl.rlim_cur > (1 << 20))
+        rl.rlim_cur = 1 << 20;
+    handoff_max = rl.rlim_cur;
+    handoffs = Calloc(handoff_max, sizeof(handoff_t *));
+
+    Sem_init(&resolve_mutex, 0, 1);
+    Sem_init(&resolve_items, 0, 0);
+    for (i = 0; i < REACTOR_RESOLVERS; i++)
+        Pthread_create(&tid, NULL, resolver, NULL);
+}
+
+/*
+ * reactor_start - 엔진 스레드 count개가 각자 port에 listen 소켓을 열고
+ * 이벤트 루프를 돌림. 0번은 호출한 스레드에서 돌며 돌아오지 않는다.
+ * pin이면 i번째 스레드를 i번째 CPU(온라인 CPU 수로 나눈 나머지)에 묶는다.
+ * use_uring이면 스레드마다 io_uring 링을 만들고, 만들 수 없으면 epoll로 돈다.
+ */
+void reactor_start(char *port, int count, int pin, int use_uring) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t tid;
+    reactor_t *r;
+    int i;
+
+    reactors = Calloc(count, sizeof(reactor_t));
+    reactor_count = count;
+    for (i = 0; i < count; i++) {
+        r = &reactors[i];
+        r->id = i;
+        r->cpu = pin && ncpu > 0 ? i % ncpu : -1;
+        /* 스레드가 하나면 SO_REUSEPORT 없이 열어 다른 프로세스와 포트를 나누지 않음 */
+        r->listen_fd = Open_listenfd_opt(port, count > 1);
+        if ((r->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            unix_error("epoll_create1 error");
+        if ((r->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            unix_error("eventfd error");
+        pthread_mutex_init(&r->lock, NULL);
+        r->listen_ep.kind = EP_LISTEN;
+        r->wake_ep.kind = EP_WAKE;
+        if (watch(r, r->wake_fd, &r->wake_ep) < 0)
+            unix_error("epoll_ctl error");
+        if (use_uring && ring_init(r) == 0)
+            continue;               /* listen 소켓은 링의 다중 수락으로 받음 */
+        if (use_uring)
+            fprintf(stderr, "reactor %d: io_uring을 쓸 수 없어 epoll로 동작\n", i);
+        set_nonblock(r->listen_fd);
+        if (watch(r, r->listen_fd, &r->listen_ep) < 0)
+            unix_error("epoll_ctl error");
+    }
+    for (i = 1; i < count; i++)
+        Pthread_create(&tid, NULL, reactor_thread, &reactors[i]);
+    loop(&reactors[0]);
+}
+
+/*
+ * reactor_stats - 엔진 스레드별로 받은 연결 수와 돌고 있는 연결 수를 fd에 씀
+ */
+void reactor_stats(int fd) {
+    char line[MAXLINE];
+    int i, n;
+
+    if (!reactors)
+        return;
+    n = snprintf(line, sizeof(line), "\nreactor: 엔진 스레드 %d개\n%4s %4s %6s %12s %8s\n",
+                 reactor_count, "id", "cpu", "io", "accepted", "active");
+    rio_writen(fd, line, n);
+    for (i = 0; i < reactor_count; i++) {
+        n = snprintf(line, sizeof(line), "%4d %4d %6s %12lu %8lu\n", i, reactors[i].cpu,
+                     reactors[i].ring ? "uring" : "epoll",
+                     __atomic_load_n(&reactors[i].accepted, __ATOMIC_RELAXED),
+                     __atomic_load_n(&reactors[i].active, __ATOMIC_RELAXED));
+        rio_writen(fd, line, n);
+    }
+}
+
+static void *reactor_thread(void *vargp) {
+    Pthread_detach(pthread_self());
+    loop(vargp);
+    return NULL;
+}
+
+/*
+ * loop - 엔진 스레드 하나의 이벤트 루프 (돌아오지 않음)
+ */
+static void loop(reactor_t *r) {
+    struct epoll_event events[REACTOR_EVENTS];
+    int n;
+
+    if (r->cpu >= 0)
+        pin_cpu(r->cpu);
+    if (r->ring) {
+        ring_loop(r);
+        return;
+    }
+    while (1) {
+        if ((n = epoll_wait(r->epfd, events, REACTOR_EVENTS, -1)) < 0) {
+            if (errno == EINTR)
+                continue;
+            unix_error("epoll_wait error");
+        }
+        handle_events(r, events, n);
+        reap(r);
+    }
+}
+
+static void handle_events(reactor_t *r, struct epoll_event *events, int n) {
+    endpoint_t *ep;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        ep = events[i].data.ptr;
+        if (ep->kind == EP_LISTEN)
+            accept_all(r);
+        else if (ep->kind == EP_WAKE)
+            wake_up(r);
+        else if (ep->conn->state != C_DONE)
+            run(ep->conn);
+    }
+}
+
+/*
+ * reap - 이번 묶음에서 끝난 연결을 해제
+ * 같은 묶음의 뒤 이벤트가 끝난 연결을 가리킬 수 있으므로 묶음 뒤에 부른다.
+ */
+static void reap(reactor_t *r) {
+    conn_t *c;
+
+    while ((c = r->dead) != NULL) {
+        r->dead = c->next;
+        conn_free(c);
+    }
+}
+
+/*
+ * reactor_take - 작업 스레드가 큐에서 꺼낸 fd의 넘김 정보를 가져감
+ * 엔진이 넘긴 연결이 아니면 NULL
+ */
+handoff_t *reactor_take(int fd) {
+    handoff_t *h = NULL;
+
+    if (!handoffs || fd < 0 || fd >= handoff_max)
+        return NULL;
+    pthread_mutex_lock(&handoff_lock);
+    h = handoffs[fd];
+    handoffs[fd] = NULL;
+    pthread_mutex_unlock(&handoff_lock);
+    return h;
+}
+
+void reactor_handoff_free(handoff_t *h) {
+    Free(h->method);
+    Free(h->uri);
+    Free(h->req);
+    if (h->rest)
+        Free(h->rest);
+    Free(h);
+}
+
+/*
+ * pin_cpu - 부른 스레드를 cpu 하나에 묶음
+ * csapp.h와 함께 쓸 수 없는 _GNU_SOURCE 대신 시스템 호출을 직접 쓴다.
+ */
+static void pin_cpu(int cpu) {
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+
+    if (cpu >= 1024)
+        return;
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / (8 * sizeof(unsigned long))] |= 1UL << (cpu % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) < 0)
+        fprintf(stderr, "reactor: CPU %d에 묶기 실패: %s\n", cpu, strerror(errno));
+}
+
+/*
+ * accept_all - 대기 중인 연결을 EAGAIN까지 모두 받아 등록
+ */
+static void accept_all(reactor_t *r) {
+    int fd;
+
+    while (1) {
+        if ((fd = accept(r->listen_fd, NULL, NULL)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                fprintf(stderr, "accept error: %s\n", strerror(errno));
+            return;
+        }
+        add_conn(r, fd);
+    }
+}
+
+/*
+ * add_conn - 받은 연결을 논블로킹으로 바꿔 epoll에 등록
+ */
+static void add_conn(reactor_t *r, int fd) {
+    conn_t *c;
+
+    set_nonblock(fd);
+    c = Calloc(1, sizeof(conn_t));
+    c->r = r;
+    c->state = C_READ_REQUEST;
+    c->fd = fd;
+    c->up_fd = -1;
+    c->slab_fd = -1;
+    c->cl_slot = c->up_slot = -1;
+    c->cl_ep.kind = EP_CLIENT;
+    c->cl_ep.conn = c;
+    c->up_ep.kind = EP_UPSTREAM;
+    c->up_ep.conn = c;
+    if (watch(r, fd, &c->cl_ep) < 0) {
+        close(fd);
+        Free(c);
+        return;
+    }
+    __atomic_add_fetch(&r->accepted, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&r->active, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * wake_up - 풀이 스레드가 돌려준 연결들로 연결을 시작
+ */
+static void wake_up(reactor_t *r) {
+    uint64_t count;
+    conn_t *c, *next;
+
+    while (read(r->wake_fd, &count, sizeof(count)) > 0)
+        ;
+    pthread_mutex_lock(&r->lock);
+    c = r->resolved;
+    r->resolved = NULL;
+    pthread_mutex_unlock(&r->lock);
+
+    for (; c; c = next) {
+        next = c->next;
+        if (c->gai_rc != 0)
+            fail_upstream(c);
+        else
+            start_connect(c);
+    }
+}
+
+/*
+ * run - 연결을 현재 상태에서 더 진행할 수 없을 때까지 진행
+ */
+static void run(conn_t *c) {
+    switch (c->state) {
+    case C_READ_REQUEST:
+        read_request(c);
+        break;
+    case C_CONNECT:
+        connect_done(c);
+        break;
+    case C_SEND:
+        send_upstream(c);
+        break;
+    case C_RELAY:
+        relay(c);
+        break;
+    case C_SEND_CACHED:
+        send_cached(c);
+        break;
+    case C_REPLY:
+        send_reply(c);
+        break;
+    }
+}
+
+/*
+ * read_request - 요청 헤더를 받는 만큼 모으고, 끝나면 on_request
+ * 한 번에 RIO_BUFSIZE까지만 읽으므로 헤더 뒤에 받아 둔 바이트는 넘길 때
+ * rio 버퍼 하나에 들어간다.
+ */
+static void read_request(conn_t *c) {
+    size_t want, hlen;
+    ssize_t n;
+
+    while (1) {
+        if (c->in_len == c->in_cap) {
+            if (c->in_cap >= REACTOR_REQ_MAX) {
+                reply(c, "", "400", "잘못된 요청", "요청 헤더가 너무 깁니다");
+                return;
+            }
+            c->in_cap = c->in_cap ? 2 * c->in_cap : REACTOR_IN_INIT;
+            if (c->in_cap > REACTOR_REQ_MAX)
+                c->in_cap = REACTOR_REQ_MAX;
+            c->in = Realloc(c->in, c->in_cap);
+        }
+        want = c->in_cap - c->in_len;
+        if (want > RIO_BUFSIZE)
+            want = RIO_BUFSIZE;
+        if ((n = recv(c->fd, c->in + c->in_len, want, 0)) < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                conn_done(c);
+            return;
+        }
+        if (n == 0) {
+            conn_done(c);
+            return;
+        }
+        c->in_len += n;
+        if ((hlen = http_req_scan(c->in, c->in_len, &c->scanned)) > 0) {
+            on_request(c, hlen);
+            return;
+        }
+    }
+}
+
+/*
+ * on_request - 헤더를 다 읽은 요청을 캐시, 원 서버, 작업 스레드 중 하나로 보냄
+ * 캐시 조회 순서는 proxy_request와 같다.
+ */
+static void on_request(conn_t *c, size_t hlen) {
+    char method[MAXLINE], uri[MAXLINE], version[MAXLINE], target[MAXLINE];
+    char hostname[MAXLINE], path[MAXLINE], port[MAXLINE], key[MAXLINE];
+    cache_entry_t *cached = NULL;
+    large_entry_t *large;
+    inflight_t *flight = NULL;
+    origin_t *org;
+    int hdr_ok, is_get, leader = 0, stale_hit = 0;
+
+    c->req = Malloc(sizeof(http_req_t));
+    if ((hdr_ok = http_req_parse(c->in, hlen, method, uri, version, MAXLINE, c->req)) < 0) {
+        reply(c, "", "400", "잘못된 요청", "요청 줄이 너무 깁니다");
+        return;
+    }
+    printf("클라이언트 요청: %s %s %s\n", method, uri, version);
+
+    /* 프록시 자신에게 오는 요청과 그 밖의 메소드는 작업 스레드가 처리 */
+    if ((strcasecmp(method, "GET") != 0 && strcasecmp(method, "HEAD") != 0) ||
+        uri[0] == '/') {
+        handoff(c, method, uri, hdr_ok, NULL, hlen);
+        return;
+    }
+
+    strcpy(target, uri);
+    if (parse_uri(target, hostname, path, port) < 0) {
+        reply(c, uri, "400", "잘못된 요청", "프록시가 URI를 파싱할 수 없습니다");
+        return;
+    }
+
+    is_get = (strcasecmp(method, "GET") == 0) && hdr_ok &&
+             cache_make_key(key, hostname, port, path) == 0;
+    if (is_get) {
+        org = origin_get(key);
+        if ((cached = cache_lookup(key, c->req, &stale_hit)) == NULL) {
+            if ((large = large_lookup(key)) != NULL) {
+                large_release(large);
+                handoff(c, method, uri, hdr_ok, NULL, hlen);
+                return;
+            }
+            flight = cache_fetch_begin(key, c->req, &cached, &leader);
+        }
+        if (cached) {
+            printf("캐시 적중%s: %s\n", stale_hit ? "(만료, 백그라운드 갱신)" : "", key);
+            origin_count(org, 1);
+            c->cached = cached;
+            c->stale_hit = stale_hit;
+            if (stale_hit) {
+                c->hostname = dup_str(hostname);
+                c->port = dup_str(port);
+                c->path = dup_str(path);
+                c->key = dup_str(key);
+            }
+            start_cached(c);
+            return;
+        }
+        if (flight && !leader) {
+            handoff(c, method, uri, hdr_ok, flight, hlen);
+            return;
+        }
+        if (flight) {
+            c->flight = flight;
+            c->filling = 1;
+            c->stale = cache_lookup_stale(key, c->req);
+        }
+        origin_count(org, 0);
+    }
+
+    Free(c->in);
+    c->in = NULL;
+    c->hostname = dup_str(hostname);
+    c->port = dup_str(port);
+    c->msg = format_request(method, path, hostname, c->req, c->stale, &c->msg_len);
+    c->msg_off = 0;
+    resolve(c);
+}
+
+/*
+ * handoff - 연결을 epoll에서 빼고 읽은 요청과 함께 작업 스레드로 넘김
+ * 큐에 자리가 없으면 503으로 응답한다.
+ */
+static void handoff(conn_t *c, char *method, char *uri, int hdr_ok, inflight_t *flight,
+                    size_t hlen) {
+    handoff_t *h = Malloc(sizeof(handoff_t));
+
+    h->method = dup_str(method);
+    h->uri = dup_str(uri);
+    h->req = c->req;
+    h->hdr_ok = hdr_ok;
+    h->flight = flight;
+    h->rest_len = c->in_len - hlen;
+    h->rest = NULL;
+    if (h->rest_len > 0) {
+        h->rest = Malloc(h->rest_len);
+        memcpy(h->rest, c->in + hlen, h->rest_len);
+    }
+
+    epoll_ctl(c->r->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    pthread_mutex_lock(&handoff_lock);
+    handoffs[c->fd] = h;
+    pthread_mutex_unlock(&handoff_lock);
+    if (submit_conn(c->fd) == 0) {
+        c->req = NULL;
+        c->fd = -1;
+        conn_done(c);
+        return;
+    }
+
+    /* 작업 스레드 큐가 가득 참 */
+    pthread_mutex_lock(&handoff_lock);
+    handoffs[c->fd] = NULL;
+    pthread_mutex_unlock(&handoff_lock);
+    if (flight)
+        cache_unfollow(flight);
+    h->req = NULL;
+    Free(h->method);
+    Free(h->uri);
+    if (h->rest)
+        Free(h->rest);
+    Free(h);
+    printf("과부하: 연결 거절\n");
+    if (watch(c->r, c->fd, &c->cl_ep) < 0) {
+        conn_done(c);
+        return;
+    }
+    reply(c, "", "503", "서비스 불가", "프록시가 과부하 상태입니다. 잠시 후 다시 시도하세요");
+}
+
+/*
+ * resolve - 원 서버 주소를 풂. 숫자 주소는 바로, 이름은 풀이 스레드로
+ */
+static void resolve(conn_t *c) {
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_NUMERICHOST;
+    if (getaddrinfo(c->hostname, c->port, &hints, &c->addrs) == 0) {
+        start_connect(c);
+        return;
+    }
+    c->addrs = NULL;
+    c->state = C_RESOLVE;
+    c->next = NULL;
+    P(&resolve_mutex);
+    if (resolve_tail)
+        resolve_tail->next = c;
+    else
+        resolve_head = c;
+    resolve_tail = c;
+    V(&resolve_mutex);
+    V(&resolve_items);
+}
+
+/*
+ * resolver - 풀이 스레드 루틴: getaddrinfo 뒤 연결을 엔진으로 돌려줌
+ * RESOLVE 상태의 연결은 엔진이 건드리지 않으므로 락 없이 채운다.
+ */
+static void *resolver(void *vargp) {
+    struct addrinfo hints;
+    uint64_t one = 1;
+    conn_t *c;
+
+    Pthread_detach(pthread_self());
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+    while (1) {
+        P(&resolve_items);
+        P(&resolve_mutex);
+        c = resolve_head;
+        if ((resolve_head = c->next) == NULL)
+            resolve_tail = NULL;
+        V(&resolve_mutex);
+
+        if ((c->gai_rc = getaddrinfo(c->hostname, c->port, &hints, &c->addrs)) != 0) {
+            fprintf(stderr, "getaddrinfo failed (%s:%s): %s\n", c->hostname, c->port,
+                    gai_strerror(c->gai_rc));
+            c->addrs = NULL;
+        }
+        pthread_mutex_lock(&c->r->lock);
+        c->next = c->r->resolved;
+        c->r->resolved = c;
+        pthread_mutex_unlock(&c->r->lock);
+        if (write(c->r->wake_fd, &one, sizeof(one)) < 0)
+            fprintf(stderr, "eventfd write error: %s\n", strerror(errno));
+    }
+    return NULL;
+}
+
+/*
+ * start_connect - 다음 주소로 논블로킹 connect를 시작
+ * 주소가 더 없으면 클라이언트에 404로 응답한다.
+ */
+static void start_connect(conn_t *c) {
+    struct addrinfo *p;
+    int fd;
+
+    c->state = C_CONNECT;
+    for (p = c->ai ? c->ai->ai_next : c->addrs; p; p = p->ai_next) {
+        c->ai = p;
+        if ((fd = socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         p->ai_protocol)) < 0)
+            continue;
+        if (connect(fd, p->ai_addr, p->ai_addrlen) < 0 && errno != EINPROGRESS) {
+            close(fd);
+            continue;
+        }
+        if (watch(c->r, fd, &c->up_ep) < 0) {
+            close(fd);
+            continue;
+        }
+        c->up_fd = fd;
+        connect_done(c);
+        return;
+    }
+    fail_upstream(c);
+}
+
+/*
+ * connect_done - connect가 끝났으면 SEND로, 실패했으면 다음 주소로
+ * 클라이언트 쪽 이벤트로도 불리므로 쓰기 가능한지 먼저 확인한다.
+ */
+static void connect_done(conn_t *c) {
+    struct pollfd pfd = { c->up_fd, POLLOUT, 0 };
+    socklen_t len = sizeof(int);
+    int err = 0;
+
+    if (poll(&pfd, 1, 0) <= 0)
+        return;
+    if (getsockopt(c->up_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        close(c->up_fd);
+        c->up_fd = -1;
+        start_connect(c);
+        return;
+    }
+    c->state = C_SEND;
+    send_upstream(c);
+}
+
+/*
+ * send_upstream - 원 서버로 요청을 보내고 다 보내면 RELAY로
+ */
+static void send_upstream(conn_t *c) {
+    int rc;
+
+    if ((rc = flush(c->up_fd, c->msg, c->msg_len, &c->msg_off)) == 0)
+        return;
+    if (rc < 0) {
+        close(c->up_fd);
+        c->up_fd = -1;
+        fail_upstream(c);
+        return;
+    }
+    Free(c->msg);
+    c->msg = NULL;
+    c->state = C_RELAY;
+    c->buf = Malloc(MAXBUF);
+    c->resp = Malloc(sizeof(http_resp_t));
+    http_resp_init(c->resp);
+    c->scanned = 0;
+    relay(c);
+}
+
+/*
+ * relay - 원 서버 응답을 클라이언트로 중계
+ * 버퍼에 받은 바이트를 클라이언트에 다 보내야 원 서버에서 더 읽는다.
+ * 응답 헤더는 끝까지 모은 뒤에 해석하고 보낸다. 클라이언트가 끊겨도
+ * 캐시에 채우는 중이면 원 서버 응답은 끝까지 받는다.
+ */
+static void relay(conn_t *c) {
+    size_t hlen;
+    ssize_t n;
+    int rc;
+
+    if (c->uring)
+        return;                     /* 링으로 옮긴 뒤 묶음에 남은 이벤트 */
+    while (1) {
+        if (c->header_done && c->buf_off < c->buf_len) {
+            if (!c->client_gone &&
+                (rc = flush(c->fd, c->buf, c->buf_len, &c->buf_off)) <= 0) {
+                if (rc == 0)
+                    return;
+                c->client_gone = 1;
+                if (!c->filling && !c->large) {
+                    finish_relay(c, 1);
+                    return;
+                }
+            }
+            c->buf_off = c->buf_len;
+            continue;
+        }
+        if (c->up_eof) {
+            finish_relay(c, 0);
+            return;
+        }
+        if (c->header_done)
+            c->buf_len = c->buf_off = 0;
+
+        if ((n = recv(c->up_fd, c->buf + c->buf_len, MAXBUF - c->buf_len, 0)) < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                finish_relay(c, 1);
+            return;
+        }
+        if (n == 0)
+            c->up_eof = 1;
+        if (c->header_done) {
+            c->buf_len = n;
+            tee_body(c, c->buf, n);
+            continue;
+        }
+
+        /* 헤더 수신 중: 끝을 찾거나, 버퍼가 차거나, 원 서버가 닫을 때까지 모음 */
+        c->buf_len += n;
+        if ((hlen = http_req_scan(c->buf, c->buf_len, &c->scanned)) == 0 &&
+            c->buf_len < MAXBUF && n > 0)
+            continue;
+        if (response_header(c, hlen) < 0)
+            return;
+        if (c->r->ring && ring_relay_start(c) == 0)
+            return;
+    }
+}
+
+/*
+ * response_header - 모은 응답 헤더 [0, hlen)을 해석하고 캐시 여부를 정함
+ * hlen이 0이면 헤더가 끝나지 않은 채 버퍼가 찼거나 원 서버가 닫은 것으로,
+ * 받은 그대로 중계하되 캐시하지 않는다. 재검증 성공(304)으로 캐시된 사본을
+ * 보내기로 했으면 -1
+ */
+static int response_header(conn_t *c, size_t hlen) {
+    int header_end = (hlen > 0);
+
+    if (!header_end)
+        hlen = c->buf_len;
+    http_resp_parse_head(c->resp, c->buf, hlen);
+
+    /* 재검증 성공: 원 서버 헤더는 보내지 않고 캐시된 사본을 보냄 */
+    if (header_end && c->stale && c->resp->status == 304) {
+        printf("재검증 성공(304): 캐시된 사본 사용\n");
+        make_meta(c->resp, c->req, &c->meta, time(NULL));
+        c->cached = cache_revalidate(c->stale, &c->meta, c->buf, hlen);
+        cache_release(c->stale);
+        c->stale = NULL;
+        cache_fill_abort(c->flight);    /* 팔로워는 갱신된 캐시에서 읽음 */
+        cache_fetch_end(c->flight);
+        c->flight = NULL;
+        c->filling = 0;
+        close(c->up_fd);
+        c->up_fd = -1;
+        start_cached(c);
+        return -1;
+    }
+
+    if (c->filling && cache_fill_append(c->flight, c->buf, hlen) < 0)
+        c->filling = 0;
+    if (c->filling)
+        c->large = store_begin(c->resp, c->req, c->flight, header_end, hlen, c->buf,
+                               header_end ? hlen : -1, &c->meta, &c->filling);
+    c->header_done = 1;
+    c->buf_off = 0;
+    if (hlen < c->buf_len)
+        tee_body(c, c->buf + hlen, c->buf_len - hlen);
+    return 0;
+}
+
+/*
+ * tee_body - 본문 바이트를 캐시 채우기와 큰 객체 파일에도 씀
+ */
+static void tee_body(conn_t *c, char *p, size_t n) {
+    if (c->filling && cache_fill_append(c->flight, p, n) < 0)
+        c->filling = 0;
+    if (c->large)
+        large_append(c->large, p, n);
+    c->body_bytes += n;
+}
+
+/*
+ * finish_relay - 응답 중계를 끝냄. failed면 채우던 내용은 버린다
+ */
+static void finish_relay(conn_t *c, int failed) {
+    if (failed) {
+        if (c->filling)
+            cache_fill_abort(c->flight);
+        c->filling = 0;
+        if (c->large)
+            large_abort(c->large);
+    } else {
+        store_end(c->flight, c->large, c->resp, c->body_bytes, c->filling,
+                  c->meta.expires);
+    }
+    c->large = NULL;
+    conn_done(c);
+}
+
+/*
+ * start_cached - 잡은 캐시 객체를 보내기 시작
+ * 슬랩 청크 안에 통째로 든 memfd 페이지는 sendfile로, 앞뒤 조각은
+ * 메모리에서 보낸다 (cache_send와 같다).
+ */
+static void start_cached(conn_t *c) {
+    int afd;
+
+    c->state = C_SEND_CACHED;
+    c->sent = 0;
+    if (slab_locate(c->cached->data, c->cached->size, &afd, &c->slab_off, &c->zc_start,
+                    &c->zc_end) == 0)
+        c->slab_fd = afd;
+    send_cached(c);
+}
+
+/*
+ * send_cached - 캐시 객체를 보내고, 만료 사본이었으면 갱신을 예약
+ */
+static void send_cached(conn_t *c) {
+    cache_entry_t *e = c->cached;
+    size_t len;
+    off_t off;
+    ssize_t n;
+
+    while (c->sent < e->size) {
+        if (c->slab_fd >= 0 && c->sent >= c->zc_start && c->sent < c->zc_end) {
+            off = c->slab_off + c->sent;
+            n = sendfile(c->fd, c->slab_fd, &off, c->zc_end - c->sent);
+        } else {
+            len = (c->slab_fd >= 0 && c->sent < c->zc_start ? c->zc_start : e->size) - c->sent;
+            n = send(c->fd, e->data + c->sent, len, MSG_NOSIGNAL);
+        }
+        if (n > 0) {
+            c->sent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (c->slab_fd >= 0 && n < 0 && errno != EPIPE && errno != ECONNRESET) {
+            c->slab_fd = -1;        /* sendfile을 쓸 수 없으면 메모리에서 보냄 */
+            continue;
+        }
+        break;
+    }
+
+    /* 만료 사본을 보냈으면 갱신을 한 번만 예약; 참조는 작업으로 넘어감 */
+    if (c->stale_hit && cache_claim_refresh(e)) {
+        if (refresh_submit(c->hostname, c->port, c->path, c->key, c->req, e) == 0)
+            c->cached = NULL;
+        else
+            cache_unclaim_refresh(e);
+    }
+    conn_done(c);
+}
+
+/*
+ * reply - 프록시가 만든 에러 응답을 보내고 연결을 닫음
+ */
+static void reply(conn_t *c, char *cause, char *err_num, char *short_msg, char *long_msg) {
+    size_t size = MAXLINE + MAXBUF;
+
+    if (c->msg)
+        Free(c->msg);
+    c->msg = Malloc(size);
+    c->msg_len = format_error(c->msg, size, cause, err_num, short_msg, long_msg);
+    c->msg_off = 0;
+    c->state = C_REPLY;
+    send_reply(c);
+}
+
+static void send_reply(conn_t *c) {
+    if (flush(c->fd, c->msg, c->msg_len, &c->msg_off) != 0)
+        conn_done(c);
+}
+
+/*
+ * fail_upstream - 원 서버에 닿지 못함: 진행 중 요청을 끝내고 404로 응답
+ */
+static void fail_upstream(conn_t *c) {
+    if (c->flight) {
+        cache_fetch_end(c->flight);
+        c->flight = NULL;
+    }
+    if (c->stale) {
+        cache_release(c->stale);
+        c->stale = NULL;
+    }
+    reply(c, c->hostname, "404", "찾을 수 없음", "서버에 연결할 수 없습니다");
+}
+
+/*
+ * flush - buf[*offp, len)을 fd에 씀
+ * 반환값: 1 다 보냄, 0 소켓 버퍼가 참(EAGAIN), -1 오류
+ */
+static int flush(int fd, char *buf, size_t len, size_t *offp) {
+    ssize_t n;
+
+    while (*offp < len) {
+        if ((n = send(fd, buf + *offp, len - *offp, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        *offp += n;
+    }
+    return 1;
+}
+
+/*
+ * conn_done - 연결이 잡은 참조와 소켓을 놓고 해제 대기 목록에 올림
+ * 소켓을 닫으면 epoll에서도 빠진다.
+ */
+static void conn_done(conn_t *c) {
+    if (c->uring)
+        ring_relay_free(c);
+    if (c->large)
+        large_abort(c->large);
+    c->large = NULL;
+    if (c->flight)
+        cache_fetch_end(c->flight);
+    c->flight = NULL;
+    if (c->stale)
+        cache_release(c->stale);
+    c->stale = NULL;
+    if (c->cached)
+        cache_release(c->cached);
+    c->cached = NULL;
+    if (c->up_fd >= 0)
+        close(c->up_fd);
+    if (c->fd >= 0)
+        close(c->fd);
+    c->up_fd = c->fd = -1;
+    c->state = C_DONE;
+    __atomic_sub_fetch(&c->r->active, 1, __ATOMIC_RELAXED);
+    c->next = c->r->dead;
+    c->r->dead = c;
+}
+
+static void conn_free(conn_t *c) {
+    char *bufs[] = { c->in, c->hostname, c->port, c->path, c->key, c->msg, c->buf };
+    int i;
+
+    for (i = 0; i < sizeof(bufs) / sizeof(bufs[0]); i++)
+        if (bufs[i])
+            Free(bufs[i]);
+    if (c->req)
+        Free(c->req);
+    if (c->resp)
+        Free(c->resp);
+    if (c->q)
+        Free(c->q);
+    if (c->addrs)
+        freeaddrinfo(c->addrs);
+    Free(c);
+}
+
+/*
+ * watch - fd를 읽기/쓰기 엣지 트리거로 epoll에 등록
+ */
+static int watch(reactor_t *r, int fd, endpoint_t *ep) {
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = ep;
+    return epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void set_nonblock(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static char *dup_str(char *s) {
+    char *d = Malloc(strlen(s) + 1);
+
+    strcpy(d, s);
+    return d;
+}
+
+/*
+ * ring_init - 엔진 스레드의 링과 등록 fd 칸 목록을 만듦. 실패하면 -1
+ */
+static int ring_init(reactor_t *r) {
+    int i;
+
+    r->ring = Malloc(sizeof(uring_t));
+    if (uring_init(r->ring) < 0) {
+        Free(r->ring);
+        r->ring = NULL;
+        return -1;
+    }
+    r->slots = Malloc(URING_FILES * sizeof(int));
+    for (i = 0; i < URING_FILES; i++)
+        r->slots[i] = URING_FILES - 1 - i;
+    r->nslots = URING_FILES;
+    return 0;
+}
+
+/*
+ * ring_loop - 링에서 기다리는 이벤트 루프 (돌아오지 않음)
+ * 채운 SQE는 완료를 기다릴 때 한꺼번에 제출한다.
+ */
+static void ring_loop(reactor_t *r) {
+    struct io_uring_cqe cqe;
+    conn_t *c;
+
+    ring_accept(r);
+    ring_poll(r);
+    while (1) {
+        uring_submit(r->ring, 1);
+        while (uring_peek(r->ring, &cqe))
+            ring_complete(r, &cqe);
+        /* 버퍼가 돌아왔으면 멈췄던 수신을 다시 건다 */
+        while (r->ring->bufs_free > 0 && (c = r->starved) != NULL) {
+            r->starved = c->snext;
+            c->starved = 0;
+            ring_relay(c);
+        }
+        reap(r);
+    }
+}
+
+/*
+ * ring_accept - listen 소켓에 다중 수락을 검
+ */
+static void ring_accept(reactor_t *r) {
+    struct io_uring_sqe *sqe = uring_sqe(r->ring);
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = r->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = U_DATA(r, U_ACCEPT);
+}
+
+/*
+ * ring_poll - epoll 집합에 다중 poll을 검: epoll에 이벤트가 생길 때마다 완료가 옴
+ */
+static void ring_poll(reactor_t *r) {
+    struct io_uring_sqe *sqe = uring_sqe(r->ring);
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = r->epfd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = U_DATA(r, U_EPOLL);
+}
+
+/*
+ * ring_complete - 완료 하나를 처리
+ * 다중 연산은 IORING_CQE_F_MORE가 없는 완료로 끝나므로 그때 다시 건다.
+ */
+static void ring_complete(reactor_t *r, struct io_uring_cqe *cqe) {
+    struct epoll_event events[REACTOR_EVENTS];
+    int op = cqe->user_data & 7, more = cqe->flags & IORING_CQE_F_MORE, n;
+    conn_t *c = (conn_t *)(cqe->user_data & ~7UL);
+
+    switch (op) {
+    case U_ACCEPT:
+        if (cqe->res >= 0)
+            add_conn(r, cqe->res);
+        else if (cqe->res != -ECONNABORTED && cqe->res != -EINTR)
+            fprintf(stderr, "accept error: %s\n", strerror(-cqe->res));
+        if (!more)
+            ring_accept(r);
+        return;
+    case U_EPOLL:
+        do {
+            if ((n = epoll_wait(r->epfd, events, REACTOR_EVENTS, 0)) < 0)
+                break;
+            handle_events(r, events, n);
+        } while (n == REACTOR_EVENTS);
+        if (!more)
+            ring_poll(r);
+        return;
+    case U_RECV:
+        ring_on_recv(c, cqe);
+        break;
+    case U_SEND:
+        ring_on_send(c, cqe->res);
+        break;
+    case U_CANCEL:
+        c->pending--;
+        break;
+    }
+    if (c->state != C_DONE)
+        ring_relay(c);
+}
+
+/*
+ * ring_relay_start - 응답 헤더를 처리한 연결의 본문 중계를 링으로 옮김
+ * 등록 fd 칸이 모자라면 -1 (epoll로 계속 중계한다).
+ */
+static int ring_relay_start(conn_t *c) {
+    reactor_t *r = c->r;
+
+    if (r->nslots < 2)
+        return -1;
+    c->cl_slot = r->slots[--r->nslots];
+    c->up_slot = r->slots[--r->nslots];
+    if (uring_set_file(r->ring, c->cl_slot, c->fd) < 0 ||
+        uring_set_file(r->ring, c->up_slot, c->up_fd) < 0) {
+        uring_set_file(r->ring, c->cl_slot, -1);
+        r->slots[r->nslots++] = c->up_slot;
+        r->slots[r->nslots++] = c->cl_slot;
+        c->cl_slot = c->up_slot = -1;
+        return -1;
+    }
+    /* 링의 연산은 완료를 기다려 주므로 소켓을 블로킹으로 되돌림 */
+    epoll_ctl(r->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    epoll_ctl(r->epfd, EPOLL_CTL_DEL, c->up_fd, NULL);
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) & ~O_NONBLOCK);
+    fcntl(c->up_fd, F_SETFL, fcntl(c->up_fd, F_GETFL) & ~O_NONBLOCK);
+    c->uring = 1;
+    if (c->buf_off < c->buf_len)
+        ring_push(c, -1, c->buf + c->buf_off, c->buf_len - c->buf_off);
+    c->buf_off = c->buf_len;
+    ring_relay(c);
+    return 0;
+}
+
+/*
+ * ring_relay - 링으로 중계하는 연결을 다음 단계로 진행
+ * 보낼 조각이 있고 보내는 중이 아니면 사슬을 보내고, 큐 길이에 따라
+ * 수신을 걸거나 취소한다. 끝났으면 걸린 연산이 모두 돌아온 뒤에 닫는다.
+ */
+static void ring_relay(conn_t *c) {
+    int queued = c->q_len - c->q_head;
+    int done = c->failed || (c->up_eof && queued == 0) ||
+               (c->client_gone && !c->filling && !c->large);
+    conn_t **pp;
+
+    if (done) {
+        if (c->recv_armed && !c->canceling)
+            ring_cancel(c);
+        if (c->sending > 0)
+            shutdown(c->fd, SHUT_RDWR);     /* 멈춘 send를 끝냄 */
+        if (c->pending > 0)
+            return;
+        if (c->starved)
+            for (pp = &c->r->starved; *pp; pp = &(*pp)->snext)
+                if (*pp == c) {
+                    *pp = c->snext;
+                    break;
+                }
+        finish_relay(c, c->failed || !c->up_eof);
+        return;
+    }
+    if (queued > 0 && c->sending == 0 && !c->client_gone)
+        ring_send(c);
+    if (!c->up_eof && !c->recv_armed && !c->starved && queued < URING_QUEUE_LOW)
+        ring_recv(c);
+    else if (c->recv_armed && !c->canceling && queued >= URING_QUEUE_HIGH)
+        ring_cancel(c);
+}
+
+/*
+ * ring_recv - 원 서버 소켓에 제공 버퍼를 쓰는 다중 수신을 검
+ */
+static void ring_recv(conn_t *c) {
+    struct io_uring_sqe *sqe = uring_sqe(c->r->ring);
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->up_slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = U_DATA(c, U_RECV);
+    c->recv_armed = 1;
+    c->pending++;
+}
+
+/*
+ * ring_send - 큐의 조각들을 연결된 send 사슬로 보냄
+ * MSG_WAITALL이라 덜 보낸 send는 실패로 끝나고 뒤의 send는 -ECANCELED로
+ * 돌아오므로, 바이트 순서가 섞이지 않는다.
+ */
+static void ring_send(conn_t *c) {
+    struct io_uring_sqe *sqe = NULL;
+    int i, n = c->q_len - c->q_head;
+
+    if (n > URING_CHAIN)
+        n = URING_CHAIN;
+    uring_reserve(c->r->ring, n);
+    for (i = c->q_head; i < c->q_head + n; i++) {
+        sqe = uring_sqe(c->r->ring);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = c->cl_slot;
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+        sqe->addr = (unsigned long)c->q[i].p;
+        sqe->len = c->q[i].len;
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->user_data = U_DATA(c, U_SEND);
+        c->sending++;
+        c->pending++;
+    }
+    sqe->flags &= ~IOSQE_IO_LINK;   /* 사슬의 끝 */
+}
+
+/*
+ * ring_cancel - 걸린 다중 수신을 취소 (마지막 완료가 -ECANCELED로 옴)
+ */
+static void ring_cancel(conn_t *c) {
+    struct io_uring_sqe *sqe = uring_sqe(c->r->ring);
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = U_DATA(c, U_RECV);
+    sqe->user_data = U_DATA(c, U_CANCEL);
+    c->canceling = 1;
+    c->pending++;
+}
+
+/*
+ * ring_on_recv - 수신 완료: 받은 제공 버퍼를 캐시에 쓰고 보낼 큐에 넣음
+ */
+static void ring_on_recv(conn_t *c, struct io_uring_cqe *cqe) {
+    uring_t *u = c->r->ring;
+    unsigned bid;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        u->bufs_free--;
+        if (cqe->res > 0)
+            tee_body(c, uring_buf(u, bid), cqe->res);
+        if (cqe->res > 0 && !c->client_gone)
+            ring_push(c, bid, uring_buf(u, bid), cqe->res);
+        else
+            uring_buf_put(u, bid);
+    }
+    if (cqe->res == 0) {
+        c->up_eof = 1;
+    } else if (cqe->res == -ENOBUFS) {
+        if (!c->starved) {
+            c->starved = 1;
+            c->snext = c->r->starved;
+            c->r->starved = c;
+        }
+    } else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+        c->failed = 1;
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        c->recv_armed = c->canceling = 0;
+        c->pending--;
+    }
+}
+
+/*
+ * ring_on_send - send 완료: 다 보낸 조각은 큐에서 빼고, 덜 보냈으면 남은 만큼 줄임
+ */
+static void ring_on_send(conn_t *c, int res) {
+    chunk_t *ch = &c->q[c->q_head];
+
+    c->sending--;
+    c->pending--;
+    if (res == -ECANCELED) {
+        /* 앞의 send가 실패해 취소됨: 다음 사슬에서 다시 보냄 */
+    } else if (res < 0) {
+        c->client_gone = 1;
+    } else if (res < ch->len) {
+        ch->p += res;
+        ch->len -= res;
+    } else {
+        if (ch->bid >= 0)
+            uring_buf_put(c->r->ring, ch->bid);
+        c->q_head++;
+    }
+    if (c->client_gone && c->sending == 0)
+        ring_drop(c);
+}
+
+/*
+ * ring_push - 보낼 조각을 큐 끝에 붙임 (앞이 비었으면 당기고, 모자라면 두 배로)
+ */
+static void ring_push(conn_t *c, int bid, char *p, size_t len) {
+    if (c->q_len == c->q_cap) {
+        if (c->q_head > 0) {
+            memmove(c->q, c->q + c->q_head, (c->q_len - c->q_head) * sizeof(chunk_t));
+            c->q_len -= c->q_head;
+            c->q_head = 0;
+        } else {
+            c->q_cap = c->q_cap ? 2 * c->q_cap : URING_QUEUE_HIGH;
+            c->q = Realloc(c->q, c->q_cap * sizeof(chunk_t));
+        }
+    }
+    c->q[c->q_len].bid = bid;
+    c->q[c->q_len].p = p;
+    c->q[c->q_len].len = len;
+    c->q_len++;
+}
+
+/*
+ * ring_drop - 보내지 못할 조각을 모두 버리고 제공 버퍼를 돌려줌
+ */
+static void ring_drop(conn_t *c) {
+    for (; c->q_head < c->q_len; c->q_head++)
+        if (c->q[c->q_head].bid >= 0)
+            uring_buf_put(c->r->ring, c->q[c->q_head].bid);
+    c->q_head = c->q_len = 0;
+}
+
+/*
+ * ring_relay_free - 연결이 잡은 등록 fd 칸과 제공 버퍼를 돌려줌
+ * 칸을 비워야 커널이 잡은 소켓 참조가 풀려 close로 실제로 닫힌다.
+ */
+static void ring_relay_free(conn_t *c) {
+    reactor_t *r = c->r;
+
+    ring_drop(c);
+    uring_set_file(r->ring, c->cl_slot, -1);
+    uring_set_file(r->ring, c->up_slot, -1);
+    r->slots[r->nslots++] = c->up_slot;
+    r->slots[r->nslots++] = c->cl_slot;
+    c->cl_slot = c->up_slot = -1;
+    c->uring = 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * reactor.h - epoll 기반 이벤트 엔진 인터페이스
+ */
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+
+#include "csapp.h"
+#include "cache.h"
+#include "http.h"
+
+#define REACTOR_EVENTS 256          /* epoll_wait 한 번에 받을 이벤트 수 */
+#define REACTOR_REQ_MAX (MAXLINE + HTTP_REQ_MAX)  /* 요청 줄과 헤더를 모을 상한 */
+#define REACTOR_IN_INIT 1024        /* 요청 버퍼의 처음 크기 (모자라면 두 배씩) */
+#define REACTOR_RESOLVERS 4         /* 이름 풀이 스레드 수 */
+
+/* 작업 스레드에 넘기는 연결: 이미 읽은 요청과 헤더 뒤에 받아 둔 바이트 */
+typedef struct {
+    char *method;
+    char *uri;
+    http_req_t *req;
+    int hdr_ok;
+    inflight_t *flight;             /* 따라 읽을 진행 중 요청 (NULL이면 dispatch) */
+    char *rest;                     /* 헤더 뒤 바이트 (RIO_BUFSIZE 이하) */
+    size_t rest_len;
+} handoff_t;
+
+void reactor_init(int (*submit)(int fd));
+void reactor_start(char *port, int count, int pin, int use_uring);
+void reactor_stats(int fd);
+handoff_t *reactor_take(int fd);
+void reactor_handoff_free(handoff_t *h);
+
+#endif /* __REACTOR_H__ */
@@ -0,0 +1,99 @@
+/*
+ * refresh.c - 만료 캐시 객체의 백그라운드 갱신 풀
+ *
+ * stale-while-revalidate로 만료 객체를 바로 응답한 스레드는 갱신 작업을
+ * 여기에 넣고 곧바로 돌아간다. REFRESH_THREADS개의 스레드가 작업을 꺼내
+ * 프록시가 등록한 handler로 원 서버에서 다시 가져와 캐시를 교체한다.
+ *
+ * 작업 큐는 csapp의 P/V 세마포어로 만든 유한 버퍼이다. 큐가 가득 차면
+ * 작업을 버리며(refresh_submit이 -1), 다음 적중이 다시 시도한다.
+ */
+#include "refresh.h"
+
+static refresh_job_t *queue[REFRESH_QUEUE];
+static int front, rear;             /* queue[front % N]부터 queue[rear % N]까지 */
+static sem_t mutex;                 /* 큐 접근 보호 */
+static sem_t slots;                 /* 빈 칸 수 */
+static sem_t items;                 /* 대기 작업 수 */
+static void (*refresh_handler)(refresh_job_t *job);
+
+static void *refresher(void *vargp);
+static char *dup_str(char *s);
+
+/*
+ * refresh_init - 큐를 만들고 갱신 스레드를 띄움
+ */
+void refresh_init(void (*handler)(refresh_job_t *job)) {
+    int i;
+    pthread_t tid;
+
+    refresh_handler = handler;
+    front = rear = 0;
+    Sem_init(&mutex, 0, 1);
+    Sem_init(&slots, 0, REFRESH_QUEUE);
+    Sem_init(&items, 0, 0);
+    for (i = 0; i < REFRESH_THREADS; i++)
+        Pthread_create(&tid, NULL, refresher, NULL);
+}
+
+/*
+ * refresh_submit - 갱신 작업을 큐에 넣음 (블록하지 않음)
+ * 성공하면 stale의 참조는 작업으로 넘어가고 0을 반환한다.
+ * 큐가 가득 차면 -1을 반환하며 참조는 호출자에게 남는다.
+ */
+int refresh_submit(char *hostname, char *port, char *path, char *key,
+                   http_req_t *req, cache_entry_t *stale) {
+    refresh_job_t *job;
+
+    if (sem_trywait(&slots) < 0)
+        return -1;
+
+    job = Malloc(sizeof(refresh_job_t));
+    job->hostname = dup_str(hostname);
+    job->port = dup_str(port);
+    job->path = dup_str(path);
+    job->key = dup_str(key);
+    job->req = Malloc(sizeof(http_req_t));
+    memcpy(job->req, req, sizeof(http_req_t));
+    job->stale = stale;
+
+    P(&mutex);
+    queue[(rear++) % REFRESH_QUEUE] = job;
+    V(&mutex);
+    V(&items);
+    return 0;
+}
+
+/*
+ * refresher - 갱신 스레드 루틴: 작업을 꺼내 handler를 부르고 정리
+ */
+static void *refresher(void *vargp) {
+    refresh_job_t *job;
+
+    Pthread_detach(pthread_self());
+    while (1) {
+        P(&items);
+        P(&mutex);
+        job = queue[(front++) % REFRESH_QUEUE];
+        V(&mutex);
+        V(&slots);
+
+        refresh_handler(job);
+
+        cache_release(job->stale);
+        Free(job->hostname);
+        Free(job->port);
+        Free(job->path);
+        Free(job->key);
+        Free(job->req);
+        Free(job);
+    }
+    return NULL;
+}
+
+static char *dup_str(char *s) {
+    char *d = Malloc(strlen(s) + 1);
+
+    strcpy(d, s);
+    return d;
+}
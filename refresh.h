@@ -0,0 +1,26 @@
+/*
+ * refresh.h - 만료 캐시 객체의 백그라운드 갱신 풀 인터페이스
+ */
+#ifndef __REFRESH_H__
+#define __REFRESH_H__
+
+#include "cache.h"
+
+#define REFRESH_THREADS 2           /* 갱신 스레드 수 */
+#define REFRESH_QUEUE 64            /* 대기 중인 갱신 작업 상한 */
+
+/* 갱신 작업: 원 서버에서 다시 가져올 위치와 교체할 만료 객체 */
+typedef struct {
+    char *hostname;
+    char *port;
+    char *path;
+    char *key;
+    http_req_t *req;                /* 원 요청의 헤더 (같은 변형을 다시 받기 위해) */
+    cache_entry_t *stale;           /* 작업이 참조를 가진 만료 객체 */
+} refresh_job_t;
+
+void refresh_init(void (*handler)(refresh_job_t *job));
+int refresh_submit(char *hostname, char *port, char *path, char *key,
+                   http_req_t *req, cache_entry_t *stale);
+
+#endif /* __REFRESH_H__ */
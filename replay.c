@@ -0,0 +1,423 @@
+/*
+ * replay.c - 접근 기록을 축출 정책마다 다시 돌려 적중률을 비교하는 도구
+ *
+ * 프록시와 같은 policy.c 함수 표(cache_policy_t)를 그대로 써서, 기록의
+ * 요청을 차례로 샤드에 넣고 꺼내며 정책별 객체 적중률과 바이트 적중률을
+ * 낸다. 샤드 수, 샤드 예산, 캐시 가능한 최대 객체 크기는 프록시와 같게
+ * 나눈다. -a를 주면 정책마다 TinyLFU 승인(tinylfu.c)을 끈 채로 한 번, 켠
+ * 채로 한 번 돌린다. 승인은 insert_entry처럼 축출 후보를 모두 모은 뒤에
+ * 정하고, 거절하면 후보를 되돌린다. Vary 변형과 만료는 흉내 내지 않으므로
+ * 정책 사이의 상대 비교에 쓴다.
+ *
+ * -u를 주면 정책마다 키를 정규화하지 않고 한 번(urlnorm.c 이전의
+ * "호스트:포트경로" 키), urlnorm.c로 정규화해 한 번 돌린다. -V pct는 합성
+ * 기록의 인기 객체 요청 중 pct%를 같은 URL의 다른 표기(호스트 대소문자,
+ * :80 유무, %xx, 점 세그먼트)로 바꿔 쓴다.
+ *
+ * 기록 파일은 한 줄에 요청 하나: "키 바이트수". #으로 시작하는 줄과 빈
+ * 줄은 건너뛴다. 파일 이름이 -이면 표준 입력에서 읽는다. 기록 대신 -z로
+ * 합성 기록을 만들 수 있다: 요청 대부분은 Zipf 분포를 따르는 인기 객체,
+ * 나머지는 한 번만 나오는 URL을 연달아 훑는 스캔이다.
+ *
+ * usage: ./replay [-a] [-u] [-s shards] [-c cache_bytes] [-p policy]...
+ *                 (-z requests [-V pct] | <trace>)
+ */
+#include "policy.h"
+#include "tinylfu.h"
+#include "urlnorm.h"
+#include <math.h>
+
+#define REPLAY_BUCKETS 4096         /* 샤드당 해시 버킷 수 (2의 거듭제곱) */
+#define SYNTH_OBJECTS 20000         /* 합성 기록의 인기 객체 수 */
+#define SYNTH_ZIPF 0.9              /* 합성 기록의 Zipf 지수 */
+#define SYNTH_SCAN_PCT 30           /* 합성 기록에서 스캔 요청 비율(%) */
+#define SYNTH_SCAN_RUN 2000         /* 스캔 한 번에 이어지는 URL 수 */
+
+typedef struct {
+    char *key;
+    unsigned long hash;
+    size_t size;
+    char *alt_key;                  /* -u: 다른 쪽 키와 해시 (swap_keys가 맞바꿈) */
+    unsigned long alt_hash;
+} trace_req_t;
+
+typedef struct {
+    cache_entry_t *buckets[REPLAY_BUCKETS];
+    policy_state_t policy;
+    size_t capacity;
+    size_t bytes;
+} replay_shard_t;
+
+static trace_req_t *reqs;
+static size_t req_count;
+
+static int admission;               /* TinyLFU 승인을 거치는지 */
+static int compare_keys;            /* -u: 정규화 없이/있이 비교 */
+static int normalized;              /* 지금 키가 정규화한 키인지 */
+static int variant_pct;             /* -V: 다른 표기로 쓸 인기 객체 요청 비율(%) */
+
+static void load_trace(char *path);
+static void synth_trace(size_t n);
+static void add_req(char *key, size_t size);
+static void swap_keys(void);
+static void replay(char *name, int nshards, size_t cache_bytes);
+static cache_entry_t *lookup(replay_shard_t *sh, trace_req_t *r);
+static void insert(replay_shard_t *sh, trace_req_t *r);
+static void drop(replay_shard_t *sh, cache_entry_t *e);
+static void unlink_entry(replay_shard_t *sh, cache_entry_t *e);
+static unsigned long hash_key(char *key);
+static void usage(char *prog);
+
+static char *all_policies[] = { "clock", "lru", "slru", "gdsf" };
+
+int main(int argc, char *argv[]) {
+    char *names[sizeof(all_policies) / sizeof(all_policies[0])];
+    int opt, i, count = 0, nshards = CACHE_DEFAULT_SHARDS, compare = 0, n;
+    size_t cache_bytes = MAX_CACHE_SIZE, synth = 0;
+
+    while ((opt = getopt(argc, argv, "aus:c:p:z:V:")) != -1) {
+        switch (opt) {
+        case 'a':  /* TinyLFU 승인 없이/있이 비교 */
+            compare = 1;
+            break;
+        case 'u':  /* URL 정규화 없이/있이 비교 */
+            compare_keys = 1;
+            break;
+        case 'V':  /* 합성 기록에서 다른 표기로 쓸 비율(%) */
+            variant_pct = atoi(optarg);
+            break;
+        case 's':  /* 샤드 수 (2의 거듭제곱으로 올림) */
+            nshards = atoi(optarg);
+            break;
+        case 'c':  /* 전체 캐시 예산(바이트) */
+            cache_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':  /* 돌려 볼 정책 (여러 번 줄 수 있음, 없으면 전부) */
+            if (policy_select(optarg) < 0 || count == sizeof(names) / sizeof(names[0]))
+                usage(argv[0]);
+            names[count++] = optarg;
+            break;
+        case 'z':  /* 기록 파일 대신 합성 기록 (요청 수) */
+            synth = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - !synth || nshards < 1 || nshards > CACHE_MAX_SHARDS || cache_bytes == 0 ||
+        variant_pct < 0 || variant_pct > 100 || (variant_pct && !synth))
+        usage(argv[0]);
+    if (count == 0)
+        for (; count < sizeof(all_policies) / sizeof(all_policies[0]); count++)
+            names[count] = all_policies[count];
+
+    if (synth)
+        synth_trace(synth);
+    else
+        load_trace(argv[optind]);
+    printf("%-21s %10s %10s %7s %14s %14s %7s\n", "policy", "requests", "hits", "hit%",
+           "bytes", "hit bytes", "byte%");
+    for (i = 0; i < count; i++) {
+        for (n = 0; n <= compare_keys; n++) {
+            for (admission = 0; admission <= compare; admission++)
+                replay(names[i], nshards, cache_bytes);
+            if (compare_keys)
+                swap_keys();
+        }
+    }
+    exit(0);
+}
+
+/*
+ * load_trace - 기록 파일을 읽어 reqs에 담음 (키는 한 번씩 해시)
+ */
+static void load_trace(char *path) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : Fopen(path, "r");
+    char line[MAXLINE], key[MAXLINE];
+    size_t line_no = 0;
+    unsigned long size;
+
+    while (Fgets(line, MAXLINE, fp) != NULL) {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf(line, "%s %lu", key, &size) != 2) {
+            fprintf(stderr, "replay: %s:%zu: \"키 바이트수\" 형식이 아닙니다\n", path, line_no);
+            exit(1);
+        }
+        add_req(key, size);
+    }
+    if (fp != stdin)
+        Fclose(fp);
+}
+
+/*
+ * synth_trace - Zipf 분포 인기 객체 사이에 한 번만 나오는 URL 스캔을 섞은
+ * 요청 n개를 만듦. 같은 n이면 항상 같은 기록이 나온다.
+ * 객체 크기는 80%가 작은 페이지(200B~4KB), 나머지가 이미지(8KB~100KB)이다.
+ * variant_pct면 인기 객체 요청 일부를 같은 URL의 다른 표기로 쓴다.
+ */
+static void synth_trace(size_t n) {
+    /* 같은 "http://origin.test:80/objects/N"을 가리키는 표기들 */
+    static const char *variants[] = {
+        "http://ORIGIN.test:80/objects/%u",
+        "http://origin.test/objects/%u",
+        "http://origin.test:80/%%6Fbjects/%u",
+        "http://origin.test:80/%%6fbjects/%u",
+        "http://origin.test:80/objects/./%u",
+        "http://origin.test/static/../objects/%u",
+        "http://Origin.Test.:80/obj%%65cts/%u",
+    };
+    double *cdf = Malloc(SYNTH_OBJECTS * sizeof(double)), sum = 0, u;
+    unsigned seed = 1, vseed = 7, lo, hi, mid;
+    size_t i, scan = 0, run = 0, size;
+    char key[MAXLINE];
+
+    for (i = 0; i < SYNTH_OBJECTS; i++)
+        cdf[i] = sum += 1.0 / pow(i + 1, SYNTH_ZIPF);
+
+    for (i = 0; i < n; i++) {
+        /* 스캔 시작 확률 p = PCT / (RUN * (100 - PCT)): 요청의 PCT%가 스캔 */
+        if (run == 0 && rand_r(&seed) % (SYNTH_SCAN_RUN * (100 - SYNTH_SCAN_PCT)) < SYNTH_SCAN_PCT)
+            run = SYNTH_SCAN_RUN;
+        if (run > 0) {
+            run--;
+            sprintf(key, "http://origin.test:80/scan/%zu", scan);
+            size = 200 + (scan++ * 2654435761u) % 20000;
+        } else {
+            u = (double)rand_r(&seed) / RAND_MAX * sum;
+            for (lo = 0, hi = SYNTH_OBJECTS - 1; lo < hi; ) {
+                mid = (lo + hi) / 2;
+                if (cdf[mid] < u)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            if (variant_pct && rand_r(&vseed) % 100 < variant_pct)
+                sprintf(key, variants[rand_r(&vseed) % (sizeof(variants) / sizeof(variants[0]))],
+                        lo);
+            else
+                sprintf(key, "http://origin.test:80/objects/%u", lo);
+            size = (lo * 2654435761u) % 10 < 8 ? 200 + (lo * 40503u) % 3800
+                                                : 8192 + (lo * 40503u) % 94208;
+        }
+        add_req(key, size);
+    }
+    Free(cdf);
+}
+
+/*
+ * add_req - 요청 하나를 reqs에 더함
+ * -u면 키를 parse_uri처럼 호스트, 포트(기본 80), 경로로 나눠 정규화 전
+ * 키("호스트:포트경로")와 url_normalize 키를 둘 다 만든다.
+ */
+static void add_req(char *key, size_t size) {
+    static size_t cap;
+    char host[MAXLINE], port[MAXLINE], raw[3 * MAXLINE], norm[MAXLINE], *p = key, *end;
+    trace_req_t *r;
+    size_t n;
+
+    if (req_count == cap) {
+        cap = cap ? cap * 2 : 1024;
+        reqs = Realloc(reqs, cap * sizeof(trace_req_t));
+    }
+    r = &reqs[req_count++];
+    r->size = size;
+    if (!compare_keys) {
+        r->key = strdup(key);
+        r->hash = hash_key(key);
+        return;
+    }
+
+    if (strncasecmp(p, "http://", 7) == 0)
+        p += 7;
+    n = strcspn(p, ":/");
+    snprintf(host, sizeof(host), "%.*s", (int)n, p);
+    p += n;
+    strcpy(port, "80");
+    if (*p == ':') {
+        n = strcspn(++p, "/");
+        snprintf(port, sizeof(port), "%.*s", (int)n, p);
+        p += n;
+    }
+    end = *p ? p : "/";
+    snprintf(raw, sizeof(raw), "%s:%s%s", host, port, end);
+    if (url_normalize(norm, sizeof(norm), host, port, end) < 0)
+        strcpy(norm, raw);
+    r->key = strdup(raw);
+    r->hash = hash_key(raw);
+    r->alt_key = strdup(norm);
+    r->alt_hash = hash_key(norm);
+}
+
+/*
+ * swap_keys - 요청마다 키를 정규화 전 키와 정규화한 키 사이에서 맞바꿈
+ */
+static void swap_keys(void) {
+    unsigned long h;
+    size_t i;
+    char *k;
+
+    for (i = 0; i < req_count; i++) {
+        k = reqs[i].key;
+        reqs[i].key = reqs[i].alt_key;
+        reqs[i].alt_key = k;
+        h = reqs[i].hash;
+        reqs[i].hash = reqs[i].alt_hash;
+        reqs[i].alt_hash = h;
+    }
+    normalized = !normalized;
+}
+
+/*
+ * replay - 정책 name으로 기록 전체를 돌리고 결과 한 줄을 출력
+ * 샤드 선택, 샤드 예산, 최대 객체 크기는 cache_init과 같은 방식이다.
+ */
+static void replay(char *name, int nshards, size_t cache_bytes) {
+    replay_shard_t *shards, *sh;
+    cache_entry_t *e;
+    trace_req_t *r;
+    size_t i, hits = 0, object_limit;
+    unsigned long bytes = 0, hit_bytes = 0;
+    char label[40];
+    int bits = 0, j;
+
+    while ((1 << bits) < nshards)
+        bits++;
+    nshards = 1 << bits;
+    policy_select(name);
+    tinylfu_init();
+    shards = Calloc(nshards, sizeof(replay_shard_t));
+    for (j = 0; j < nshards; j++) {
+        shards[j].capacity = cache_bytes / nshards;
+        policy_init(&shards[j].policy, shards[j].capacity);
+    }
+    object_limit = MAX_OBJECT_SIZE;
+    if (object_limit > shards[0].capacity)
+        object_limit = shards[0].capacity;
+
+    for (i = 0; i < req_count; i++) {
+        r = &reqs[i];
+        sh = bits ? &shards[r->hash >> (64 - bits)] : &shards[0];
+        bytes += r->size;
+        tinylfu_record(r->hash);
+        if ((e = lookup(sh, r)) != NULL && e->size == r->size) {
+            hits++;
+            hit_bytes += r->size;
+            cache_policy->hit(&sh->policy, e);
+            continue;
+        }
+        if (e)                      /* 크기가 바뀌었으면 새 객체로 */
+            drop(sh, e);
+        if (r->size <= object_limit)
+            insert(sh, r);
+    }
+
+    snprintf(label, sizeof(label), "%s%s%s", name, admission ? "+tinylfu" : "",
+             normalized ? "+urlnorm" : "");
+    printf("%-21s %10zu %10zu %7.2f %14lu %14lu %7.2f\n", label, req_count, hits,
+           req_count ? 100.0 * hits / req_count : 0.0, bytes, hit_bytes,
+           bytes ? 100.0 * hit_bytes / bytes : 0.0);
+
+    for (j = 0; j < nshards; j++) {
+        for (i = 0; i < REPLAY_BUCKETS; i++)
+            while (shards[j].buckets[i])
+                drop(&shards[j], shards[j].buckets[i]);
+        Free(shards[j].policy.heap);
+    }
+    Free(shards);
+}
+
+static cache_entry_t *lookup(replay_shard_t *sh, trace_req_t *r) {
+    cache_entry_t *e;
+
+    for (e = sh->buckets[r->hash & (REPLAY_BUCKETS - 1)]; e; e = e->hnext)
+        if (e->hash == r->hash && strcmp(e->key, r->key) == 0)
+            return e;
+    return NULL;
+}
+
+/*
+ * insert - r을 샤드에 넣음. 예산을 넘으면 정책이 고른 객체부터 축출
+ * 승인을 거치면 insert_entry처럼 후보를 정책에서 떼어 모으며 하나씩
+ * 비교하고, 하나라도 r보다 자주 쓰였으면 모두 되돌리고 넣지 않는다.
+ */
+static void insert(replay_shard_t *sh, trace_req_t *r) {
+    static cache_entry_t **taken;
+    static size_t cap;
+    size_t len = strlen(r->key), need = sh->bytes + r->size, ntaken = 0, i;
+    cache_entry_t *e, *victim, **b;
+
+    while (need > sh->capacity && (victim = cache_policy->victim(&sh->policy)) != NULL) {
+        if (admission && !tinylfu_admit(r->hash, victim->hash)) {
+            while (ntaken > 0)
+                cache_policy->restore(&sh->policy, taken[--ntaken]);
+            return;
+        }
+        cache_policy->remove(&sh->policy, victim);
+        if (ntaken == cap) {
+            cap = cap ? cap * 2 : 16;
+            taken = Realloc(taken, cap * sizeof(cache_entry_t *));
+        }
+        taken[ntaken++] = victim;
+        need -= victim->size;
+    }
+    for (i = 0; i < ntaken; i++)
+        unlink_entry(sh, taken[i]);
+
+    e = Calloc(1, sizeof(cache_entry_t) + len + 1);
+    memcpy(e->key, r->key, len + 1);
+    e->hash = r->hash;
+    e->size = r->size;
+    e->key_len = len;
+    b = &sh->buckets[r->hash & (REPLAY_BUCKETS - 1)];
+    e->hnext = *b;
+    *b = e;
+    sh->bytes += e->size;
+    cache_policy->insert(&sh->policy, e);
+}
+
+/*
+ * drop - e를 정책과 버킷에서 빼고 해제
+ */
+static void drop(replay_shard_t *sh, cache_entry_t *e) {
+    cache_policy->remove(&sh->policy, e);
+    unlink_entry(sh, e);
+}
+
+/*
+ * unlink_entry - 정책에서 이미 뗀 e를 버킷에서 빼고 해제
+ */
+static void unlink_entry(replay_shard_t *sh, cache_entry_t *e) {
+    cache_entry_t **pp = &sh->buckets[e->hash & (REPLAY_BUCKETS - 1)];
+
+    while (*pp != e)
+        pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    sh->bytes -= e->size;
+    Free(e);
+}
+
+/*
+ * hash_key - 문자열 키의 64비트 해시 (cache.c와 같은 함수: FNV-1a 뒤 fmix64)
+ */
+static unsigned long hash_key(char *key) {
+    unsigned long h = 14695981039346656037UL;
+
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 1099511628211UL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdUL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53UL;
+    h ^= h >> 33;
+    return h;
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-a] [-u] [-s shards] [-c cache_bytes] [-p clock|lru|slru|gdsf]... "
+            "(-z requests [-V pct] | <trace>)\n", prog);
+    exit(0);
+}
@@ -0,0 +1,120 @@
+/*
+ * sbuf.c - 연결 fd를 넘기는 유한 생산자/소비자 버퍼
+ *
+ * CS:APP의 sbuf를 그대로 따른다. 빈 칸과 항목 수를 csapp의 P/V
+ * 세마포어로 세므로 소비자(작업 스레드)는 항목이 생길 때까지, 생산자는
+ * 빈 칸이 생길 때까지 기다린다. 과부하에서 생산자가 무한정 기다리지
+ * 않도록 sbuf_insert_wait은 정해진 시간만 기다리고 실패를 돌려준다.
+ */
+#include "sbuf.h"
+
+/*
+ * sbuf_init - n칸짜리 빈 버퍼를 만듦
+ */
+void sbuf_init(sbuf_t *sp, int n) {
+    sp->buf = Calloc(n, sizeof(int));
+    sp->n = n;
+    sp->front = sp->rear = 0;
+    Sem_init(&sp->mutex, 0, 1);
+    Sem_init(&sp->slots, 0, n);
+    Sem_init(&sp->items, 0, 0);
+}
+
+void sbuf_deinit(sbuf_t *sp) {
+    Free(sp->buf);
+}
+
+/*
+ * sbuf_insert - 빈 칸이 생길 때까지 기다렸다가 item을 뒤에 넣음
+ */
+void sbuf_insert(sbuf_t *sp, int item) {
+    P(&sp->slots);
+    P(&sp->mutex);
+    sp->buf[sp->rear] = item;
+    sp->rear = (sp->rear + 1) % sp->n;
+    V(&sp->mutex);
+    V(&sp->items);
+}
+
+/*
+ * sbuf_insert_wait - 빈 칸을 최대 wait_ms밀리초 기다려 item을 넣음
+ * 그 안에 빈 칸이 생기지 않으면 넣지 않고 -1
+ */
+int sbuf_insert_wait(sbuf_t *sp, int item, int wait_ms) {
+    struct timespec deadline;
+    int rc;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += wait_ms / 1000;
+    deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while ((rc = sem_timedwait(&sp->slots, &deadline)) < 0 && errno == EINTR)
+        ;
+    if (rc < 0)
+        return -1;
+
+    P(&sp->mutex);
+    sp->buf[sp->rear] = item;
+    sp->rear = (sp->rear + 1) % sp->n;
+    V(&sp->mutex);
+    V(&sp->items);
+    return 0;
+}
+
+/*
+ * sbuf_remove - 항목이 생길 때까지 기다렸다가 첫 항목을 꺼냄
+ */
+int sbuf_remove(sbuf_t *sp) {
+    int item;
+
+    P(&sp->items);
+    P(&sp->mutex);
+    item = sp->buf[sp->front];
+    sp->front = (sp->front + 1) % sp->n;
+    V(&sp->mutex);
+    V(&sp->slots);
+    return item;
+}
+
+/*
+ * sbuf_try_remove - 기다리지 않고 앞에서부터 최대 max개를 items에 꺼냄
+ * 꺼낸 수를 반환 (비었으면 0). 꺼낸 항목의 칸은 sbuf_release로 돌려줄
+ * 때까지 빈 칸으로 세지 않으므로, 꺼낸 뒤 아직 처리하지 않은 항목도
+ * 버퍼 깊이에 든다.
+ */
+int sbuf_try_remove(sbuf_t *sp, int *items, int max) {
+    int i, n = 0;
+
+    while (n < max && sem_trywait(&sp->items) == 0)
+        n++;
+    if (n == 0)
+        return 0;
+    P(&sp->mutex);
+    for (i = 0; i < n; i++) {
+        items[i] = sp->buf[sp->front];
+        sp->front = (sp->front + 1) % sp->n;
+    }
+    V(&sp->mutex);
+    return n;
+}
+
+/*
+ * sbuf_release - sbuf_try_remove로 꺼낸 항목 n개의 칸을 빈 칸으로 돌려줌
+ */
+void sbuf_release(sbuf_t *sp, int n) {
+    while (n-- > 0)
+        V(&sp->slots);
+}
+
+/*
+ * sbuf_count - 지금 들어 있는 항목 수 (어림값)
+ */
+int sbuf_count(sbuf_t *sp) {
+    int n;
+
+    sem_getvalue(&sp->items, &n);
+    return n < 0 ? 0 : n;
+}
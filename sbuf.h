@@ -0,0 +1,28 @@
+/*
+ * sbuf.h - 연결 fd를 넘기는 유한 생산자/소비자 버퍼 인터페이스
+ */
+#ifndef __SBUF_H__
+#define __SBUF_H__
+
+#include "csapp.h"
+
+typedef struct {
+    int *buf;                       /* 원형 버퍼 */
+    int n;                          /* 칸 수 */
+    int front;                      /* 첫 항목 위치 */
+    int rear;                       /* 다음에 넣을 위치 */
+    sem_t mutex;                    /* buf 접근 보호 */
+    sem_t slots;                    /* 빈 칸 수 */
+    sem_t items;                    /* 항목 수 */
+} sbuf_t;
+
+void sbuf_init(sbuf_t *sp, int n);
+void sbuf_deinit(sbuf_t *sp);
+void sbuf_insert(sbuf_t *sp, int item);
+int sbuf_insert_wait(sbuf_t *sp, int item, int wait_ms);
+int sbuf_remove(sbuf_t *sp);
+int sbuf_try_remove(sbuf_t *sp, int *items, int max);
+void sbuf_release(sbuf_t *sp, int n);
+int sbuf_count(sbuf_t *sp);
+
+#endif /* __SBUF_H__ */
@@ -0,0 +1,258 @@
+/*
+ * sched.c - 작업 훔치기(work-stealing) 스케줄러
+ *
+ * 공용 큐 하나를 모든 작업 스레드가 나눠 쓰면 작업마다 같은 락을 잡고,
+ * 작업을 고정해 나눠 주면 무거운 전송 몇 개가 몰린 스레드 뒤에서 다른
+ * 작업이 기다린다. 여기서는 작업 스레드마다 Chase-Lev 덱을 둔다.
+ *
+ * - 생산자(연결 수락 스레드, 이벤트 엔진, 관리 포트)는 정해진 깊이의 공용
+ *   큐(sbuf)에 작업을 넣는다. 자리가 없으면 실패를 돌려주어 503으로
+ *   거절할 수 있게 한다. 덱으로 옮긴 작업도 시작할 때까지 공용 큐의
+ *   칸을 차지하므로, 거절 경계는 덱과 관계없이 시작 전 작업 depth개이다.
+ * - 자기 덱이 빈 작업 스레드는 먼저 무작위로 고른 상대부터 차례로 덱의
+ *   top에서 훔친다. 오래 걸리는 작업을 잡은 스레드의 덱에 남은 작업은
+ *   이렇게 쉬는 스레드가 공용 큐보다 먼저 가져가므로 그 뒤에서 기다리지
+ *   않는다.
+ * - 훔칠 것이 없으면 공용 큐에서 (큐 길이 / 스레드 수 + 1)개, 많아야
+ *   SCHED_BATCH개를 한 번에 가져와 하나는 바로 처리하고 나머지는 자기
+ *   덱에 넣는다. 덱의 작업은 주인이 bottom에서 하나씩 꺼낸다.
+ * - 가져올 것도 없으면 세마포어에서 잔다. 작업을 덱에 넣은 스레드와 공용
+ *   큐에 넣은 생산자는 자는 스레드가 있을 때만 깨운다. 자러 가는 스레드는
+ *   잠든 수를 먼저 올린 뒤 한 번 더 찾아보므로 깨움을 놓치지 않는다.
+ *
+ * 작업은 음이 아닌 int 하나이며 뜻은 run 콜백이 정한다. 프록시에서는 연결
+ * 하나가 작업 하나이다. 파싱, 캐시 조회, 연결, 중계를 나눈 작업이 아니므로
+ * 큰 전송을 맡은 스레드는 그것이 끝날 때까지 묶이고, 훔치기는 그 스레드의
+ * 덱에 남은 연결만 구한다. 작업 스레드 수(-t)가 동시에 진행 중인 큰 전송
+ * 수보다 넉넉해야 작은 요청의 꼬리 지연이 지켜진다.
+ */
+#include "sched.h"
+
+#define EMPTY (-1)
+#define ABORT (-2)                  /* 다른 도둑과 경쟁에서 짐: 다시 시도 */
+
+static sched_worker_t *workers;
+static int nworkers;
+static void (*run_task)(int task);
+static sbuf_t inject;               /* 생산자가 넣는 공용 큐 */
+static sem_t wake;                  /* 자는 작업 스레드를 깨움 */
+static int sleepers;                /* 자는(자러 가는) 작업 스레드 수 */
+
+static void *sched_worker(void *vargp);
+static int refill(sched_worker_t *w);
+static int steal(sched_worker_t *w);
+static void wake_up(int n);
+static int deque_push(deque_t *q, int task);
+static int deque_pop(deque_t *q);
+static int deque_steal(deque_t *q);
+
+/*
+ * sched_init - 공용 큐(depth칸)를 만들고 작업 스레드 count개를 띄움
+ */
+void sched_init(int count, int depth, void (*run)(int task)) {
+    pthread_t tid;
+    int i;
+
+    run_task = run;
+    nworkers = count;
+    workers = Calloc(nworkers, sizeof(sched_worker_t));
+    sbuf_init(&inject, depth);
+    Sem_init(&wake, 0, 0);
+    for (i = 0; i < nworkers; i++) {
+        workers[i].seed = i * 2654435761u + 1;
+        Pthread_create(&tid, NULL, sched_worker, &workers[i]);
+    }
+}
+
+/*
+ * sched_submit - 작업을 공용 큐에 넣고 자는 스레드를 하나 깨움
+ * 자리를 wait_ms밀리초 기다려도 없으면 -1. wait_ms가 음수면 자리가 날
+ * 때까지 기다린다.
+ */
+int sched_submit(int task, int wait_ms) {
+    if (wait_ms < 0)
+        sbuf_insert(&inject, task);
+    else if (sbuf_insert_wait(&inject, task, wait_ms) < 0)
+        return -1;
+    wake_up(1);
+    return 0;
+}
+
+/*
+ * sched_stats - 작업 스레드별 처리한 작업, 훔친 작업, 덱 길이를 fd에 씀
+ */
+void sched_stats(int fd) {
+    char line[MAXLINE];
+    unsigned long ran, lo = ~0UL, hi = 0, total = 0, stolen = 0;
+    long depth;
+    int i, n;
+
+    if (!workers)
+        return;
+    n = snprintf(line, sizeof(line), "\nsched: 작업 스레드 %d개, 공용 큐 %d개\n"
+                 "%4s %12s %12s %6s\n", nworkers, sbuf_count(&inject),
+                 "id", "ran", "stolen", "deque");
+    rio_writen(fd, line, n);
+    for (i = 0; i < nworkers; i++) {
+        depth = __atomic_load_n(&workers[i].dq.bottom, __ATOMIC_RELAXED) -
+                __atomic_load_n(&workers[i].dq.top, __ATOMIC_RELAXED);
+        ran = __atomic_load_n(&workers[i].ran, __ATOMIC_RELAXED);
+        lo = ran < lo ? ran : lo;
+        hi = ran > hi ? ran : hi;
+        total += ran;
+        stolen += __atomic_load_n(&workers[i].stolen, __ATOMIC_RELAXED);
+        n = snprintf(line, sizeof(line), "%4d %12lu %12lu %6ld\n", i, ran,
+                     __atomic_load_n(&workers[i].stolen, __ATOMIC_RELAXED),
+                     depth < 0 ? 0 : depth);
+        rio_writen(fd, line, n);
+    }
+    /* 치우침: 가장 많이/적게 처리한 스레드와 평균의 비 */
+    n = snprintf(line, sizeof(line), "ran min %lu max %lu, max/mean %.2f, 훔친 작업 %.1f%%\n",
+                 lo, hi, total ? (double)hi * nworkers / total : 0,
+                 total ? 100.0 * stolen / total : 0);
+    rio_writen(fd, line, n);
+}
+
+/*
+ * sched_worker - 작업 스레드 루틴: 자기 덱, 남의 덱, 공용 큐 순으로 찾아 처리
+ * 작업을 시작할 때 그 작업이 차지하던 공용 큐 칸을 돌려준다.
+ */
+static void *sched_worker(void *vargp) {
+    sched_worker_t *w = vargp;
+    int task;
+
+    Pthread_detach(pthread_self());
+    while (1) {
+        if ((task = deque_pop(&w->dq)) == EMPTY && (task = steal(w)) == EMPTY &&
+            (task = refill(w)) == EMPTY) {
+            __atomic_add_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+            if ((task = steal(w)) == EMPTY && (task = refill(w)) == EMPTY) {
+                P(&wake);
+                __atomic_sub_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+                continue;
+            }
+            __atomic_sub_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+        }
+        sbuf_release(&inject, 1);
+        run_task(task);
+        __atomic_add_fetch(&w->ran, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/*
+ * refill - 공용 큐에서 작업을 묶어 가져옴: 첫 작업을 반환하고 나머지는 덱에
+ * 넣은 뒤 그만큼 자는 스레드를 깨워 훔쳐 가게 한다. 비었으면 EMPTY
+ */
+static int refill(sched_worker_t *w) {
+    int tasks[SCHED_BATCH];
+    int i, n;
+
+    n = sbuf_count(&inject) / nworkers + 1;
+    if (n > SCHED_BATCH)
+        n = SCHED_BATCH;
+    if ((n = sbuf_try_remove(&inject, tasks, n)) == 0)
+        return EMPTY;
+    /* 거꾸로 넣어 주인은 온 순서대로 꺼내고 도둑은 늦게 온 것부터 가져감.
+     * 덱이 비었을 때만 부르므로 SCHED_BATCH개는 늘 들어간다. */
+    for (i = n - 1; i > 0; i--)
+        deque_push(&w->dq, tasks[i]);
+    wake_up(n - 1);
+    return tasks[0];
+}
+
+/*
+ * steal - 무작위로 고른 상대부터 모든 덱을 한 번씩 훔쳐 봄. 없으면 EMPTY
+ */
+static int steal(sched_worker_t *w) {
+    int i, start, task;
+    sched_worker_t *v;
+
+    w->seed ^= w->seed << 13;
+    w->seed ^= w->seed >> 17;
+    w->seed ^= w->seed << 5;
+    start = w->seed % nworkers;
+    for (i = 0; i < nworkers; i++) {
+        v = &workers[(start + i) % nworkers];
+        if (v == w)
+            continue;
+        while ((task = deque_steal(&v->dq)) == ABORT)
+            ;
+        if (task != EMPTY) {
+            __atomic_add_fetch(&w->stolen, 1, __ATOMIC_RELAXED);
+            return task;
+        }
+    }
+    return EMPTY;
+}
+
+/*
+ * wake_up - 자는 스레드를 많아야 n개 깨움
+ */
+static void wake_up(int n) {
+    int s = __atomic_load_n(&sleepers, __ATOMIC_SEQ_CST);
+
+    for (n = n < s ? n : s; n > 0; n--)
+        V(&wake);
+}
+
+/*
+ * deque_push - 주인이 bottom에 작업을 넣음. 가득 찼으면 -1
+ */
+static int deque_push(deque_t *q, int task) {
+    long b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+
+    if (b - t >= SCHED_DEQUE)
+        return -1;
+    __atomic_store_n(&q->buf[b & (SCHED_DEQUE - 1)], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+ * deque_pop - 주인이 bottom에서 작업을 꺼냄. 마지막 하나는 도둑과 top을
+ * 두고 CAS로 겨룬다. 비었으면 EMPTY
+ */
+static int deque_pop(deque_t *q) {
+    long b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED) - 1;
+    long t;
+    int task;
+
+    __atomic_store_n(&q->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+    if (t > b) {
+        __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+        return EMPTY;
+    }
+    task = __atomic_load_n(&q->buf[b & (SCHED_DEQUE - 1)], __ATOMIC_RELAXED);
+    if (t == b) {
+        if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED))
+            task = EMPTY;
+        __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+/*
+ * deque_steal - 다른 스레드가 top에서 작업을 훔침
+ * 비었으면 EMPTY, 다른 스레드와 경쟁에서 졌으면 ABORT
+ */
+static int deque_steal(deque_t *q) {
+    long t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+    long b;
+    int task;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b)
+        return EMPTY;
+    task = __atomic_load_n(&q->buf[t & (SCHED_DEQUE - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED))
+        return ABORT;
+    return task;
+}
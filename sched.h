@@ -0,0 +1,31 @@
+/*
+ * sched.h - 작업 훔치기(work-stealing) 스케줄러 인터페이스
+ */
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include "csapp.h"
+#include "sbuf.h"
+
+#define SCHED_DEQUE 64              /* 작업 스레드별 덱 칸 수 (2의 거듭제곱) */
+#define SCHED_BATCH 16              /* 공용 큐에서 한 번에 가져올 최대 작업 수 */
+
+/* Chase-Lev 덱: 주인은 bottom에서 넣고 빼며, 다른 스레드는 top에서 훔친다 */
+typedef struct {
+    long top;
+    long bottom;
+    int buf[SCHED_DEQUE];
+} deque_t;
+
+typedef struct {
+    deque_t dq;
+    unsigned seed;                  /* 훔칠 상대를 고르는 난수 상태 */
+    unsigned long ran;              /* 처리한 작업 수 */
+    unsigned long stolen;           /* 그중 훔친 작업 수 */
+} sched_worker_t;
+
+void sched_init(int count, int depth, void (*run)(int task));
+int sched_submit(int task, int wait_ms);
+void sched_stats(int fd);
+
+#endif /* __SCHED_H__ */
@@ -0,0 +1,596 @@
+/*
+ * slab.c - 캐시 객체 본문용 슬랩 할당기
+ *
+ * 객체마다 Malloc으로 최대 MAX_OBJECT_SIZE까지 잡았다 풀면 힙이 조각나
+ * 프로세스 메모리가 캐시 예산보다 훨씬 커진다. 이 할당기는 시작할 때
+ * 예산 크기의 아레나 하나를 mmap으로 잡아 SLAB_PAGE_SIZE 페이지로 나누고,
+ * 연속 페이지 덩어리를 크기 클래스별 같은 크기 청크로 잘라 쓴다. 따라서
+ * 캐시 본문이 차지하는 메모리는 아레나 크기를 넘지 않는다.
+ *
+ * - 크기 클래스: SLAB_MIN_CHUNK부터 1.25배씩 늘려 가장 큰 객체까지.
+ *   요청 크기에 맞는 가장 작은 클래스에서 청크를 준다.
+ * - 덩어리: 클래스마다 청크 하나 이상이 들어가고 끝 자투리가 1/SLAB_SPAN_WASTE
+ *   이하인 가장 적은 연속 페이지 수를 정해 둔다. 작은 클래스는 한
+ *   페이지, 페이지보다 큰 청크는 여러 페이지에 걸친다. 페이지가 작아
+ *   약 1MB 예산에서도 클래스마다 덩어리를 가질 수 있다.
+ * - 아레나: 필요할 때 연속한 빈 페이지를 찾아 클래스로 가져오고, 청크가
+ *   모두 풀리면 다시 아레나로 돌려 다른 클래스가 쓸 수 있게 한다.
+ * - 클래스별 축출: 클래스에 빈 청크도 빈 덩어리도 없으면 그 클래스에서
+ *   가장 오래 할당된 청크의 주인을 evict 콜백으로 캐시에서 빼낸다.
+ * - 페이지 재배치: 클래스가 축출할 객체조차 없으면(덩어리 0개) 페이지를
+ *   가장 많이 가진 클래스의 가장 오래된 덩어리에서 시작해 필요한 만큼의
+ *   연속 페이지에 걸친 객체를 모두 비워 아레나로 돌린다. 한번 페이지를
+ *   받지 못한 클래스가 영영 굶지 않게 한다.
+ *
+ * 아레나는 memfd로 만든 익명 파일을 MAP_SHARED로 매핑한다. 청크가 파일의
+ * 어느 위치인지 알 수 있으므로(slab_locate) 적중 응답을 sendfile로 사용자
+ * 공간 복사 없이 소켓에 보낼 수 있다. memfd를 못 쓰면 익명 매핑으로 돌아간다.
+ * sendfile은 페이지를 복사하지 않고 참조만 소켓 큐에 넣으므로, 받는 쪽이
+ * 읽기 전에 청크를 다시 쓰면 보낸 응답이 바뀐다. 그래서 sendfile로는 청크
+ * 안에 통째로 든 memfd 페이지만 보내고(앞뒤 조각은 복사), 청크를 새로
+ * 할당할 때 그 안의 통째 페이지를, 슬랩 페이지를 아레나로 돌릴 때 페이지
+ * 전체를 memfd에서 구멍 내(FALLOC_FL_PUNCH_HOLE) 떼어 낸다. 소켓 큐가 잡은
+ * 옛 페이지는 그대로 남고 새로 쓰는 바이트는 새 페이지에 들어간다.
+ *
+ * 락은 클래스마다 하나, 아레나에 하나이다. 적중 경로는 할당기를 거치지
+ * 않으며, 할당과 해제는 해당 클래스 락만 잡는다. pin/evict 콜백은 클래스
+ * 락 안에서 pin만 부르고 evict는 락을 놓은 뒤 부른다.
+ */
+#include "slab.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/memfd.h>
+#include <linux/falloc.h>
+
+/* 청크 머리: 청크 앞에 붙으며 본문은 바로 뒤에서 시작 */
+typedef struct slab_chunk {
+    void *owner;                    /* 축출 시 넘길 캐시 객체 (NULL이면 축출 대상 아님) */
+    struct slab_chunk *prev;        /* 할당 중: 클래스의 할당 순서 목록 */
+    struct slab_chunk *next;        /* 빈 청크: 페이지의 빈 목록 */
+    size_t size;                    /* 요청 크기 */
+} slab_chunk_t;
+
+/* 페이지 서술자: 아레나 밖의 배열에 둔다. 덩어리 상태는 첫 페이지에 */
+typedef struct slab_page {
+    int cls;                        /* 소속 클래스 (-1이면 아레나의 빈 페이지) */
+    unsigned used;                  /* 할당된 청크 수 */
+    unsigned carved;                /* 지금까지 잘라 낸 청크 수 */
+    slab_chunk_t *free;             /* 해제된 청크 목록 */
+    struct slab_page *prev, *next;  /* 클래스의 빈 자리 있는 덩어리 목록 */
+    struct slab_page *head;         /* 덩어리의 첫 페이지 (빈 페이지는 자기 자신) */
+} slab_page_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t chunk;                   /* 청크 크기 (머리 포함) */
+    unsigned span;                  /* 덩어리 하나의 연속 페이지 수 */
+    unsigned per_span;              /* 덩어리당 청크 수 */
+    slab_page_t *partial;           /* 빈 자리가 있는 덩어리 */
+    slab_chunk_t *oldest, *newest;  /* 할당 순서 목록 (축출 순서) */
+    size_t pages;                   /* 이 클래스가 가진 페이지 수 */
+    size_t used;                    /* 할당된 청크 수 */
+    size_t requested;               /* 할당된 청크의 요청 바이트 합 */
+    unsigned long evictions;        /* 이 클래스 때문에 축출한 객체 수 */
+    unsigned long failures;         /* 축출로도 자리를 못 만든 할당 수 */
+} slab_class_t;
+
+static char *arena;
+static int arena_fd = -1;           /* 아레나를 담은 memfd (-1이면 익명 매핑) */
+static size_t punch_unit;           /* memfd 페이지 크기 (0이면 sendfile을 쓰지 않음) */
+static size_t page_count;
+static slab_page_t *pages;
+static size_t free_page_count;
+static size_t next_fit;             /* 빈 페이지를 찾기 시작할 위치 */
+static unsigned max_per_span;       /* 클래스 중 가장 많은 덩어리당 청크 수 */
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static slab_class_t classes[SLAB_MAX_CLASSES];
+static int class_count;
+static int (*pin_owner)(void *owner, void *ctx);
+static void (*evict_owner)(void *owner);
+
+static int class_of(size_t chunk);
+static slab_chunk_t *take_chunk(slab_class_t *c, int cls);
+static slab_page_t *page_of(slab_chunk_t *ch);
+static void partial_unlink(slab_class_t *c, slab_page_t *pg);
+static void partial_push(slab_class_t *c, slab_page_t *pg);
+static void steal_pages(int cls, void *ctx);
+static slab_page_t *take_span(unsigned span, int cls);
+static void put_span(slab_page_t *pg, unsigned span);
+static unsigned span_of(size_t chunk);
+static char *map_arena(size_t size, int huge);
+static void punch(char *start, char *end);
+
+/*
+ * slab_init - 아레나를 잡고 크기 클래스를 만든다. 스레드를 만들기 전에 호출.
+ * arena_size는 페이지 단위로 올림한다. hugepages면 거대 페이지 memfd로
+ * 잡아 보고 안 되면 일반 페이지에 투명 거대 페이지를 권고한다.
+ * pin은 축출 후보의 주인이 아직 살아 있고 slab_alloc에 받은 ctx로 보아
+ * 축출해도 되면 참조를 잡고 1을 반환하며, evict는 그 주인을 캐시에서
+ * 빼고 pin이 잡은 참조를 놓는다.
+ */
+void slab_init(size_t arena_size, size_t max_object, int hugepages,
+               int (*pin)(void *owner, void *ctx), void (*evict)(void *owner)) {
+    size_t chunk, top = max_object + sizeof(slab_chunk_t);
+    size_t i;
+
+    if (top > SLAB_MAX_SPAN * SLAB_PAGE_SIZE)
+        app_error("slab: 최대 객체가 가장 큰 덩어리보다 큽니다");
+
+    arena_size = (arena_size + SLAB_PAGE_SIZE - 1) & ~(size_t)(SLAB_PAGE_SIZE - 1);
+    arena = MAP_FAILED;
+    if (hugepages) {
+        size_t huge = (arena_size + SLAB_HUGE_PAGE - 1) & ~(size_t)(SLAB_HUGE_PAGE - 1);
+        if ((arena = map_arena(huge, 1)) != MAP_FAILED)
+            arena_size = huge;
+    }
+    if (arena == MAP_FAILED) {
+        if ((arena = map_arena(arena_size, 0)) == MAP_FAILED)
+            unix_error("slab: mmap 실패");
+#ifdef MADV_HUGEPAGE
+        if (hugepages)
+            madvise(arena, arena_size, MADV_HUGEPAGE);
+#endif
+        if (arena_fd >= 0)
+            punch_unit = sysconf(_SC_PAGESIZE);
+    } else {
+        punch_unit = SLAB_HUGE_PAGE;
+    }
+    pin_owner = pin;
+    evict_owner = evict;
+
+    page_count = arena_size / SLAB_PAGE_SIZE;
+    pages = Calloc(page_count, sizeof(slab_page_t));
+    for (i = 0; i < page_count; i++) {
+        pages[i].cls = -1;
+        pages[i].head = &pages[i];
+    }
+    free_page_count = page_count;
+
+    /* 크기 클래스: 16바이트 정렬, 마지막 클래스는 최대 객체에 꼭 맞춤 */
+    for (chunk = SLAB_MIN_CHUNK; class_count < SLAB_MAX_CLASSES - 1 && chunk < top; ) {
+        classes[class_count++].chunk = chunk;
+        chunk = (chunk + chunk / SLAB_GROWTH_DIV + 15) & ~(size_t)15;
+    }
+    classes[class_count++].chunk = (top + 15) & ~(size_t)15;
+    for (i = 0; i < class_count; i++) {
+        pthread_mutex_init(&classes[i].lock, NULL);
+        classes[i].span = span_of(classes[i].chunk);
+        classes[i].per_span = classes[i].span * SLAB_PAGE_SIZE / classes[i].chunk;
+        if (classes[i].per_span > max_per_span)
+            max_per_span = classes[i].per_span;
+    }
+}
+
+/*
+ * slab_alloc - size바이트를 담을 청크를 할당. 자리가 없으면 같은 클래스의
+ * 가장 오래된 객체부터 축출하며, 그래도 안 되면 NULL
+ * ctx는 축출 후보마다 pin 콜백에 그대로 넘긴다(누가 할당하는지).
+ */
+void *slab_alloc(size_t size, void *ctx) {
+    int cls = class_of(size + sizeof(slab_chunk_t));
+    slab_class_t *c;
+    slab_chunk_t *ch, *victim;
+    void *owner;
+    int tries;
+
+    if (cls < 0)
+        return NULL;
+    c = &classes[cls];
+
+    for (tries = 0; ; tries++) {
+        pthread_mutex_lock(&c->lock);
+        if ((ch = take_chunk(c, cls)) != NULL) {
+            ch->owner = NULL;
+            ch->size = size;
+            ch->next = NULL;
+            ch->prev = c->newest;
+            if (c->newest)
+                c->newest->next = ch;
+            else
+                c->oldest = ch;
+            c->newest = ch;
+            c->used++;
+            c->requested += size;
+            pthread_mutex_unlock(&c->lock);
+            punch((char *)(ch + 1), (char *)ch + c->chunk);
+            return ch + 1;
+        }
+
+        if (tries >= SLAB_EVICT_TRIES) {
+            c->failures++;
+            pthread_mutex_unlock(&c->lock);
+            return NULL;
+        }
+
+        /* 클래스 안에서 축출: 주인이 살아 있는 가장 오래된 청크 */
+        owner = NULL;
+        for (victim = c->oldest; victim; victim = victim->next) {
+            if (victim->owner && pin_owner(victim->owner, ctx)) {
+                owner = victim->owner;
+                victim->owner = NULL;       /* 다시 고르지 않도록 */
+                c->evictions++;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&c->lock);
+
+        if (owner)
+            evict_owner(owner);
+        else
+            steal_pages(cls, ctx);
+    }
+}
+
+/*
+ * slab_set_owner - 청크를 축출할 때 evict 콜백에 넘길 주인을 지정
+ */
+void slab_set_owner(void *p, void *owner) {
+    slab_chunk_t *ch = (slab_chunk_t *)p - 1;
+    slab_class_t *c = &classes[page_of(ch)->cls];
+
+    pthread_mutex_lock(&c->lock);
+    ch->owner = owner;
+    pthread_mutex_unlock(&c->lock);
+}
+
+/*
+ * slab_free - 청크를 덩어리로 돌려줌. 덩어리가 비면 아레나로 돌려준다.
+ */
+void slab_free(void *p) {
+    slab_chunk_t *ch = (slab_chunk_t *)p - 1;
+    slab_page_t *pg = page_of(ch);
+    slab_class_t *c = &classes[pg->cls];
+
+    pthread_mutex_lock(&c->lock);
+    if (ch->prev)
+        ch->prev->next = ch->next;
+    else
+        c->oldest = ch->next;
+    if (ch->next)
+        ch->next->prev = ch->prev;
+    else
+        c->newest = ch->prev;
+    c->used--;
+    c->requested -= ch->size;
+    ch->owner = NULL;
+
+    /* 가득 찼던 덩어리는 다시 빈 자리 목록으로 */
+    if (pg->used == c->per_span)
+        partial_push(c, pg);
+    ch->next = pg->free;
+    pg->free = ch;
+
+    if (--pg->used == 0) {
+        partial_unlink(c, pg);
+        c->pages -= c->span;
+        pg->free = NULL;
+        pg->carved = 0;
+        put_span(pg, c->span);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+/*
+ * slab_locate - 청크 p에 든 size바이트 중 sendfile로 보내도 되는 구간
+ * *offp는 p의 memfd 안 위치이고, [*startp, *endp)는 청크 안에 통째로 든
+ * memfd 페이지만 덮는다. 그 앞뒤 조각은 메모리에서 복사해 보내야 한다.
+ * 그런 구간이 없거나 익명 매핑이면 -1
+ */
+int slab_locate(void *p, size_t size, int *fdp, off_t *offp, size_t *startp,
+                size_t *endp) {
+    size_t off = (char *)p - arena;
+    size_t start, end;
+
+    if (!__atomic_load_n(&punch_unit, __ATOMIC_RELAXED))
+        return -1;
+    start = (off + punch_unit - 1) / punch_unit * punch_unit;
+    end = (off + size) / punch_unit * punch_unit;
+    if (start >= end)
+        return -1;
+    *fdp = arena_fd;
+    *offp = off;
+    *startp = start - off;
+    *endp = end - off;
+    return 0;
+}
+
+/*
+ * slab_stats - 클래스별 사용량을 텍스트 표로 fd에 씀
+ * 활용률은 요청 바이트 합 / (할당 청크 수 * 청크 크기)이다.
+ */
+void slab_stats(int fd) {
+    char line[MAXLINE];
+    size_t total_used = 0, total_requested = 0, total_pages = 0;
+    size_t used, requested, pages_held, chunk;
+    unsigned long evictions, failures;
+    int i, n;
+
+    n = snprintf(line, sizeof(line), "slab: 아레나 %zu페이지 x %d바이트, 빈 페이지 %zu\n"
+                 "%5s %8s %4s %6s %8s %8s %6s %10s %10s\n",
+                 page_count, SLAB_PAGE_SIZE, free_page_count, "class", "chunk", "span",
+                 "pages", "used", "total", "util%", "evictions", "failures");
+    rio_writen(fd, line, n);
+
+    for (i = 0; i < class_count; i++) {
+        slab_class_t *c = &classes[i];
+
+        pthread_mutex_lock(&c->lock);
+        chunk = c->chunk;
+        pages_held = c->pages;
+        used = c->used;
+        requested = c->requested;
+        evictions = c->evictions;
+        failures = c->failures;
+        pthread_mutex_unlock(&c->lock);
+
+        if (pages_held == 0 && evictions == 0 && failures == 0)
+            continue;
+        total_pages += pages_held;
+        total_used += used * chunk;
+        total_requested += requested;
+        n = snprintf(line, sizeof(line), "%5d %8zu %4u %6zu %8zu %8zu %6.1f %10lu %10lu\n",
+                     i, chunk, c->span, pages_held, used,
+                     pages_held / c->span * c->per_span,
+                     used ? 100.0 * requested / (used * chunk) : 0.0, evictions, failures);
+        rio_writen(fd, line, n);
+    }
+
+    n = snprintf(line, sizeof(line), "합계: 페이지 %zu, 청크 %zu바이트 중 요청 %zu바이트 (%.1f%%)\n",
+                 total_pages, total_used, total_requested,
+                 total_used ? 100.0 * total_requested / total_used : 0.0);
+    rio_writen(fd, line, n);
+}
+
+/*
+ * steal_pages - 페이지를 가장 많이 가진 다른 클래스의 가장 오래된 청크가 든
+ * 덩어리부터 cls의 덩어리 크기만큼 연속한 페이지에 걸친 객체를 모두 축출.
+ * 걸친 덩어리는 통째로 비우며, 읽는 스레드가 놓는 대로 덩어리가 비어
+ * 아레나로 돌아온다. 클래스 락을 잡지 않은 상태에서 호출하며, 한 번에
+ * 클래스 락 하나만 잡는다.
+ */
+static void steal_pages(int cls, void *ctx) {
+    slab_class_t *v = NULL, *c;
+    slab_page_t *pg, *last = NULL;
+    slab_chunk_t *ch;
+    size_t start, most = 0, span = classes[cls].span, i;
+    void **owners;
+    unsigned j, n = 0;
+    int k;
+    char *base;
+
+    for (k = 0; k < class_count; k++) {
+        if (k != cls && classes[k].pages > most) {  /* 대략적인 값이면 충분 */
+            most = classes[k].pages;
+            v = &classes[k];
+        }
+    }
+    if (!v || span > page_count)
+        return;
+    pthread_mutex_lock(&v->lock);
+    start = v->oldest ? (size_t)(page_of(v->oldest) - pages) : page_count;
+    pthread_mutex_unlock(&v->lock);
+    if (start >= page_count)
+        return;
+    if (start + span > page_count)
+        start = page_count - span;
+
+    /* 페이지 span개에 걸친 덩어리는 많아야 span개 */
+    owners = Malloc(span * max_per_span * sizeof(void *));
+    for (i = start; i < start + span; i++) {
+        if ((k = pages[i].cls) < 0)
+            continue;
+        c = &classes[k];
+        pthread_mutex_lock(&c->lock);
+        pg = pages[i].head;
+        if (pages[i].cls == k && pg != last) {     /* 락을 잡는 사이 바뀌지 않았으면 */
+            last = pg;
+            base = arena + (pg - pages) * (size_t)SLAB_PAGE_SIZE;
+            for (j = 0; j < pg->carved; j++) {
+                ch = (slab_chunk_t *)(base + j * c->chunk);
+                if (ch->owner && pin_owner(ch->owner, ctx)) {
+                    owners[n++] = ch->owner;
+                    ch->owner = NULL;
+                    c->evictions++;
+                }
+            }
+        }
+        pthread_mutex_unlock(&c->lock);
+    }
+
+    for (j = 0; j < n; j++)
+        evict_owner(owners[j]);
+    Free(owners);
+}
+
+/*
+ * take_span - 아레나에서 연속한 빈 페이지 span개를 찾아 클래스 cls에 줌
+ * 지난번에 찾은 자리 다음부터 한 바퀴 훑는다(next fit). 없으면 NULL
+ */
+static slab_page_t *take_span(unsigned span, int cls) {
+    slab_page_t *pg = NULL;
+    size_t i, n, run = 0;
+
+    pthread_mutex_lock(&arena_lock);
+    if (free_page_count >= span) {
+        for (i = next_fit, n = 0; n < page_count + span; i++, n++) {
+            if (i >= page_count) {
+                i = 0;
+                run = 0;
+            }
+            run = pages[i].cls < 0 ? run + 1 : 0;
+            if (run == span) {
+                pg = &pages[i + 1 - span];
+                break;
+            }
+        }
+    }
+    if (pg) {
+        for (i = 0; i < span; i++) {
+            pg[i].cls = cls;
+            pg[i].head = pg;
+        }
+        free_page_count -= span;
+        next_fit = (pg - pages) + span;
+    }
+    pthread_mutex_unlock(&arena_lock);
+    return pg;
+}
+
+/*
+ * put_span - 빈 덩어리를 아레나로 돌려줌 (덩어리 클래스의 락을 잡은 상태)
+ * 다른 클래스는 청크 경계가 다르므로 memfd에서 먼저 통째로 떼어 낸다.
+ */
+static void put_span(slab_page_t *pg, unsigned span) {
+    char *base = arena + (pg - pages) * (size_t)SLAB_PAGE_SIZE;
+    unsigned i;
+
+    punch(base, base + span * (size_t)SLAB_PAGE_SIZE);
+    pthread_mutex_lock(&arena_lock);
+    for (i = 0; i < span; i++) {
+        pg[i].cls = -1;
+        pg[i].head = &pg[i];
+    }
+    free_page_count += span;
+    pthread_mutex_unlock(&arena_lock);
+}
+
+/*
+ * span_of - chunk바이트 청크를 자를 덩어리의 페이지 수
+ * 청크 하나 이상이 들어가면서 끝 자투리가 1/SLAB_SPAN_WASTE 이하인 가장
+ * 작은 수. SLAB_MAX_SPAN까지 없으면 자투리 비율이 가장 작은 수
+ */
+static unsigned span_of(size_t chunk) {
+    unsigned k, best = 0;
+    size_t bytes, waste, best_waste = 0, best_bytes = 1;
+
+    for (k = (chunk + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE; k <= SLAB_MAX_SPAN; k++) {
+        bytes = k * (size_t)SLAB_PAGE_SIZE;
+        waste = bytes % chunk;
+        if (waste * SLAB_SPAN_WASTE <= bytes)
+            return k;
+        if (!best || waste * best_bytes < best_waste * bytes) {
+            best = k;
+            best_waste = waste;
+            best_bytes = bytes;
+        }
+    }
+    return best;
+}
+
+/*
+ * map_arena - memfd를 만들어 size바이트로 늘리고 공유 매핑. memfd가 안 되면
+ * (거대 페이지 요청은 실패로, 아니면) 익명 매핑으로 대신한다.
+ */
+static char *map_arena(size_t size, int huge) {
+    unsigned flags = MFD_CLOEXEC;
+    char *p;
+    int fd;
+
+#ifdef MFD_HUGETLB
+    if (huge)
+        flags |= MFD_HUGETLB;
+#endif
+    fd = syscall(SYS_memfd_create, "proxy-slab", flags);
+    if (fd >= 0 && ftruncate(fd, size) == 0) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            arena_fd = fd;
+            return p;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+    if (huge)
+        return MAP_FAILED;
+    return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+/*
+ * punch - [start, end) 안에 통째로 든 memfd 페이지를 파일에서 떼어 냄
+ * 소켓 큐에 남은 sendfile 페이지가 다음 내용으로 바뀌지 않게 청크를 쓰기
+ * 전에 부른다. 구멍을 낼 수 없으면 그 뒤로는 sendfile을 쓰지 않는다.
+ * fallocate는 _GNU_SOURCE가 필요하므로 시스템 호출로 부른다.
+ */
+static void punch(char *start, char *end) {
+    size_t unit = __atomic_load_n(&punch_unit, __ATOMIC_RELAXED);
+    size_t lo, hi;
+
+    if (!unit)
+        return;
+    lo = (start - arena + unit - 1) / unit * unit;
+    hi = (end - arena) / unit * unit;
+    if (lo < hi && syscall(SYS_fallocate, arena_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                           (off_t)lo, (off_t)(hi - lo)) < 0) {
+        fprintf(stderr, "slab: memfd 구멍 내기 실패, sendfile을 끔: %s\n", strerror(errno));
+        __atomic_store_n(&punch_unit, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * class_of - 머리를 포함한 chunk바이트가 들어가는 가장 작은 클래스 (없으면 -1)
+ */
+static int class_of(size_t chunk) {
+    int lo = 0, hi = class_count - 1, mid;
+
+    if (chunk > classes[hi].chunk)
+        return -1;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (classes[mid].chunk >= chunk)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/*
+ * take_chunk - 클래스 락을 잡은 상태에서 빈 청크 하나를 꺼냄
+ * 빈 자리 있는 덩어리가 없으면 아레나에서 새 덩어리를 가져온다.
+ */
+static slab_chunk_t *take_chunk(slab_class_t *c, int cls) {
+    slab_page_t *pg = c->partial;
+    slab_chunk_t *ch;
+
+    if (!pg) {
+        if ((pg = take_span(c->span, cls)) == NULL)
+            return NULL;
+        pg->used = pg->carved = 0;
+        pg->free = NULL;
+        c->pages += c->span;
+        partial_push(c, pg);
+    }
+
+    if (pg->free) {
+        ch = pg->free;
+        pg->free = ch->next;
+    } else {
+        ch = (slab_chunk_t *)(arena + (pg - pages) * (size_t)SLAB_PAGE_SIZE +
+                              pg->carved++ * c->chunk);
+    }
+    if (++pg->used == c->per_span)
+        partial_unlink(c, pg);
+    return ch;
+}
+
+static slab_page_t *page_of(slab_chunk_t *ch) {
+    return pages[((char *)ch - arena) / SLAB_PAGE_SIZE].head;
+}
+
+static void partial_unlink(slab_class_t *c, slab_page_t *pg) {
+    if (pg->prev)
+        pg->prev->next = pg->next;
+    else if (c->partial == pg)
+        c->partial = pg->next;
+    if (pg->next)
+        pg->next->prev = pg->prev;
+    pg->prev = pg->next = NULL;
+}
+
+static void partial_push(slab_class_t *c, slab_page_t *pg) {
+    pg->prev = NULL;
+    pg->next = c->partial;
+    if (c->partial)
+        c->partial->prev = pg;
+    c->partial = pg;
+}
@@ -0,0 +1,27 @@
+/*
+ * slab.h - 캐시 객체 본문용 슬랩 할당기 인터페이스
+ */
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include "csapp.h"
+
+#define SLAB_PAGE_SIZE (1 << 14)    /* 페이지 크기 (16KB): 작은 클래스마다 페이지를 가질 수 있게 */
+#define SLAB_MAX_SPAN 8             /* 한 덩어리로 잡는 최대 연속 페이지 수 (가장 큰 청크 이상) */
+#define SLAB_SPAN_WASTE 8           /* 덩어리 끝 자투리가 1/8 이하가 되도록 페이지 수를 고름 */
+#define SLAB_MIN_CHUNK 64           /* 가장 작은 클래스의 청크 크기 (머리 포함) */
+#define SLAB_GROWTH_DIV 4           /* 클래스 간 청크 크기 비율 1 + 1/4 = 1.25 */
+#define SLAB_MAX_CLASSES 64
+#define SLAB_EVICT_TRIES 8          /* 할당 한 번에 클래스 안에서 축출을 시도할 횟수 */
+#define SLAB_HUGE_PAGE (2 << 20)    /* 거대 페이지 크기 (2MB) */
+
+void slab_init(size_t arena_size, size_t max_object, int hugepages,
+               int (*pin)(void *owner, void *ctx), void (*evict)(void *owner));
+void *slab_alloc(size_t size, void *ctx);
+void slab_set_owner(void *p, void *owner);
+void slab_free(void *p);
+int slab_locate(void *p, size_t size, int *fdp, off_t *offp, size_t *startp,
+                size_t *endp);
+void slab_stats(int fd);
+
+#endif /* __SLAB_H__ */
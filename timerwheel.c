@@ -0,0 +1,132 @@
+/*
+ * timerwheel.c - 계층형 타이머 휠
+ *
+ * 1초 눈금의 슬롯 TW_SLOTS개짜리 휠을 TW_LEVELS 단계 쌓은 구조이다.
+ * 0단계 슬롯 하나는 1초, 1단계 슬롯 하나는 64초, ... 를 맡는다.
+ * 타이머 추가와 삭제는 O(1)이고, 상위 단계 슬롯은 하위 단계가 한 바퀴
+ * 돌 때마다 한 번씩 아래로 내려 보내므로(cascade) 눈금당 비용도 분할
+ * 상환 O(1)이다. 만료를 찾으려고 전체 캐시를 훑을 필요가 없다.
+ *
+ * 휠 자체는 락을 잡지 않는다. 호출자가 휠을 보호해야 한다.
+ */
+#include "timerwheel.h"
+#include <stddef.h>
+
+static void list_add(tw_node_t *head, tw_node_t *node);
+static void place(timer_wheel_t *tw, tw_node_t *node);
+static void cascade(timer_wheel_t *tw, int level);
+
+void tw_init(timer_wheel_t *tw, unsigned long now) {
+    int i, j;
+
+    tw->now = now;
+    for (i = 0; i < TW_LEVELS; i++)
+        for (j = 0; j < TW_SLOTS; j++)
+            tw->slots[i][j].prev = tw->slots[i][j].next = &tw->slots[i][j];
+}
+
+/*
+ * tw_add - expires 눈금에 만료되도록 노드를 등록
+ * 이미 지난 시각이면 다음 눈금에 만료된다.
+ */
+void tw_add(timer_wheel_t *tw, tw_node_t *node, unsigned long expires) {
+    node->expires = expires <= tw->now ? tw->now + 1 : expires;
+    place(tw, node);
+}
+
+/*
+ * tw_del - 노드를 휠에서 제거 (휠에 없는 노드여도 안전)
+ */
+void tw_del(tw_node_t *node) {
+    if (!node->next)
+        return;
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+}
+
+/*
+ * tw_advance - now 눈금까지 휠을 돌리며 만료된 노드마다 fire를 호출
+ * fire가 불릴 때 노드는 이미 휠에서 떨어져 있다.
+ */
+void tw_advance(timer_wheel_t *tw, unsigned long now,
+                void (*fire)(tw_node_t *node, void *arg), void *arg) {
+    tw_node_t *head, *node;
+    int level;
+
+    while (tw->now < now) {
+        tw->now++;
+
+        /* 0단계가 한 바퀴 돌았으면 상위 단계 슬롯을 내려 보냄 */
+        for (level = 1; level < TW_LEVELS; level++) {
+            if ((tw->now >> (TW_BITS * (level - 1))) & (TW_SLOTS - 1))
+                break;
+            cascade(tw, level);
+        }
+
+        head = &tw->slots[0][tw->now & (TW_SLOTS - 1)];
+        while ((node = head->next) != head) {
+            tw_del(node);
+            fire(node, arg);
+        }
+    }
+}
+
+static void list_add(tw_node_t *head, tw_node_t *node) {
+    node->next = head;
+    node->prev = head->prev;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+/*
+ * place - 남은 시간에 맞는 단계와 슬롯에 노드를 넣음
+ * 내려 보내는 중에는 만료 시각이 현재 눈금과 같을 수 있으며, 이 노드는
+ * 곧이어 처리될 0단계 현재 슬롯에 들어간다.
+ * 각 단계에서 현재 눈금과의 슬롯 거리가 TW_SLOTS 미만인 가장 낮은
+ * 단계를 고른다. 이미 지나간(내려 보낸) 슬롯에 들어가는 일이 없다.
+ */
+static void place(timer_wheel_t *tw, tw_node_t *node) {
+    unsigned long expires = node->expires;
+    int level, shift;
+
+    for (level = 0; level < TW_LEVELS; level++) {
+        shift = TW_BITS * level;
+        if ((expires >> shift) - (tw->now >> shift) < TW_SLOTS)
+            break;
+    }
+
+    /* 최상위 단계 범위를 넘으면 그 단계의 가장 먼 슬롯에 두고,
+     * 내려올 때 원래 만료 시각으로 다시 배치 */
+    if (level == TW_LEVELS) {
+        level = TW_LEVELS - 1;
+        shift = TW_BITS * level;
+        expires = ((tw->now >> shift) + TW_SLOTS - 1) << shift;
+    }
+
+    list_add(&tw->slots[level][(expires >> shift) & (TW_SLOTS - 1)], node);
+}
+
+/*
+ * cascade - 상위 단계의 현재 슬롯에 있는 노드를 다시 배치
+ */
+static void cascade(timer_wheel_t *tw, int level) {
+    tw_node_t *head = &tw->slots[level][(tw->now >> (TW_BITS * level)) & (TW_SLOTS - 1)];
+    tw_node_t list, *node;
+
+    if (head->next == head)
+        return;
+
+    /* 슬롯 리스트를 떼어 낸 뒤 하나씩 다시 넣음 */
+    list.next = head->next;
+    list.prev = head->prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    head->prev = head->next = head;
+
+    while ((node = list.next) != &list) {
+        list.next = node->next;
+        node->next->prev = &list;
+        place(tw, node);
+    }
+}
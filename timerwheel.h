@@ -0,0 +1,28 @@
+/*
+ * timerwheel.h - 계층형 타이머 휠 인터페이스
+ */
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+
+#define TW_BITS 6
+#define TW_SLOTS (1 << TW_BITS)     /* 단계당 슬롯 수 */
+#define TW_LEVELS 4                 /* 1초 눈금으로 약 194일까지 표현 */
+
+/* 타이머 노드: 만료를 추적할 구조체 안에 넣어 쓴다 */
+typedef struct tw_node {
+    struct tw_node *prev, *next;    /* 슬롯 리스트 (next == NULL이면 휠 밖) */
+    unsigned long expires;          /* 만료 눈금(초) */
+} tw_node_t;
+
+typedef struct {
+    unsigned long now;              /* 마지막으로 처리한 눈금 */
+    tw_node_t slots[TW_LEVELS][TW_SLOTS]; /* 각 슬롯의 머리 노드 */
+} timer_wheel_t;
+
+void tw_init(timer_wheel_t *tw, unsigned long now);
+void tw_add(timer_wheel_t *tw, tw_node_t *node, unsigned long expires);
+void tw_del(tw_node_t *node);
+void tw_advance(timer_wheel_t *tw, unsigned long now,
+                void (*fire)(tw_node_t *node, void *arg), void *arg);
+
+#endif /* __TIMERWHEEL_H__ */
@@ -0,0 +1,127 @@
+/*
+ * tinylfu.c - TinyLFU 캐시 승인 필터
+ *
+ * 최근 접근 빈도를 count-min sketch로 근사하여, 새로 가져온 객체가
+ * 축출될 객체보다 자주 요청될 때만 캐시에 받아들인다. 한 번만 요청되고
+ * 다시 오지 않는 긴 꼬리의 URL이 자주 쓰이는 객체를 밀어내지 못하게 한다.
+ *
+ * - doorkeeper: 블룸 필터. 처음 보는 키는 여기에만 기록하고, 두 번째
+ *   접근부터 sketch 카운터를 올린다. 한 번뿐인 키가 sketch를 오염시키지
+ *   않는다.
+ * - 노화: TINYLFU_SAMPLE번 기록할 때마다 모든 카운터를 절반으로 줄이고
+ *   doorkeeper를 비워, 오래전의 인기가 현재 판단을 지배하지 않게 한다.
+ *
+ * 카운터와 doorkeeper 비트는 원자 연산으로 갱신하며 락을 잡지 않는다.
+ * 노화 중에 겹치는 기록이 일부 손실될 수 있으나 근사치이므로 무방하다.
+ */
+#include "tinylfu.h"
+#include "csapp.h"
+
+#define DOOR_BITS (TINYLFU_WIDTH * 8)
+
+static unsigned char sketch[TINYLFU_DEPTH][TINYLFU_WIDTH];
+static unsigned long door[DOOR_BITS / 64];
+static unsigned long samples;
+static pthread_mutex_t age_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long mix(unsigned long h, int i);
+static int door_test_and_set(unsigned long hash);
+static void age(void);
+
+void tinylfu_init(void) {
+    memset(sketch, 0, sizeof(sketch));
+    memset(door, 0, sizeof(door));
+    samples = 0;
+}
+
+/*
+ * tinylfu_record - 키 접근 한 번을 기록 (캐시 조회마다 호출)
+ */
+void tinylfu_record(unsigned long hash) {
+    int i;
+
+    if (door_test_and_set(hash)) {
+        for (i = 0; i < TINYLFU_DEPTH; i++) {
+            unsigned char *c = &sketch[i][mix(hash, i) & (TINYLFU_WIDTH - 1)];
+            if (__atomic_load_n(c, __ATOMIC_RELAXED) < TINYLFU_COUNTER_MAX)
+                __atomic_add_fetch(c, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (__atomic_add_fetch(&samples, 1, __ATOMIC_RELAXED) >= TINYLFU_SAMPLE) {
+        pthread_mutex_lock(&age_lock);
+        if (__atomic_load_n(&samples, __ATOMIC_RELAXED) >= TINYLFU_SAMPLE)
+            age();
+        pthread_mutex_unlock(&age_lock);
+    }
+}
+
+/*
+ * tinylfu_estimate - 키의 추정 접근 빈도
+ * sketch 행들 중 최솟값에 doorkeeper에 있으면 1을 더한다.
+ */
+int tinylfu_estimate(unsigned long hash) {
+    int i, c, min = TINYLFU_COUNTER_MAX;
+    unsigned long bit;
+
+    for (i = 0; i < TINYLFU_DEPTH; i++) {
+        c = __atomic_load_n(&sketch[i][mix(hash, i) & (TINYLFU_WIDTH - 1)], __ATOMIC_RELAXED);
+        if (c < min)
+            min = c;
+    }
+    for (i = 0; i < 2; i++) {
+        bit = mix(hash, TINYLFU_DEPTH + i) & (DOOR_BITS - 1);
+        if (!(__atomic_load_n(&door[bit / 64], __ATOMIC_RELAXED) & (1UL << (bit % 64))))
+            return min;
+    }
+    return min + 1;
+}
+
+/*
+ * tinylfu_admit - 후보 객체를 받아들이고 victim을 축출할지 결정
+ * 후보의 빈도가 victim보다 높을 때만 1을 반환한다.
+ */
+int tinylfu_admit(unsigned long candidate, unsigned long victim) {
+    return tinylfu_estimate(candidate) > tinylfu_estimate(victim);
+}
+
+/*
+ * mix - 행마다 다른 인덱스를 얻기 위해 키 해시를 다시 섞음
+ */
+static unsigned long mix(unsigned long h, int i) {
+    h += 0x9e3779b97f4a7c15UL * (i + 1);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9UL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebUL;
+    return h ^ (h >> 31);
+}
+
+/*
+ * door_test_and_set - doorkeeper에 키를 넣고, 이미 있었으면 1을 반환
+ */
+static int door_test_and_set(unsigned long hash) {
+    int i, present = 1;
+    unsigned long bit, mask, old;
+
+    for (i = 0; i < 2; i++) {
+        bit = mix(hash, TINYLFU_DEPTH + i) & (DOOR_BITS - 1);
+        mask = 1UL << (bit % 64);
+        old = __atomic_fetch_or(&door[bit / 64], mask, __ATOMIC_RELAXED);
+        if (!(old & mask))
+            present = 0;
+    }
+    return present;
+}
+
+/*
+ * age - 모든 카운터를 절반으로 줄이고 doorkeeper를 비움 (age_lock 보유)
+ */
+static void age(void) {
+    int i, j;
+
+    for (i = 0; i < TINYLFU_DEPTH; i++)
+        for (j = 0; j < TINYLFU_WIDTH; j++)
+            __atomic_store_n(&sketch[i][j], sketch[i][j] >> 1, __ATOMIC_RELAXED);
+    for (j = 0; j < DOOR_BITS / 64; j++)
+        __atomic_store_n(&door[j], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&samples, 0, __ATOMIC_RELAXED);
+}
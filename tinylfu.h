@@ -0,0 +1,17 @@
+/*
+ * tinylfu.h - 캐시 승인(admission) 필터 인터페이스
+ */
+#ifndef __TINYLFU_H__
+#define __TINYLFU_H__
+
+#define TINYLFU_WIDTH 4096          /* count-min sketch 행당 카운터 수 (2의 거듭제곱) */
+#define TINYLFU_DEPTH 4             /* count-min sketch 행 수 */
+#define TINYLFU_COUNTER_MAX 15      /* 카운터 포화값 */
+#define TINYLFU_SAMPLE (10 * TINYLFU_WIDTH) /* 이만큼 기록하면 카운터를 절반으로 노화 */
+
+void tinylfu_init(void);
+void tinylfu_record(unsigned long hash);
+int tinylfu_estimate(unsigned long hash);
+int tinylfu_admit(unsigned long candidate, unsigned long victim);
+
+#endif /* __TINYLFU_H__ */
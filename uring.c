@@ -0,0 +1,239 @@
+/*
+ * uring.c - 시스템 호출로 직접 다루는 io_uring 링
+ *
+ * liburing 없이 io_uring_setup/io_uring_enter/io_uring_register를 불러
+ * 제출/완료 큐를 매핑하고, 이벤트 엔진(reactor.c)이 쓰는 만큼만 감싼다.
+ *
+ * - 제출: uring_sqe로 빈 SQE를 받아 채우고, uring_submit이 커널에 알리며
+ *   필요하면 완료를 기다린다. 제출 큐가 가득 차면 uring_sqe가 먼저 제출한다.
+ *   연결된 사슬은 uring_reserve로 자리를 먼저 잡는다.
+ * - 완료: uring_peek가 CQE 하나를 복사해 꺼낸다.
+ * - 제공 버퍼 링(IORING_REGISTER_PBUF_RING): 다중 수신(multishot recv)이
+ *   커널 안에서 버퍼를 골라 쓰고 CQE에 버퍼 번호를 돌려준다. 다 쓴 버퍼는
+ *   uring_buf_put으로 링에 다시 올린다.
+ * - 등록 fd 표: 빈 칸(-1)으로 등록해 두고 uring_set_file로 칸을 채우면
+ *   IOSQE_FIXED_FILE로 fd 참조 비용 없이 쓸 수 있다.
+ *
+ * 커널이 io_uring을 지원하지 않거나 막혀 있거나, 필요한 연산(다중
+ * 수신/수락과 함께 6.0에 들어간 연산 번호로 판단)이나 제공 버퍼 링을
+ * 지원하지 않으면 uring_init이 -1을 반환하고 호출자는 epoll로 돌아간다.
+ * 링은 스레드 하나만 쓴다.
+ */
+#include "uring.h"
+#include <sys/syscall.h>
+
+static int setup(unsigned entries, struct io_uring_params *p);
+static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags);
+static int reg(int fd, unsigned op, void *arg, unsigned nr_args);
+static int probe(int fd);
+
+/*
+ * uring_init - 링을 만들고 큐를 매핑한 뒤 fd 표와 제공 버퍼 링을 등록
+ * 실패하면 만든 것을 모두 풀고 -1
+ */
+int uring_init(uring_t *u) {
+    struct io_uring_params p;
+    struct io_uring_buf_reg br;
+    int *files = NULL, i;
+
+    memset(u, 0, sizeof(*u));
+    memset(&p, 0, sizeof(p));
+    if ((u->fd = setup(URING_ENTRIES, &p)) < 0) {
+        fprintf(stderr, "uring: io_uring_setup 실패: %s\n", strerror(errno));
+        return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP) ||
+        probe(u->fd) < 0) {
+        fprintf(stderr, "uring: 커널이 필요한 기능을 지원하지 않음\n");
+        close(u->fd);
+        return -1;
+    }
+
+    /* 제출/완료 큐 링은 한 번에 매핑 (IORING_FEAT_SINGLE_MMAP) */
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (u->cq_size > u->sq_size)
+        u->sq_size = u->cq_size;
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     u->fd, IORING_OFF_SQ_RING);
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->fd, IORING_OFF_SQES);
+    if (u->sq_ptr == MAP_FAILED || u->sqes == MAP_FAILED)
+        goto fail;
+    u->cq_ptr = u->sq_ptr;
+    u->sq_head = (unsigned *)((char *)u->sq_ptr + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ptr + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ptr + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ptr + p.sq_off.array);
+    u->sq_entries = p.sq_entries;
+    u->sqe_tail = *u->sq_tail;
+    u->cq_head = (unsigned *)((char *)u->cq_ptr + p.cq_off.head);
+    u->cq_tail = (unsigned *)((char *)u->cq_ptr + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((char *)u->cq_ptr + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((char *)u->cq_ptr + p.cq_off.cqes);
+
+    /* 빈 칸뿐인 등록 fd 표 */
+    files = Malloc(URING_FILES * sizeof(int));
+    for (i = 0; i < URING_FILES; i++)
+        files[i] = -1;
+    if (reg(u->fd, IORING_REGISTER_FILES, files, URING_FILES) < 0)
+        goto fail;
+    Free(files);
+    files = NULL;
+
+    /* 제공 버퍼 링: 링은 페이지 정렬된 메모리여야 한다 */
+    u->br = mmap(NULL, URING_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->br == MAP_FAILED) {
+        u->br = NULL;
+        goto fail;
+    }
+    memset(&br, 0, sizeof(br));
+    br.ring_addr = (unsigned long)u->br;
+    br.ring_entries = URING_BUFS;
+    br.bgid = URING_BGID;
+    if (reg(u->fd, IORING_REGISTER_PBUF_RING, &br, 1) < 0)
+        goto fail;
+    u->bufs = Malloc((size_t)URING_BUFS * URING_BUF_SIZE);
+    for (i = 0; i < URING_BUFS; i++)
+        uring_buf_put(u, i);
+    return 0;
+
+fail:
+    fprintf(stderr, "uring: 링 준비 실패: %s\n", strerror(errno));
+    if (files)
+        Free(files);
+    if (u->br)
+        munmap(u->br, URING_BUFS * sizeof(struct io_uring_buf));
+    if (u->sq_ptr && u->sq_ptr != MAP_FAILED)
+        munmap(u->sq_ptr, u->sq_size);
+    if (u->sqes && u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_size);
+    close(u->fd);
+    return -1;
+}
+
+/*
+ * uring_sqe - 채울 빈 SQE를 0으로 지워 반환 (큐가 가득 차면 먼저 제출)
+ */
+struct io_uring_sqe *uring_sqe(uring_t *u) {
+    struct io_uring_sqe *sqe;
+
+    while (u->sqe_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries)
+        uring_submit(u, 0);
+    sqe = &u->sqes[u->sqe_tail & *u->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[u->sqe_tail & *u->sq_mask] = u->sqe_tail & *u->sq_mask;
+    u->sqe_tail++;
+    return sqe;
+}
+
+/*
+ * uring_reserve - 제출 큐에 n칸 이상 비어 있게 함 (모자라면 채운 것을 먼저 제출)
+ * 연결된(IOSQE_IO_LINK) 사슬이 제출 경계에서 끊기지 않도록 사슬을 채우기
+ * 전에 부른다.
+ */
+void uring_reserve(uring_t *u, unsigned n) {
+    while (u->sq_entries - (u->sqe_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE)) < n)
+        uring_submit(u, 0);
+}
+
+/*
+ * uring_submit - 채운 SQE를 커널에 알리고, wait면 완료가 하나 이상 올 때까지 기다림
+ * 신호로 깨면 그냥 돌아온다 (호출자가 완료 큐를 보고 다시 부른다).
+ */
+int uring_submit(uring_t *u, int wait) {
+    unsigned pending;
+    int rc;
+
+    __atomic_store_n(u->sq_tail, u->sqe_tail, __ATOMIC_RELEASE);
+    pending = u->sqe_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    if (pending == 0 && !wait)
+        return 0;
+    if (wait && __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) != *u->cq_head)
+        wait = 0;                   /* 이미 완료가 있으면 기다리지 않음 */
+    rc = enter(u->fd, pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+    if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        unix_error("io_uring_enter error");
+    return rc;
+}
+
+/*
+ * uring_peek - 완료 큐에서 CQE 하나를 cqe에 복사해 꺼냄. 비었으면 0
+ */
+int uring_peek(uring_t *u, struct io_uring_cqe *cqe) {
+    unsigned head = *u->cq_head;
+
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+        return 0;
+    *cqe = u->cqes[head & *u->cq_mask];
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+char *uring_buf(uring_t *u, unsigned bid) {
+    return u->bufs + (size_t)bid * URING_BUF_SIZE;
+}
+
+/*
+ * uring_buf_put - 다 쓴 제공 버퍼를 링에 다시 올림
+ */
+void uring_buf_put(uring_t *u, unsigned bid) {
+    struct io_uring_buf *b = &u->br->bufs[u->br_tail & (URING_BUFS - 1)];
+
+    b->addr = (unsigned long)uring_buf(u, bid);
+    b->len = URING_BUF_SIZE;
+    b->bid = bid;
+    u->br_tail++;
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+    u->bufs_free++;
+}
+
+/*
+ * uring_set_file - 등록 fd 표의 slot 칸을 fd로 채움 (-1이면 비움)
+ */
+int uring_set_file(uring_t *u, int slot, int fd) {
+    struct io_uring_files_update up;
+
+    memset(&up, 0, sizeof(up));
+    up.offset = slot;
+    up.fds = (unsigned long)&fd;
+    return reg(u->fd, IORING_REGISTER_FILES_UPDATE, &up, 1) == 1 ? 0 : -1;
+}
+
+static int setup(unsigned entries, struct io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int reg(int fd, unsigned op, void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, op, arg, nr_args);
+}
+
+/*
+ * probe - 엔진이 쓰는 연산을 커널이 지원하는지 확인
+ * 다중 수락/수신은 연산 번호로 드러나지 않으므로, 둘이 모두 들어간 뒤에
+ * 추가된 IORING_OP_SEND_ZC(6.0)를 지원하는지로 판단한다.
+ */
+static int probe(int fd) {
+    static const int ops[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+                               IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL,
+                               IORING_OP_SEND_ZC };
+    struct io_uring_probe *pr;
+    int i, rc = 0;
+
+    pr = Calloc(1, sizeof(*pr) + 256 * sizeof(struct io_uring_probe_op));
+    if (reg(fd, IORING_REGISTER_PROBE, pr, 256) < 0) {
+        Free(pr);
+        return -1;
+    }
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+        if (ops[i] > pr->last_op || !(pr->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            rc = -1;
+    Free(pr);
+    return rc;
+}
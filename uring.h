@@ -0,0 +1,48 @@
+/*
+ * uring.h - 시스템 호출로 직접 다루는 io_uring 링 인터페이스
+ */
+#ifndef __URING_H__
+#define __URING_H__
+
+#include "csapp.h"
+#include <linux/io_uring.h>
+
+#define URING_ENTRIES 1024          /* 제출 큐 크기 (완료 큐는 두 배) */
+#define URING_FILES 4096            /* 등록 fd 표 크기 */
+#define URING_BUFS 512              /* 제공 버퍼 수 (2의 거듭제곱) */
+#define URING_BUF_SIZE MAXBUF       /* 제공 버퍼 하나의 크기 */
+#define URING_BGID 0                /* 제공 버퍼 그룹 번호 */
+
+typedef struct {
+    int fd;
+
+    /* 제출 큐 */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    unsigned sqe_tail;              /* 채웠지만 아직 커널에 알리지 않은 끝 */
+    struct io_uring_sqe *sqes;
+
+    /* 완료 큐 */
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+
+    /* 제공 버퍼 링 */
+    struct io_uring_buf_ring *br;
+    char *bufs;
+    unsigned short br_tail;
+    int bufs_free;                  /* 링에 돌려준 버퍼 수 */
+} uring_t;
+
+int uring_init(uring_t *u);
+struct io_uring_sqe *uring_sqe(uring_t *u);
+void uring_reserve(uring_t *u, unsigned n);
+int uring_submit(uring_t *u, int wait);
+int uring_peek(uring_t *u, struct io_uring_cqe *cqe);
+char *uring_buf(uring_t *u, unsigned bid);
+void uring_buf_put(uring_t *u, unsigned bid);
+int uring_set_file(uring_t *u, int slot, int fd);
+
+#endif /* __URING_H__ */
@@ -0,0 +1,213 @@
+/*
+ * urlnorm.c - 캐시 키용 URI 정규화
+ *
+ * 같은 자원을 가리키는 URI가 서로 다른 캐시 키가 되면 적중률이 떨어진다.
+ * parse_uri가 나눈 호스트, 포트, 경로로 다음 규칙에 따라 키를 만든다.
+ * (스킴은 parse_uri가 이미 버렸고 프록시는 http만 다룬다.)
+ *
+ * - 호스트는 소문자로, 끝의 점은 뗀다.        Example.COM.  -> example.com
+ * - 포트는 앞의 0을 떼고 기본 포트 80은 생략. host:080     -> host
+ * - 퍼센트 인코딩: 예약되지 않은 문자(영숫자 - . _ ~)는 풀고, 나머지는
+ *   16진수를 대문자로 맞춘다.                  /%7euser/a%2fb -> /~user/a%2Fb
+ * - 경로의 점 세그먼트를 RFC 3986 5.2.4대로 없앤다. /a/./b/../c -> /a/c
+ * - 빈 경로는 "/"로, 조각(#...)과 빈 질의("?")는 버린다.
+ * - url_sort_query면 질의 인자를 정렬한다.   ?b=2&a=1     -> ?a=1&b=2
+ *
+ * 요청마다 불리므로 힙 할당 없이 호출자의 key 버퍼와 스택만 쓴다.
+ * 원 서버로 보내는 요청 경로는 바꾸지 않는다.
+ */
+#include "urlnorm.h"
+#include "csapp.h"
+
+int url_sort_query = 0;
+
+typedef struct {
+    char *p;
+    size_t len;                     /* 인자 전체 길이 */
+    size_t name;                    /* 이름 길이 */
+} param_t;
+
+static long copy_encoded(char *key, size_t size, size_t n, char *from, char *to);
+static size_t remove_dots(char *buf, size_t len);
+static void sort_params(char *q, size_t len);
+static int hexval(int c);
+
+/*
+ * url_normalize - 호스트, 포트, 경로로 정규화된 캐시 키를 key에 씀
+ * 키 길이를 반환하며, size에 들어가지 않으면 -1
+ */
+int url_normalize(char *key, size_t size, char *host, char *port, char *path) {
+    long n = 0;
+    size_t start;
+    char *end, *q, *qend;
+
+    /* 호스트 */
+    for (; *host; host++) {
+        if (n + 1 >= size)
+            return -1;
+        key[n++] = tolower((unsigned char)*host);
+    }
+    while (n > 0 && key[n - 1] == '.')
+        n--;
+
+    /* 포트 */
+    while (*port == '0' && port[1])
+        port++;
+    if (*port && strcmp(port, URL_DEFAULT_PORT) != 0) {
+        if (n + 1 + strlen(port) >= size)
+            return -1;
+        key[n++] = ':';
+        while (*port)
+            key[n++] = *port++;
+    }
+
+    /* 경로: 인코딩을 맞춘 뒤 점 세그먼트 제거 */
+    end = path + strcspn(path, "?#");
+    start = n;
+    if (*path != '/') {
+        if (n + 1 >= size)
+            return -1;
+        key[n++] = '/';
+    }
+    if ((n = copy_encoded(key, size, n, path, end)) < 0)
+        return -1;
+    n = start + remove_dots(key + start, n - start);
+
+    /* 질의 */
+    if (*end == '?') {
+        q = end + 1;
+        qend = q + strcspn(q, "#");
+        if (qend > q) {
+            if (n + 1 >= size)
+                return -1;
+            key[n++] = '?';
+            start = n;
+            if ((n = copy_encoded(key, size, n, q, qend)) < 0)
+                return -1;
+            if (url_sort_query)
+                sort_params(key + start, n - start);
+        }
+    }
+
+    key[n] = '\0';
+    return n;
+}
+
+/*
+ * copy_encoded - [from, to)를 퍼센트 인코딩을 맞추며 key[n]부터 복사
+ * 새 길이를 반환하며, 넘치면 -1
+ */
+static long copy_encoded(char *key, size_t size, size_t n, char *from, char *to) {
+    static const char hex[] = "0123456789ABCDEF";
+    int hi, lo, c;
+
+    while (from < to) {
+        if (n + 3 >= size)
+            return -1;
+        if (*from == '%' && to - from >= 3 && (hi = hexval(from[1])) >= 0 &&
+            (lo = hexval(from[2])) >= 0) {
+            c = hi << 4 | lo;
+            if (isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+                key[n++] = c;
+            } else {
+                key[n++] = '%';
+                key[n++] = hex[hi];
+                key[n++] = hex[lo];
+            }
+            from += 3;
+        } else {
+            key[n++] = *from++;
+        }
+    }
+    return n;
+}
+
+/*
+ * remove_dots - "/"로 시작하는 경로에서 "."과 ".." 세그먼트를 제자리에서 없앰
+ * 쓰는 위치가 읽는 위치를 앞지르지 않으므로 같은 버퍼에서 처리할 수 있다.
+ */
+static size_t remove_dots(char *buf, size_t len) {
+    size_t r = 0, w = 0, e, seg;
+
+    while (r < len) {
+        /* buf[r] == '/': 다음 세그먼트는 [r + 1, e) */
+        for (e = r + 1; e < len && buf[e] != '/'; e++)
+            ;
+        seg = e - r - 1;
+        if (seg == 1 && buf[r + 1] == '.') {
+            if (e == len)
+                buf[w++] = '/';
+        } else if (seg == 2 && buf[r + 1] == '.' && buf[r + 2] == '.') {
+            while (w > 0 && buf[--w] != '/')
+                ;
+            if (e == len)
+                buf[w++] = '/';
+        } else {
+            memmove(buf + w, buf + r, e - r);
+            w += e - r;
+        }
+        r = e;
+    }
+    if (w == 0)
+        buf[w++] = '/';
+    return w;
+}
+
+/*
+ * sort_params - '&'로 나뉜 질의 인자를 이름('=' 앞)의 바이트 순으로 정렬
+ * 같은 이름이 여러 번 나오면 의미가 순서에 달려 있을 수 있으므로 원래
+ * 순서를 지킨다. 인자가 URL_MAX_PARAMS개를 넘으면 그대로 둔다.
+ */
+static void sort_params(char *q, size_t len) {
+    param_t params[URL_MAX_PARAMS], t;
+    char tmp[MAXLINE];
+    size_t i, j, count = 0, n;
+    char *p = q, *end = q + len, *amp, *eq;
+    int cmp;
+
+    if (len > sizeof(tmp))
+        return;
+    while (p <= end) {
+        if (count == URL_MAX_PARAMS)
+            return;
+        amp = memchr(p, '&', end - p);
+        if (!amp)
+            amp = end;
+        params[count].p = p;
+        params[count].len = amp - p;
+        params[count].name = (eq = memchr(p, '=', amp - p)) ? eq - p : amp - p;
+        count++;
+        p = amp + 1;
+    }
+
+    /* 인자 수가 적으므로 안정 정렬인 삽입 정렬 */
+    for (i = 1; i < count; i++) {
+        t = params[i];
+        for (j = i; j > 0; j--) {
+            n = t.name < params[j - 1].name ? t.name : params[j - 1].name;
+            cmp = memcmp(params[j - 1].p, t.p, n);
+            if (cmp < 0 || (cmp == 0 && params[j - 1].name <= t.name))
+                break;
+            params[j] = params[j - 1];
+        }
+        params[j] = t;
+    }
+
+    for (i = 0, n = 0; i < count; i++) {
+        if (i > 0)
+            tmp[n++] = '&';
+        memcpy(tmp + n, params[i].p, params[i].len);
+        n += params[i].len;
+    }
+    memcpy(q, tmp, n);
+}
+
+static int hexval(int c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
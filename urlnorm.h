@@ -0,0 +1,16 @@
+/*
+ * urlnorm.h - 캐시 키용 URI 정규화 인터페이스
+ */
+#ifndef __URLNORM_H__
+#define __URLNORM_H__
+
+#include <stddef.h>
+
+#define URL_DEFAULT_PORT "80"       /* 키에서 생략하는 기본 포트 */
+#define URL_MAX_PARAMS 64           /* 정렬할 수 있는 질의 인자 수 (넘으면 정렬하지 않음) */
+
+extern int url_sort_query;          /* 1이면 질의 인자를 정렬해 키에 넣음 */
+
+int url_normalize(char *key, size_t size, char *host, char *port, char *path);
+
+#endif /* __URLNORM_H__ */